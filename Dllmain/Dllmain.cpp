@@ -28,6 +28,7 @@
 #endif // DDRAWCOMPAT
 #include "Utils\Utils.h"
 #include "Logging\Logging.h"
+#include "Logging\AsyncLog.h"
 // Wrappers last
 #include "IClassFactory\IClassFactory.h"
 #include "GDI\GDI.h"
@@ -206,6 +207,10 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD fdwReason, LPVOID lpReserved)
 		// Init logs
 		Logging::EnableLogging = !Config.DisableLogging;
 		Logging::InitLog();
+		if (Config.AsyncLogging)
+		{
+			Logging::StartAsyncLog();
+		}
 		bool IsRunningFromMemory = false;
 		Logging::Log() << "Starting DxWrapper v" << APP_VERSION;
 		{
@@ -668,6 +673,9 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD fdwReason, LPVOID lpReserved)
 		}
 #endif // DDRAWCOMPAT
 
+		// Free the thread's log buffer
+		Logging::ReleaseAsyncLogThread();
+
 		if (Config.ForceTermination)
 		{
 			// Check if thread has started
@@ -747,6 +755,7 @@ BOOL APIENTRY DllMain(HMODULE hModule, DWORD fdwReason, LPVOID lpReserved)
 
 		// Final log
 		Logging::Log() << "DxWrapper terminated!";
+		Logging::StopAsyncLog();
 		break;
 	}
 	return true;
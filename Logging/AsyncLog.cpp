@@ -0,0 +1,471 @@
+/**
+* Copyright (C) 2024 Elisha Riedlinger
+*
+* This software is  provided 'as-is', without any express  or implied  warranty. In no event will the
+* authors be held liable for any damages arising from the use of this software.
+* Permission  is granted  to anyone  to use  this software  for  any  purpose,  including  commercial
+* applications, and to alter it and redistribute it freely, subject to the following restrictions:
+*
+*   1. The origin of this software must not be misrepresented; you must not claim that you  wrote the
+*      original  software. If you use this  software  in a product, an  acknowledgment in the product
+*      documentation would be appreciated but is not required.
+*   2. Altered source versions must  be plainly  marked as such, and  must not be  misrepresented  as
+*      being the original software.
+*   3. This notice may not be removed or altered from any source distribution.
+*
+* Asynchronous log backend. Each thread formats into its own buffer, finished records are pushed
+* into a bounded lock-free multi-producer ring and a single writer thread writes them to disk in
+* batches. Ring based on Dmitry Vyukov's bounded MPMC queue.
+*/
+
+#include <atomic>
+#include <string>
+#include <streambuf>
+#include "Logging.h"
+#include "AsyncLog.h"
+
+namespace Logging
+{
+	// Number of records that can be queued before producers have to wait, must be a power of two
+	constexpr size_t AsyncLogRingSize = 4096;
+
+	// Wake the writer early once the ring is this full
+	constexpr size_t AsyncLogHighWater = AsyncLogRingSize / 4;
+
+	// Records are committed early if a thread writes this much without ending the line
+	constexpr size_t AsyncLogMaxRecordSize = 64 * 1024;
+
+	// Writes to disk are issued in chunks of this size
+	constexpr size_t AsyncLogBatchSize = 64 * 1024;
+
+	// Time the writer thread sleeps between batches
+	constexpr DWORD AsyncLogFlushInterval = 100;
+
+	// Time a flush waits for the writer before giving up, used on crash and exit
+	constexpr DWORD AsyncLogFlushTimeout = 250;
+
+	struct LOGSLOT
+	{
+		std::atomic<size_t> Sequence = 0;
+		std::string Record;
+	};
+
+	struct THREADBUFFER
+	{
+		std::string Data;
+		volatile LONG Lock = 0;			// Held by the owning thread while writing and by StopAsyncLog while draining
+		THREADBUFFER* Next = nullptr;
+	};
+
+	class AsyncLogBuffer : public std::streambuf
+	{
+	protected:
+		int_type overflow(int_type ch) override;
+		std::streamsize xsputn(const char* s, std::streamsize n) override;
+		int sync() override;
+	};
+
+	// Declare variables
+	LOGSLOT RingSlots[AsyncLogRingSize];
+	alignas(64) std::atomic<size_t> RingEnqueuePos = 0;
+	alignas(64) std::atomic<size_t> RingDequeuePos = 0;
+	THREADBUFFER* ThreadBufferList = nullptr;
+	volatile LONG ThreadBufferListLock = 0;
+	AsyncLogBuffer AsyncBuffer;
+	std::streambuf* FileBuffer = nullptr;
+	std::string WriteBatch;
+	volatile LONG WriterLock = 0;
+	DWORD TlsIndex = TLS_OUT_OF_INDEXES;
+	bool AsyncLogRunning = false;
+	std::atomic<bool> m_StopThreadFlag = false;
+	HANDLE m_hThread = nullptr;
+	HANDLE m_hEvent = nullptr;
+	DWORD m_dwThreadID = 0;
+
+	// Function declarations
+	THREADBUFFER& GetThreadBuffer();
+	bool TryPushRecord(std::string& Record, size_t& Pos);
+	void CommitRecord(std::string& Record);
+	void DrainRing();
+	bool AcquireSpinLock(volatile LONG& Lock, DWORD TimeoutMS);
+	void ReleaseSpinLock(volatile LONG& Lock);
+	bool AcquireWriterLock(DWORD TimeoutMS);
+	void ReleaseWriterLock();
+	DWORD WINAPI AsyncLogThreadFunc(LPVOID);
+}
+
+// Get the format buffer for the calling thread
+Logging::THREADBUFFER& Logging::GetThreadBuffer()
+{
+	THREADBUFFER* pBuffer = (THREADBUFFER*)TlsGetValue(TlsIndex);
+	if (!pBuffer)
+	{
+		pBuffer = new THREADBUFFER;
+		pBuffer->Data.reserve(256);
+
+		// Keep a list of all buffers so partial records can be written on exit
+		AcquireSpinLock(ThreadBufferListLock, INFINITE);
+		pBuffer->Next = ThreadBufferList;
+		ThreadBufferList = pBuffer;
+		ReleaseSpinLock(ThreadBufferListLock);
+
+		TlsSetValue(TlsIndex, pBuffer);
+	}
+	return *pBuffer;
+}
+
+// Push record into the ring, the record is swapped with the slot's empty string so its memory is reused
+bool Logging::TryPushRecord(std::string& Record, size_t& Pos)
+{
+	Pos = RingEnqueuePos.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		LOGSLOT& Slot = RingSlots[Pos & (AsyncLogRingSize - 1)];
+		size_t Sequence = Slot.Sequence.load(std::memory_order_acquire);
+		intptr_t Diff = (intptr_t)Sequence - (intptr_t)Pos;
+		if (Diff == 0)
+		{
+			if (RingEnqueuePos.compare_exchange_weak(Pos, Pos + 1, std::memory_order_relaxed))
+			{
+				Slot.Record.swap(Record);
+				Slot.Sequence.store(Pos + 1, std::memory_order_release);
+				return true;
+			}
+		}
+		else if (Diff < 0)
+		{
+			// Ring is full
+			return false;
+		}
+		else
+		{
+			Pos = RingEnqueuePos.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+// Hand finished record to the writer thread
+void Logging::CommitRecord(std::string& Record)
+{
+	if (Record.empty())
+	{
+		return;
+	}
+
+	size_t Pos = 0;
+	while (!TryPushRecord(Record, Pos))
+	{
+		// Writer has been stopped, nothing will drain the ring
+		if (!AsyncLogRunning)
+		{
+			Record.clear();
+			return;
+		}
+
+		// Ring is full, wake the writer and give it time to drain
+		SetEvent(m_hEvent);
+		Sleep(0);
+	}
+
+	// Wake the writer early if records are piling up
+	if (Pos + 1 - RingDequeuePos.load(std::memory_order_relaxed) >= AsyncLogHighWater)
+	{
+		SetEvent(m_hEvent);
+	}
+}
+
+// Write all queued records to the log file, must hold the writer lock
+void Logging::DrainRing()
+{
+	size_t Pos = RingDequeuePos.load(std::memory_order_relaxed);
+	for (;;)
+	{
+		LOGSLOT& Slot = RingSlots[Pos & (AsyncLogRingSize - 1)];
+		if (Slot.Sequence.load(std::memory_order_acquire) != Pos + 1)
+		{
+			break;
+		}
+
+		WriteBatch.append(Slot.Record);
+		if (Slot.Record.capacity() > AsyncLogMaxRecordSize)
+		{
+			std::string().swap(Slot.Record);
+		}
+		else
+		{
+			Slot.Record.clear();
+		}
+		Slot.Sequence.store(Pos + AsyncLogRingSize, std::memory_order_release);
+		RingDequeuePos.store(++Pos, std::memory_order_relaxed);
+
+		if (WriteBatch.size() >= AsyncLogBatchSize)
+		{
+			FileBuffer->sputn(WriteBatch.data(), WriteBatch.size());
+			WriteBatch.clear();
+		}
+	}
+
+	if (!WriteBatch.empty())
+	{
+		FileBuffer->sputn(WriteBatch.data(), WriteBatch.size());
+		WriteBatch.clear();
+		FileBuffer->pubsync();
+	}
+}
+
+// Spin lock with a timeout, used where waiting on a dead or stuck thread must not block forever
+bool Logging::AcquireSpinLock(volatile LONG& Lock, DWORD TimeoutMS)
+{
+	DWORD StartTime = GetTickCount();
+	while (InterlockedCompareExchange(&Lock, 1, 0) != 0)
+	{
+		if (TimeoutMS != INFINITE && GetTickCount() - StartTime > TimeoutMS)
+		{
+			return false;
+		}
+		Sleep(0);
+	}
+	return true;
+}
+
+void Logging::ReleaseSpinLock(volatile LONG& Lock)
+{
+	InterlockedExchange(&Lock, 0);
+}
+
+// A flush from a crashing or exiting thread cannot block forever on a dead writer
+bool Logging::AcquireWriterLock(DWORD TimeoutMS)
+{
+	return AcquireSpinLock(WriterLock, TimeoutMS);
+}
+
+void Logging::ReleaseWriterLock()
+{
+	ReleaseSpinLock(WriterLock);
+}
+
+std::streambuf::int_type Logging::AsyncLogBuffer::overflow(int_type ch)
+{
+	if (!traits_type::eq_int_type(ch, traits_type::eof()))
+	{
+		THREADBUFFER& Buffer = GetThreadBuffer();
+		AcquireSpinLock(Buffer.Lock, INFINITE);
+		Buffer.Data.push_back(traits_type::to_char_type(ch));
+		if (Buffer.Data.size() >= AsyncLogMaxRecordSize)
+		{
+			CommitRecord(Buffer.Data);
+		}
+		ReleaseSpinLock(Buffer.Lock);
+	}
+	return traits_type::not_eof(ch);
+}
+
+std::streamsize Logging::AsyncLogBuffer::xsputn(const char* s, std::streamsize n)
+{
+	THREADBUFFER& Buffer = GetThreadBuffer();
+	AcquireSpinLock(Buffer.Lock, INFINITE);
+	Buffer.Data.append(s, (size_t)n);
+	if (Buffer.Data.size() >= AsyncLogMaxRecordSize)
+	{
+		CommitRecord(Buffer.Data);
+	}
+	ReleaseSpinLock(Buffer.Lock);
+	return n;
+}
+
+// Called by std::endl and flush at the end of each log line
+int Logging::AsyncLogBuffer::sync()
+{
+	THREADBUFFER& Buffer = GetThreadBuffer();
+	AcquireSpinLock(Buffer.Lock, INFINITE);
+	CommitRecord(Buffer.Data);
+	ReleaseSpinLock(Buffer.Lock);
+	return 0;
+}
+
+// Writer thread, batches queued records to disk
+DWORD WINAPI Logging::AsyncLogThreadFunc(LPVOID pvParam)
+{
+	UNREFERENCED_PARAMETER(pvParam);
+
+	while (!m_StopThreadFlag)
+	{
+		WaitForSingleObject(m_hEvent, AsyncLogFlushInterval);
+
+		if (AcquireWriterLock(INFINITE))
+		{
+			DrainRing();
+			ReleaseWriterLock();
+		}
+	}
+
+	return 0;
+}
+
+// Redirect the log stream to the asynchronous writer
+void Logging::StartAsyncLog()
+{
+	if (AsyncLogRunning || !LOG.is_open())
+	{
+		return;
+	}
+
+	if (TlsIndex == TLS_OUT_OF_INDEXES)
+	{
+		TlsIndex = TlsAlloc();
+		if (TlsIndex == TLS_OUT_OF_INDEXES)
+		{
+			Log() << __FUNCTION__ << " Error: failed to allocate TLS index!";
+			return;
+		}
+	}
+
+	for (size_t x = 0; x < AsyncLogRingSize; x++)
+	{
+		RingSlots[x].Sequence.store(x, std::memory_order_relaxed);
+	}
+	RingEnqueuePos = 0;
+	RingDequeuePos = 0;
+
+	m_hEvent = CreateEvent(nullptr, FALSE, FALSE, nullptr);
+	if (!m_hEvent)
+	{
+		Log() << __FUNCTION__ << " Error: failed to create event!";
+		return;
+	}
+
+	m_StopThreadFlag = false;
+	m_hThread = CreateThread(nullptr, 0, AsyncLogThreadFunc, nullptr, 0, &m_dwThreadID);
+	if (!m_hThread)
+	{
+		Log() << __FUNCTION__ << " Error: failed to create writer thread!";
+		CloseHandle(m_hEvent);
+		m_hEvent = nullptr;
+		return;
+	}
+
+	LOG.flush();
+	FileBuffer = LOG.rdbuf();
+	static_cast<std::ostream&>(LOG).rdbuf(&AsyncBuffer);
+	AsyncLogRunning = true;
+
+	Log() << "Asynchronous logging enabled";
+}
+
+// Write out everything queued so far, used on crash and exit
+void Logging::FlushAsyncLog()
+{
+	if (!AsyncLogRunning)
+	{
+		return;
+	}
+
+	THREADBUFFER& Buffer = GetThreadBuffer();
+	AcquireSpinLock(Buffer.Lock, INFINITE);
+	CommitRecord(Buffer.Data);
+	ReleaseSpinLock(Buffer.Lock);
+
+	if (AcquireWriterLock(AsyncLogFlushTimeout))
+	{
+		DrainRing();
+		ReleaseWriterLock();
+	}
+}
+
+// Stop the writer and write directly to the log file again
+void Logging::StopAsyncLog()
+{
+	if (!AsyncLogRunning)
+	{
+		return;
+	}
+
+	// Stop writer thread, module is pinned so the thread can finish on its own
+	m_StopThreadFlag = true;
+	SetEvent(m_hEvent);
+
+	// The file buffer can only be shared once the writer thread has exited and no flush is running
+	if (WaitForSingleObject(m_hThread, AsyncLogFlushTimeout) == WAIT_OBJECT_0 && AcquireWriterLock(AsyncLogFlushTimeout))
+	{
+		// Restore direct writes after draining so records stay in order
+		DrainRing();
+		static_cast<std::ostream&>(LOG).rdbuf(FileBuffer);
+		AsyncLogRunning = false;
+		DrainRing();
+
+		// Write partial records left in thread buffers, a buffer whose thread is still writing to it is skipped
+		AcquireSpinLock(ThreadBufferListLock, INFINITE);
+		for (THREADBUFFER* pBuffer = ThreadBufferList; pBuffer; pBuffer = pBuffer->Next)
+		{
+			if (AcquireSpinLock(pBuffer->Lock, AsyncLogFlushTimeout))
+			{
+				if (!pBuffer->Data.empty())
+				{
+					FileBuffer->sputn(pBuffer->Data.data(), pBuffer->Data.size());
+					FileBuffer->sputc('\n');
+					pBuffer->Data.clear();
+				}
+				ReleaseSpinLock(pBuffer->Lock);
+			}
+		}
+		ReleaseSpinLock(ThreadBufferListLock);
+		FileBuffer->pubsync();
+
+		ReleaseWriterLock();
+
+		CloseHandle(m_hEvent);
+		m_hEvent = nullptr;
+	}
+	else
+	{
+		// Writer is still running and may be writing to the file, turn the log off instead of sharing the file buffer.
+		// The event is left open for the writer to finish with.
+		static_cast<std::ostream&>(LOG).rdbuf(nullptr);
+		AsyncLogRunning = false;
+	}
+
+	CloseHandle(m_hThread);
+	m_hThread = nullptr;
+}
+
+// Free the calling thread's format buffer, called when the thread exits
+void Logging::ReleaseAsyncLogThread()
+{
+	if (TlsIndex == TLS_OUT_OF_INDEXES)
+	{
+		return;
+	}
+
+	THREADBUFFER* pBuffer = (THREADBUFFER*)TlsGetValue(TlsIndex);
+	if (!pBuffer)
+	{
+		return;
+	}
+	TlsSetValue(TlsIndex, nullptr);
+
+	AcquireSpinLock(ThreadBufferListLock, INFINITE);
+	for (THREADBUFFER** ppBuffer = &ThreadBufferList; *ppBuffer; ppBuffer = &(*ppBuffer)->Next)
+	{
+		if (*ppBuffer == pBuffer)
+		{
+			*ppBuffer = pBuffer->Next;
+			break;
+		}
+	}
+	ReleaseSpinLock(ThreadBufferListLock);
+
+	// Hand over a record the thread did not finish
+	if (AsyncLogRunning && !pBuffer->Data.empty())
+	{
+		pBuffer->Data.push_back('\n');
+		CommitRecord(pBuffer->Data);
+	}
+
+	delete pBuffer;
+}
+
+// Is asynchronous logging active
+bool Logging::IsAsyncLogRunning()
+{
+	return AsyncLogRunning;
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+namespace Logging
+{
+	void StartAsyncLog();
+	void FlushAsyncLog();
+	void StopAsyncLog();
+	void ReleaseAsyncLogThread();
+	bool IsAsyncLogRunning();
+}
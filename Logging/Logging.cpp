@@ -17,6 +17,8 @@
 #define INITGUID
 #define DIRECTINPUT_VERSION 0x0800
 
+#include <vector>
+#include <algorithm>
 #include <d3d9.h>
 #include <d3d9types.h>
 #include <ddraw.h>
@@ -839,192 +841,228 @@ DEFINE_GUID(IID_IMultiMediaStream, 0xb502d1bc, 0x9a57, 0x11d0, 0x8f, 0xde, 0x00,
 DEFINE_GUID(IID_IMediaStream, 0xb502d1bd, 0x9a57, 0x11d0, 0x8f, 0xde, 0x00, 0xc0, 0x4f, 0xd9, 0x18, 0x9d);
 DEFINE_GUID(IID_IStreamSample, 0xb502d1be, 0x9a57, 0x11d0, 0x8f, 0xde, 0x00, 0xc0, 0x4f, 0xd9, 0x18, 0x9d);
 
-std::ostream& operator<<(std::ostream& os, REFIID riid)
+struct REFIIDNAME
 {
-#define CHECK_REFIID(riidPrefix, riidName) \
-	if (riid == riidPrefix ## _ ## riidName) \
-	{ \
-		return os << #riidPrefix << "_" << #riidName; \
-	}
+	const GUID* riid;
+	const char* Name;
+};
+
+#define REFIID_ENTRY(riidPrefix, riidName) \
+	{ &riidPrefix ## _ ## riidName, #riidPrefix "_" #riidName },
 
-	CHECK_REFIID(IID, IUnknown);
-	CHECK_REFIID(IID, IClassFactory);
+// Known interfaces and GUIDs, if a GUID is listed more than once the first name is used
+static const REFIIDNAME RefIIDNames[] = {
+	REFIID_ENTRY(IID, IUnknown)
+	REFIID_ENTRY(IID, IClassFactory)
 	// ddraw
-	CHECK_REFIID(CLSID, DirectDraw);
-	CHECK_REFIID(CLSID, DirectDraw7);
-	CHECK_REFIID(CLSID, DirectDrawClipper);
-	CHECK_REFIID(IID, IDirectDraw);
-	CHECK_REFIID(IID, IDirectDraw2);
-	CHECK_REFIID(IID, IDirectDraw4);
-	CHECK_REFIID(IID, IDirectDraw7);
-	CHECK_REFIID(IID, IDirectDrawSurface);
-	CHECK_REFIID(IID, IDirectDrawSurface2);
-	CHECK_REFIID(IID, IDirectDrawSurface3);
-	CHECK_REFIID(IID, IDirectDrawSurface4);
-	CHECK_REFIID(IID, IDirectDrawSurface7);
-	CHECK_REFIID(IID, IDirectDrawPalette);
-	CHECK_REFIID(IID, IDirectDrawClipper);
-	CHECK_REFIID(IID, IDirectDrawColorControl);
-	CHECK_REFIID(IID, IDirectDrawGammaControl);
+	REFIID_ENTRY(CLSID, DirectDraw)
+	REFIID_ENTRY(CLSID, DirectDraw7)
+	REFIID_ENTRY(CLSID, DirectDrawClipper)
+	REFIID_ENTRY(IID, IDirectDraw)
+	REFIID_ENTRY(IID, IDirectDraw2)
+	REFIID_ENTRY(IID, IDirectDraw4)
+	REFIID_ENTRY(IID, IDirectDraw7)
+	REFIID_ENTRY(IID, IDirectDrawSurface)
+	REFIID_ENTRY(IID, IDirectDrawSurface2)
+	REFIID_ENTRY(IID, IDirectDrawSurface3)
+	REFIID_ENTRY(IID, IDirectDrawSurface4)
+	REFIID_ENTRY(IID, IDirectDrawSurface7)
+	REFIID_ENTRY(IID, IDirectDrawPalette)
+	REFIID_ENTRY(IID, IDirectDrawClipper)
+	REFIID_ENTRY(IID, IDirectDrawColorControl)
+	REFIID_ENTRY(IID, IDirectDrawGammaControl)
 	// ddrawex
-	CHECK_REFIID(IID, IDirectDraw3);
-	CHECK_REFIID(CLSID, DirectDrawFactory);
-	CHECK_REFIID(IID, IDirectDrawFactory);
+	REFIID_ENTRY(IID, IDirectDraw3)
+	REFIID_ENTRY(CLSID, DirectDrawFactory)
+	REFIID_ENTRY(IID, IDirectDrawFactory)
 	// d3d
-	CHECK_REFIID(IID, IDirect3D);
-	CHECK_REFIID(IID, IDirect3D2);
-	CHECK_REFIID(IID, IDirect3D3);
-	CHECK_REFIID(IID, IDirect3D7);
-	CHECK_REFIID(IID, IDirect3DRampDevice);
-	CHECK_REFIID(IID, IDirect3DRGBDevice);
-	CHECK_REFIID(IID, IDirect3DHALDevice);
-	CHECK_REFIID(IID, IDirect3DMMXDevice);
-	CHECK_REFIID(IID, IDirect3DRefDevice);
-	CHECK_REFIID(IID, IDirect3DNullDevice);
-	CHECK_REFIID(IID, IDirect3DTnLHalDevice);
-	CHECK_REFIID(IID, IDirect3DDevice);
-	CHECK_REFIID(IID, IDirect3DDevice2);
-	CHECK_REFIID(IID, IDirect3DDevice3);
-	CHECK_REFIID(IID, IDirect3DDevice7);
-	CHECK_REFIID(IID, IDirect3DTexture);
-	CHECK_REFIID(IID, IDirect3DTexture2);
-	CHECK_REFIID(IID, IDirect3DLight);
-	CHECK_REFIID(IID, IDirect3DMaterial);
-	CHECK_REFIID(IID, IDirect3DMaterial2);
-	CHECK_REFIID(IID, IDirect3DMaterial3);
-	CHECK_REFIID(IID, IDirect3DExecuteBuffer);
-	CHECK_REFIID(IID, IDirect3DViewport);
-	CHECK_REFIID(IID, IDirect3DViewport2);
-	CHECK_REFIID(IID, IDirect3DViewport3);
-	CHECK_REFIID(IID, IDirect3DVertexBuffer);
-	CHECK_REFIID(IID, IDirect3DVertexBuffer7);
+	REFIID_ENTRY(IID, IDirect3D)
+	REFIID_ENTRY(IID, IDirect3D2)
+	REFIID_ENTRY(IID, IDirect3D3)
+	REFIID_ENTRY(IID, IDirect3D7)
+	REFIID_ENTRY(IID, IDirect3DRampDevice)
+	REFIID_ENTRY(IID, IDirect3DRGBDevice)
+	REFIID_ENTRY(IID, IDirect3DHALDevice)
+	REFIID_ENTRY(IID, IDirect3DMMXDevice)
+	REFIID_ENTRY(IID, IDirect3DRefDevice)
+	REFIID_ENTRY(IID, IDirect3DNullDevice)
+	REFIID_ENTRY(IID, IDirect3DTnLHalDevice)
+	REFIID_ENTRY(IID, IDirect3DDevice)
+	REFIID_ENTRY(IID, IDirect3DDevice2)
+	REFIID_ENTRY(IID, IDirect3DDevice3)
+	REFIID_ENTRY(IID, IDirect3DDevice7)
+	REFIID_ENTRY(IID, IDirect3DTexture)
+	REFIID_ENTRY(IID, IDirect3DTexture2)
+	REFIID_ENTRY(IID, IDirect3DLight)
+	REFIID_ENTRY(IID, IDirect3DMaterial)
+	REFIID_ENTRY(IID, IDirect3DMaterial2)
+	REFIID_ENTRY(IID, IDirect3DMaterial3)
+	REFIID_ENTRY(IID, IDirect3DExecuteBuffer)
+	REFIID_ENTRY(IID, IDirect3DViewport)
+	REFIID_ENTRY(IID, IDirect3DViewport2)
+	REFIID_ENTRY(IID, IDirect3DViewport3)
+	REFIID_ENTRY(IID, IDirect3DVertexBuffer)
+	REFIID_ENTRY(IID, IDirect3DVertexBuffer7)
 	// d3d8
-	CHECK_REFIID(IID, IDirect3D8);
-	CHECK_REFIID(IID, IDirect3DDevice8);
-	CHECK_REFIID(IID, IDirect3DResource8);
-	CHECK_REFIID(IID, IDirect3DBaseTexture8);
-	CHECK_REFIID(IID, IDirect3DTexture8);
-	CHECK_REFIID(IID, IDirect3DCubeTexture8);
-	CHECK_REFIID(IID, IDirect3DVolumeTexture8);
-	CHECK_REFIID(IID, IDirect3DVertexBuffer8);
-	CHECK_REFIID(IID, IDirect3DIndexBuffer8);
-	CHECK_REFIID(IID, IDirect3DSurface8);
-	CHECK_REFIID(IID, IDirect3DVolume8);
-	CHECK_REFIID(IID, IDirect3DSwapChain8);
+	REFIID_ENTRY(IID, IDirect3D8)
+	REFIID_ENTRY(IID, IDirect3DDevice8)
+	REFIID_ENTRY(IID, IDirect3DResource8)
+	REFIID_ENTRY(IID, IDirect3DBaseTexture8)
+	REFIID_ENTRY(IID, IDirect3DTexture8)
+	REFIID_ENTRY(IID, IDirect3DCubeTexture8)
+	REFIID_ENTRY(IID, IDirect3DVolumeTexture8)
+	REFIID_ENTRY(IID, IDirect3DVertexBuffer8)
+	REFIID_ENTRY(IID, IDirect3DIndexBuffer8)
+	REFIID_ENTRY(IID, IDirect3DSurface8)
+	REFIID_ENTRY(IID, IDirect3DVolume8)
+	REFIID_ENTRY(IID, IDirect3DSwapChain8)
 	// d3d9
-	CHECK_REFIID(IID, IDirect3D9);
-	CHECK_REFIID(IID, IDirect3DDevice9);
-	CHECK_REFIID(IID, IDirect3DResource9);
-	CHECK_REFIID(IID, IDirect3DBaseTexture9);
-	CHECK_REFIID(IID, IDirect3DTexture9);
-	CHECK_REFIID(IID, IDirect3DCubeTexture9);
-	CHECK_REFIID(IID, IDirect3DVolumeTexture9);
-	CHECK_REFIID(IID, IDirect3DVertexBuffer9);
-	CHECK_REFIID(IID, IDirect3DIndexBuffer9);
-	CHECK_REFIID(IID, IDirect3DSurface9);
-	CHECK_REFIID(IID, IDirect3DVolume9);
-	CHECK_REFIID(IID, IDirect3DSwapChain9);
-	CHECK_REFIID(IID, IDirect3DVertexDeclaration9);
-	CHECK_REFIID(IID, IDirect3DVertexShader9);
-	CHECK_REFIID(IID, IDirect3DPixelShader9);
-	CHECK_REFIID(IID, IDirect3DStateBlock9);
-	CHECK_REFIID(IID, IDirect3DQuery9);
-	CHECK_REFIID(IID, HelperName);
-	CHECK_REFIID(IID, IDirect3D9Ex);
-	CHECK_REFIID(IID, IDirect3DDevice9Ex);
-	CHECK_REFIID(IID, IDirect3DSwapChain9Ex);
-	CHECK_REFIID(IID, IDirect3D9ExOverlayExtension);
-	CHECK_REFIID(IID, IDirect3DDevice9Video);
-	CHECK_REFIID(IID, IDirect3DAuthenticatedChannel9);
-	CHECK_REFIID(IID, IDirect3DCryptoSession9);
+	REFIID_ENTRY(IID, IDirect3D9)
+	REFIID_ENTRY(IID, IDirect3DDevice9)
+	REFIID_ENTRY(IID, IDirect3DResource9)
+	REFIID_ENTRY(IID, IDirect3DBaseTexture9)
+	REFIID_ENTRY(IID, IDirect3DTexture9)
+	REFIID_ENTRY(IID, IDirect3DCubeTexture9)
+	REFIID_ENTRY(IID, IDirect3DVolumeTexture9)
+	REFIID_ENTRY(IID, IDirect3DVertexBuffer9)
+	REFIID_ENTRY(IID, IDirect3DIndexBuffer9)
+	REFIID_ENTRY(IID, IDirect3DSurface9)
+	REFIID_ENTRY(IID, IDirect3DVolume9)
+	REFIID_ENTRY(IID, IDirect3DSwapChain9)
+	REFIID_ENTRY(IID, IDirect3DVertexDeclaration9)
+	REFIID_ENTRY(IID, IDirect3DVertexShader9)
+	REFIID_ENTRY(IID, IDirect3DPixelShader9)
+	REFIID_ENTRY(IID, IDirect3DStateBlock9)
+	REFIID_ENTRY(IID, IDirect3DQuery9)
+	REFIID_ENTRY(IID, HelperName)
+	REFIID_ENTRY(IID, IDirect3D9Ex)
+	REFIID_ENTRY(IID, IDirect3DDevice9Ex)
+	REFIID_ENTRY(IID, IDirect3DSwapChain9Ex)
+	REFIID_ENTRY(IID, IDirect3D9ExOverlayExtension)
+	REFIID_ENTRY(IID, IDirect3DDevice9Video)
+	REFIID_ENTRY(IID, IDirect3DAuthenticatedChannel9)
+	REFIID_ENTRY(IID, IDirect3DCryptoSession9)
 	// dinput
-	CHECK_REFIID(CLSID, DirectInput);
-	CHECK_REFIID(CLSID, DirectInputDevice);
-	CHECK_REFIID(CLSID, DirectInput8);
-	CHECK_REFIID(CLSID, DirectInputDevice8);
-	CHECK_REFIID(IID, IDirectInputA);
-	CHECK_REFIID(IID, IDirectInputW);
-	CHECK_REFIID(IID, IDirectInput2A);
-	CHECK_REFIID(IID, IDirectInput2W);
-	CHECK_REFIID(IID, IDirectInput7A);
-	CHECK_REFIID(IID, IDirectInput7W);
-	CHECK_REFIID(IID, IDirectInput8A);
-	CHECK_REFIID(IID, IDirectInput8W);
-	CHECK_REFIID(IID, IDirectInputDeviceA);
-	CHECK_REFIID(IID, IDirectInputDeviceW);
-	CHECK_REFIID(IID, IDirectInputDevice2A);
-	CHECK_REFIID(IID, IDirectInputDevice2W);
-	CHECK_REFIID(IID, IDirectInputDevice7A);
-	CHECK_REFIID(IID, IDirectInputDevice7W);
-	CHECK_REFIID(IID, IDirectInputDevice8A);
-	CHECK_REFIID(IID, IDirectInputDevice8W);
-	CHECK_REFIID(IID, IDirectInputEffect);
+	REFIID_ENTRY(CLSID, DirectInput)
+	REFIID_ENTRY(CLSID, DirectInputDevice)
+	REFIID_ENTRY(CLSID, DirectInput8)
+	REFIID_ENTRY(CLSID, DirectInputDevice8)
+	REFIID_ENTRY(IID, IDirectInputA)
+	REFIID_ENTRY(IID, IDirectInputW)
+	REFIID_ENTRY(IID, IDirectInput2A)
+	REFIID_ENTRY(IID, IDirectInput2W)
+	REFIID_ENTRY(IID, IDirectInput7A)
+	REFIID_ENTRY(IID, IDirectInput7W)
+	REFIID_ENTRY(IID, IDirectInput8A)
+	REFIID_ENTRY(IID, IDirectInput8W)
+	REFIID_ENTRY(IID, IDirectInputDeviceA)
+	REFIID_ENTRY(IID, IDirectInputDeviceW)
+	REFIID_ENTRY(IID, IDirectInputDevice2A)
+	REFIID_ENTRY(IID, IDirectInputDevice2W)
+	REFIID_ENTRY(IID, IDirectInputDevice7A)
+	REFIID_ENTRY(IID, IDirectInputDevice7W)
+	REFIID_ENTRY(IID, IDirectInputDevice8A)
+	REFIID_ENTRY(IID, IDirectInputDevice8W)
+	REFIID_ENTRY(IID, IDirectInputEffect)
 	// Predefined object types
-	CHECK_REFIID(GUID, XAxis);
-	CHECK_REFIID(GUID, YAxis);
-	CHECK_REFIID(GUID, ZAxis);
-	CHECK_REFIID(GUID, RxAxis);
-	CHECK_REFIID(GUID, RyAxis);
-	CHECK_REFIID(GUID, RzAxis);
-	CHECK_REFIID(GUID, Slider);
-	CHECK_REFIID(GUID, Button);
-	CHECK_REFIID(GUID, Key);
-	CHECK_REFIID(GUID, POV);
-	CHECK_REFIID(GUID, Unknown);
+	REFIID_ENTRY(GUID, XAxis)
+	REFIID_ENTRY(GUID, YAxis)
+	REFIID_ENTRY(GUID, ZAxis)
+	REFIID_ENTRY(GUID, RxAxis)
+	REFIID_ENTRY(GUID, RyAxis)
+	REFIID_ENTRY(GUID, RzAxis)
+	REFIID_ENTRY(GUID, Slider)
+	REFIID_ENTRY(GUID, Button)
+	REFIID_ENTRY(GUID, Key)
+	REFIID_ENTRY(GUID, POV)
+	REFIID_ENTRY(GUID, Unknown)
 	// Predefined product GUIDs
-	CHECK_REFIID(GUID, SysMouse);
-	CHECK_REFIID(GUID, SysKeyboard);
-	CHECK_REFIID(GUID, Joystick);
-	CHECK_REFIID(GUID, SysMouseEm);
-	CHECK_REFIID(GUID, SysMouseEm2);
-	CHECK_REFIID(GUID, SysKeyboardEm);
-	CHECK_REFIID(GUID, SysKeyboardEm2);
+	REFIID_ENTRY(GUID, SysMouse)
+	REFIID_ENTRY(GUID, SysKeyboard)
+	REFIID_ENTRY(GUID, Joystick)
+	REFIID_ENTRY(GUID, SysMouseEm)
+	REFIID_ENTRY(GUID, SysMouseEm2)
+	REFIID_ENTRY(GUID, SysKeyboardEm)
+	REFIID_ENTRY(GUID, SysKeyboardEm2)
 	// Predefined force feedback effects
-	CHECK_REFIID(GUID, ConstantForce);
-	CHECK_REFIID(GUID, RampForce);
-	CHECK_REFIID(GUID, Square);
-	CHECK_REFIID(GUID, Sine);
-	CHECK_REFIID(GUID, Triangle);
-	CHECK_REFIID(GUID, SawtoothUp);
-	CHECK_REFIID(GUID, SawtoothDown);
-	CHECK_REFIID(GUID, Spring);
-	CHECK_REFIID(GUID, Damper);
-	CHECK_REFIID(GUID, Inertia);
-	CHECK_REFIID(GUID, Friction);
-	CHECK_REFIID(GUID, CustomForce);
+	REFIID_ENTRY(GUID, ConstantForce)
+	REFIID_ENTRY(GUID, RampForce)
+	REFIID_ENTRY(GUID, Square)
+	REFIID_ENTRY(GUID, Sine)
+	REFIID_ENTRY(GUID, Triangle)
+	REFIID_ENTRY(GUID, SawtoothUp)
+	REFIID_ENTRY(GUID, SawtoothDown)
+	REFIID_ENTRY(GUID, Spring)
+	REFIID_ENTRY(GUID, Damper)
+	REFIID_ENTRY(GUID, Inertia)
+	REFIID_ENTRY(GUID, Friction)
+	REFIID_ENTRY(GUID, CustomForce)
 	// DirectShow
-	CHECK_REFIID(CLSID, AMMultiMediaStream);
-	CHECK_REFIID(CLSID, AMDirectDrawStream);
-	CHECK_REFIID(CLSID, AMAudioStream);
-	CHECK_REFIID(CLSID, AMAudioData);
-	CHECK_REFIID(CLSID, AMMediaTypeStream);
-	CHECK_REFIID(IID, IAMMultiMediaStream);
-	CHECK_REFIID(IID, IAMMediaStream);
-	CHECK_REFIID(IID, IMediaStreamFilter);
-	CHECK_REFIID(IID, IDirectDrawMediaSampleAllocator);
-	CHECK_REFIID(IID, IDirectDrawMediaSample);
-	CHECK_REFIID(IID, IAMMediaTypeStream);
-	CHECK_REFIID(IID, IAMMediaTypeSample);
-	CHECK_REFIID(IID, IDirectDrawStreamSample);
-	CHECK_REFIID(IID, IDirectDrawMediaStream);
-	CHECK_REFIID(IID, IDDVideoAcceleratorContainer);
-	CHECK_REFIID(IID, IDirectDrawVideoAccelerator);
+	REFIID_ENTRY(CLSID, AMMultiMediaStream)
+	REFIID_ENTRY(CLSID, AMDirectDrawStream)
+	REFIID_ENTRY(CLSID, AMAudioStream)
+	REFIID_ENTRY(CLSID, AMAudioData)
+	REFIID_ENTRY(CLSID, AMMediaTypeStream)
+	REFIID_ENTRY(IID, IAMMultiMediaStream)
+	REFIID_ENTRY(IID, IAMMediaStream)
+	REFIID_ENTRY(IID, IMediaStreamFilter)
+	REFIID_ENTRY(IID, IDirectDrawMediaSampleAllocator)
+	REFIID_ENTRY(IID, IDirectDrawMediaSample)
+	REFIID_ENTRY(IID, IAMMediaTypeStream)
+	REFIID_ENTRY(IID, IAMMediaTypeSample)
+	REFIID_ENTRY(IID, IDirectDrawStreamSample)
+	REFIID_ENTRY(IID, IDirectDrawMediaStream)
+	REFIID_ENTRY(IID, IDDVideoAcceleratorContainer)
+	REFIID_ENTRY(IID, IDirectDrawVideoAccelerator)
 	// multimedia
-	CHECK_REFIID(CLSID, MMDeviceEnumerator);
-	CHECK_REFIID(IID, IMMNotificationClient);
-	CHECK_REFIID(IID, IMMDevice);
-	CHECK_REFIID(IID, IMMDeviceCollection);
-	CHECK_REFIID(IID, IMMEndpoint);
-	CHECK_REFIID(IID, IMMDeviceEnumerator);
-	CHECK_REFIID(IID, IMMDeviceActivator);
-	CHECK_REFIID(IID, IActivateAudioInterfaceCompletionHandler);
-	CHECK_REFIID(IID, IActivateAudioInterfaceAsyncOperation);
-	CHECK_REFIID(IID, IMultiMediaStream);
-	CHECK_REFIID(IID, IMediaStream);
-	CHECK_REFIID(IID, IStreamSample);
+	REFIID_ENTRY(CLSID, MMDeviceEnumerator)
+	REFIID_ENTRY(IID, IMMNotificationClient)
+	REFIID_ENTRY(IID, IMMDevice)
+	REFIID_ENTRY(IID, IMMDeviceCollection)
+	REFIID_ENTRY(IID, IMMEndpoint)
+	REFIID_ENTRY(IID, IMMDeviceEnumerator)
+	REFIID_ENTRY(IID, IMMDeviceActivator)
+	REFIID_ENTRY(IID, IActivateAudioInterfaceCompletionHandler)
+	REFIID_ENTRY(IID, IActivateAudioInterfaceAsyncOperation)
+	REFIID_ENTRY(IID, IMultiMediaStream)
+	REFIID_ENTRY(IID, IMediaStream)
+	REFIID_ENTRY(IID, IStreamSample)
 	// dxwrapper specific
-	CHECK_REFIID(IID, GetRealInterface);
-	CHECK_REFIID(IID, GetInterfaceX);
+	REFIID_ENTRY(IID, GetRealInterface)
+	REFIID_ENTRY(IID, GetInterfaceX)
+};
+
+// Lookup table of known GUIDs sorted by value, built once on first use
+static const std::vector<const REFIIDNAME*>& GetSortedRefIIDNames()
+{
+	static const std::vector<const REFIIDNAME*> SortedNames = []()
+	{
+		std::vector<const REFIIDNAME*> Names;
+		Names.reserve(std::size(RefIIDNames));
+		for (const REFIIDNAME& Entry : RefIIDNames)
+		{
+			Names.push_back(&Entry);
+		}
+		std::stable_sort(Names.begin(), Names.end(), [](const REFIIDNAME* a, const REFIIDNAME* b)
+			{
+				return memcmp(a->riid, b->riid, sizeof(GUID)) < 0;
+			});
+		return Names;
+	}();
+	return SortedNames;
+}
+
+std::ostream& operator<<(std::ostream& os, REFIID riid)
+{
+	const std::vector<const REFIIDNAME*>& SortedNames = GetSortedRefIIDNames();
+	auto it = std::lower_bound(SortedNames.begin(), SortedNames.end(), &riid, [](const REFIIDNAME* a, const GUID* b)
+		{
+			return memcmp(a->riid, b, sizeof(GUID)) < 0;
+		});
+	if (it != SortedNames.end() && memcmp((*it)->riid, &riid, sizeof(GUID)) == 0)
+	{
+		return os << (*it)->Name;
+	}
 
 	UINT x = 0;
 	char buffer[(sizeof(IID) * 2) + 5] = { '\0' };
@@ -20,12 +20,15 @@
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
 #include <stdlib.h>
+#include <string>
 #include "ReadParse.h"
 
 namespace Settings
 {
-	void EraseCppComments(char* str);
 	bool IsValidSettings(char* name, char* value);
+	bool IsWhiteSpace(char c);
+	char* TrimEnd(char* begin, char* end);
+	void ParseBuffer(char* str, char* end, NV NameValueCallback);
 }
 
 // Reads szFileName from disk
@@ -64,6 +67,34 @@ char* Settings::Read(char* szFileName)
 	return szCfg;
 }
 
+// Maps szFileName copy-on-write and parses it in place, returns false if the file could not be read
+bool Settings::ReadAndParse(const char* szFileName, NV NameValueCallback)
+{
+	bool Result = false;
+	HANDLE hFile = CreateFileA(szFileName, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (hFile != INVALID_HANDLE_VALUE)
+	{
+		DWORD dwFileSize = GetFileSize(hFile, nullptr);
+		if ((dwFileSize != 0) && (dwFileSize != 0xFFFFFFFF))
+		{
+			HANDLE hMapping = CreateFileMappingA(hFile, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+			if (hMapping)
+			{
+				char* szCfg = (char*)MapViewOfFile(hMapping, FILE_MAP_COPY, 0, 0, 0);
+				if (szCfg)
+				{
+					Result = true;
+					ParseBuffer(szCfg, szCfg + dwFileSize, NameValueCallback);
+					UnmapViewOfFile(szCfg);
+				}
+				CloseHandle(hMapping);
+			}
+		}
+		CloseHandle(hFile);
+	}
+	return Result;
+}
+
 // Check if the values are valid
 bool Settings::IsValidSettings(char* name, char* value)
 {
@@ -71,9 +102,7 @@ bool Settings::IsValidSettings(char* name, char* value)
 	{
 		return false;
 	}
-	if (strlen(name) == 0 || strlen(value) == 0 ||
-		strlen(name) == ((size_t)(-1)) || strlen(value) == ((size_t)(-1)) ||
-		name[0] == '\0' || value[0] == '\0' ||
+	if (name[0] == '\0' || value[0] == '\0' ||
 		!_stricmp(value, "AUTO"))
 	{
 		return false;
@@ -81,38 +110,129 @@ bool Settings::IsValidSettings(char* name, char* value)
 	return true;
 }
 
-// Commented text is replaced with a space character
-void Settings::EraseCppComments(char* str)
+// characters considered to be whitespace:
+//  0x20 - space
+//	0x09 - horizontal tab
+//	0x0D - carriage return
+inline bool Settings::IsWhiteSpace(char c)
+{
+	return (c == '\x20' || c == '\t' || c == '\r');
+}
+
+// Returns the end of the string after removing trailing whitespace
+inline char* Settings::TrimEnd(char* begin, char* end)
 {
-	while ((str = strchr(str, '/')) != 0)
+	while (end > begin && IsWhiteSpace(end[-1]))
 	{
-		if (str[1] == '/')
+		end--;
+	}
+	return end;
+}
+
+// Single pass over the buffer, the buffer is modified in place:
+// comments are replaced with space characters and names and values are null terminated
+void Settings::ParseBuffer(char* str, char* end, NV NameValueCallback)
+{
+	while (str < end && *str != '\0')
+	{
+		// Skip empty lines
+		if (*str == '\n')
 		{
-			for (; ((*str != '\0') && (*str != '\n')); str++)
-			{
-				*str = '\x20';
-			}
+			str++;
+			continue;
 		}
-		else if (str[1] == '*')
+
+		// Skip INI style comments ( must be at start of line )
+		bool SkipLine = (*str == ';' || *str == '#');
+
+		char* line = str;
+		char* equal = nullptr;
+		char* colon = nullptr;
+
+		// Find end of line, C++ comments are blanked as they are found
+		for (; str < end && *str != '\0' && *str != '\n'; str++)
 		{
-			for (; ((*str != '\0') && ((str[0] != '*') || (str[1] != '/'))); str++)
+			if (*str == '/' && str + 1 < end)
 			{
-				*str = '\x20';
+				if (str[1] == '/')
+				{
+					for (; str < end && *str != '\0' && *str != '\n'; str++)
+					{
+						*str = '\x20';
+					}
+					break;
+				}
+				else if (str[1] == '*')
+				{
+					// Block comments can span several lines, which joins them into a single line
+					for (; str < end && *str != '\0' && (str[0] != '*' || str + 1 >= end || str[1] != '/'); str++)
+					{
+						*str = '\x20';
+					}
+					if (str < end && *str == '*')
+					{
+						*str++ = '\x20';
+						*str = '\x20';
+					}
+					else
+					{
+						break;
+					}
+					continue;
+				}
 			}
-			if (*str)
+			if (*str == '=' && !equal)
 			{
-				*str++ = '\x20';
-				*str = '\x20';
+				equal = str;
 			}
+			else if (*str == ':' && !colon)
+			{
+				colon = str;
+			}
+		}
+		char* lineEnd = str;
+
+		// Name/value delimiter is an equal sign or colon
+		char* delimiter = (equal) ? equal : colon;
+		if (SkipLine || !delimiter)
+		{
+			continue;
 		}
-		if (*str)
+
+		// Whitespace is removed from before and after both the name and value
+		char* lvalue = line;
+		while (lvalue < delimiter && IsWhiteSpace(*lvalue))
 		{
-			str++;
+			lvalue++;
+		}
+		*TrimEnd(lvalue, delimiter) = '\0';
+
+		char* rvalue = delimiter + 1;
+		while (rvalue < lineEnd && IsWhiteSpace(*rvalue))
+		{
+			rvalue++;
 		}
-		else
+		char* rvalueEnd = TrimEnd(rvalue, lineEnd);
+
+		// Value ends at the end of the buffer so there is no room for a terminator
+		if (rvalueEnd == end)
 		{
+			std::string value(rvalue, rvalueEnd);
+			if (IsValidSettings(lvalue, &value[0]))
+			{
+				NameValueCallback(lvalue, &value[0]);
+			}
 			break;
 		}
+		*rvalueEnd = '\0';
+
+		if (IsValidSettings(lvalue, rvalue))
+		{
+			NameValueCallback(lvalue, rvalue);
+		}
+
+		// Continue after the terminated value
+		str = (lineEnd > rvalueEnd) ? lineEnd : rvalueEnd + 1;
 	}
 }
 
@@ -121,45 +241,7 @@ void Settings::EraseCppComments(char* str)
 // double quotes NOT suppoted
 // Name/value delimiter is an equal sign or colon 
 // whitespace is removed from before and after both the name and value
-// characters considered to be whitespace:
-//  0x20 - space
-//	0x09 - horizontal tab
-//	0x0D - carriage return
 void Settings::Parse(char* str, NV NameValueCallback)
 {
-	char *next_token = nullptr;
-	EraseCppComments(str);
-	for (str = strtok_s(str, "\n", &next_token); str; str = strtok_s(0, "\n", &next_token))
-	{
-		if (*str == ';' || *str == '#')
-		{
-			continue; // skip INI style comments ( must be at start of line )
-		}
-		char* rvalue = strchr(str, '=');
-		if (!rvalue)
-		{
-			rvalue = strchr(str, ':');
-		}
-		if (rvalue)
-		{
-			*rvalue++ = '\0'; // split left and right values
-
-			rvalue = &rvalue[strspn(rvalue, "\x20\t\r")]; // skip beginning whitespace
-			for (char* end = strchr(rvalue, '\0'); (--end >= rvalue) && (*end == '\x20' || *end == '\t' || *end == '\r');)
-			{
-				*end = '\0';  // truncate ending whitespace
-			}
-
-			char* lvalue = &str[strspn(str, "\x20\t\r")]; // skip beginning whitespace
-			for (char* end = strchr(lvalue, '\0'); (--end >= lvalue) && (*end == '\x20' || *end == '\t' || *end == '\r');)
-			{
-				*end = '\0';  // truncate ending whitespace
-			}
-
-			if (*lvalue && *rvalue && IsValidSettings(lvalue, rvalue))
-			{
-				NameValueCallback(lvalue, rvalue);
-			}
-		}
-	}
+	ParseBuffer(str, str + strlen(str), NameValueCallback);
 }
@@ -4,5 +4,6 @@ namespace Settings
 {
 	typedef void(__stdcall* NV)(char* name, char* value);
 	char* Read(char* szFileName);
+	bool ReadAndParse(const char* szFileName, NV NameValueCallback);
 	void Parse(char* str, NV NameValueCallback);
 }
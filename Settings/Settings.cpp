@@ -61,6 +61,8 @@ namespace Settings
 	void SetValue(char*, char*, float*);
 	void SetValue(char*, char*, double*);
 	void SetValue(char*, char*, bool*);
+	struct SETTINGENTRY;
+	const SETTINGENTRY* FindSetting(const char*);
 	void __stdcall ParseCallback(char*, char*);
 	void SetDefaultConfigSettings();
 	UINT GetWrapperMode(std::string *name);
@@ -70,26 +72,25 @@ namespace Settings
 	visit(Force16bitColor) \
 	visit(Force32bitColor)
 
-#define SET_LOCAL_VALUE(functionName) \
-	if (!_stricmp(name, #functionName)) \
-	{ \
-		SetValue(name, value, &functionName); \
-		return; \
-	}
+#define VISIT_LEGACY_SETTINGS(visit) \
+	visit(AutoFrameSkip) \
+	visit(DdrawOverrideRefreshRate) \
+	visit(DSoundCtrl) \
+	visit(DDrawCompatExperimental) \
+	visit(DDrawCompat30) \
+	visit(DDrawCompat31)
 
-#define SET_VALUE(functionName) \
-	if (!_stricmp(name, #functionName)) \
-	{ \
-		SetValue(name, value, &Config.functionName); \
-		return; \
-	}
+#define SETTING_ENTRY(functionName, setting) \
+	{ #functionName, [](char* name, char* value) { SetValue(name, value, setting); } },
 
-#define SET_APPCOMPATDATA_VALUE(functionName) \
-	if (!_stricmp(name, #functionName)) \
-	{ \
-		SetValue(name, value, &Config.DXPrimaryEmulation[AppCompatDataType.functionName]); \
-		return; \
-	}
+#define LOCAL_SETTING_ENTRY(functionName) \
+	SETTING_ENTRY(functionName, &functionName)
+
+#define CONFIG_SETTING_ENTRY(functionName) \
+	SETTING_ENTRY(functionName, &Config.functionName)
+
+#define APPCOMPATDATA_SETTING_ENTRY(functionName) \
+	SETTING_ENTRY(functionName, &Config.DXPrimaryEmulation[AppCompatDataType.functionName])
 
 #define CLEAR_VALUE(functionName) \
 	ClearValue(&Config.functionName);
@@ -278,6 +279,99 @@ void Settings::SetValue(char* name, char* value, bool* setting)
 	}
 }
 
+namespace Settings
+{
+	struct SETTINGENTRY
+	{
+		const char* Name;
+		void(*SetSetting)(char* name, char* value);
+	};
+
+	// All settings that are set by name, if a name is listed more than once the first entry is used
+	static constexpr SETTINGENTRY SettingsList[] = {
+		VISIT_LEGACY_SETTINGS(LOCAL_SETTING_ENTRY)
+		VISIT_LOCAL_SETTINGS(LOCAL_SETTING_ENTRY)
+		VISIT_CONFIG_SETTINGS(CONFIG_SETTING_ENTRY)
+		VISIT_APPCOMPATDATA_SETTINGS(APPCOMPATDATA_SETTING_ENTRY)
+	};
+	constexpr size_t SettingsCount = sizeof(SettingsList) / sizeof(*SettingsList);
+
+	// Open addressing hash table of indexes into SettingsList, must be a power of two
+	constexpr size_t SettingsHashSize = 512;
+	static_assert(SettingsHashSize >= SettingsCount * 2, "SettingsHashSize is too small for the settings list!");
+
+	struct SETTINGSHASHTABLE
+	{
+		WORD Index[SettingsHashSize];	// Index + 1 into SettingsList, zero for empty
+	};
+
+	// Case insensitive FNV-1a hash
+	constexpr DWORD HashSettingName(const char* name)
+	{
+		DWORD hash = 2166136261UL;
+		for (; *name; name++)
+		{
+			char c = (*name >= 'A' && *name <= 'Z') ? *name + ('a' - 'A') : *name;
+			hash = (hash ^ (BYTE)c) * 16777619UL;
+		}
+		return hash;
+	}
+
+	constexpr bool IsSameSettingName(const char* a, const char* b)
+	{
+		for (; *a && *b; a++, b++)
+		{
+			char ca = (*a >= 'A' && *a <= 'Z') ? *a + ('a' - 'A') : *a;
+			char cb = (*b >= 'A' && *b <= 'Z') ? *b + ('a' - 'A') : *b;
+			if (ca != cb)
+			{
+				return false;
+			}
+		}
+		return *a == *b;
+	}
+
+	constexpr SETTINGSHASHTABLE BuildSettingsHashTable()
+	{
+		SETTINGSHASHTABLE Table = {};
+		for (size_t x = 0; x < SettingsCount; x++)
+		{
+			size_t Slot = HashSettingName(SettingsList[x].Name) & (SettingsHashSize - 1);
+			bool Exists = false;
+			while (Table.Index[Slot])
+			{
+				if (IsSameSettingName(SettingsList[Table.Index[Slot] - 1].Name, SettingsList[x].Name))
+				{
+					Exists = true;
+					break;
+				}
+				Slot = (Slot + 1) & (SettingsHashSize - 1);
+			}
+			if (!Exists)
+			{
+				Table.Index[Slot] = (WORD)(x + 1);
+			}
+		}
+		return Table;
+	}
+
+	static constexpr SETTINGSHASHTABLE SettingsHashTable = BuildSettingsHashTable();
+}
+
+// Find setting by name using the prebuilt hash table
+const Settings::SETTINGENTRY* Settings::FindSetting(const char* name)
+{
+	for (size_t Slot = HashSettingName(name) & (SettingsHashSize - 1); SettingsHashTable.Index[Slot]; Slot = (Slot + 1) & (SettingsHashSize - 1))
+	{
+		const SETTINGENTRY& Entry = SettingsList[SettingsHashTable.Index[Slot] - 1];
+		if (!_stricmp(name, Entry.Name))
+		{
+			return &Entry;
+		}
+	}
+	return nullptr;
+}
+
 // Set config from string (file)
 void __stdcall Settings::ParseCallback(char* name, char* value)
 {
@@ -287,19 +381,13 @@ void __stdcall Settings::ParseCallback(char* name, char* value)
 		Config.DisableMaxWindowedModeNotSet = false;
 	}
 
-	// For legacy settings
-	SET_LOCAL_VALUE(AutoFrameSkip);
-	SET_LOCAL_VALUE(DdrawOverrideRefreshRate);
-	SET_LOCAL_VALUE(DSoundCtrl);
-	SET_LOCAL_VALUE(DDrawCompatExperimental);
-	SET_LOCAL_VALUE(DDrawCompat30);
-	SET_LOCAL_VALUE(DDrawCompat31);
-
-	// Set Value of local settings
-	VISIT_LOCAL_SETTINGS(SET_LOCAL_VALUE);
-
-	// Set Value of normal config settings
-	VISIT_CONFIG_SETTINGS(SET_VALUE);
+	// Set Value of legacy, local, normal and AppCompatData config settings
+	const SETTINGENTRY* Setting = FindSetting(name);
+	if (Setting)
+	{
+		Setting->SetSetting(name, value);
+		return;
+	}
 
 	// Set Value of AppCompatData LockColorkey setting
 	if (!_stricmp(name, "LockColorkey"))
@@ -309,9 +397,6 @@ void __stdcall Settings::ParseCallback(char* name, char* value)
 		return;
 	}
 
-	// Set Value of AppCompatData config settings
-	VISIT_APPCOMPATDATA_SETTINGS(SET_APPCOMPATDATA_VALUE);
-
 	// Set Value of Memory Hack config settings
 	if (!_stricmp(name, "VerificationAddress"))
 	{
@@ -539,15 +624,10 @@ void CONFIG::Init()
 	strcat_s(configpath, MAX_PATH, p_pName);
 	strcpy_s(strrchr(configpath, '.'), MAX_PATH - strlen(configpath), ".ini");
 
-	// Read defualt config file
-	char* szCfg = Read(configpath);
-
-	// Parce config file
-	if (szCfg)
+	// Read and parse defualt config file
+	if (ReadAndParse(configpath, ParseCallback))
 	{
 		ConfigLoaded = true;
-		Parse(szCfg, ParseCallback);
-		free(szCfg);
 	}
 	// If cannot load config file check for default config
 	else
@@ -556,15 +636,10 @@ void CONFIG::Init()
 		strcpy_s(configpath, MAX_PATH, wrappername);
 		strcpy_s(strrchr(configpath, '.'), MAX_PATH - strlen(configpath), ".ini");
 
-		// Open config file
-		szCfg = Read(configpath);
-
-		// Parce config file
-		if (szCfg)
+		// Read and parse config file
+		if (ReadAndParse(configpath, ParseCallback))
 		{
 			ConfigLoaded = true;
-			Parse(szCfg, ParseCallback);
-			free(szCfg);
 		}
 	}
 
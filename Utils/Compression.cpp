@@ -0,0 +1,261 @@
+/**
+* Copyright (C) 2024 Elisha Riedlinger
+*
+* This software is  provided 'as-is', without any express  or implied  warranty. In no event will the
+* authors be held liable for any damages arising from the use of this software.
+* Permission  is granted  to anyone  to use  this software  for  any  purpose,  including  commercial
+* applications, and to alter it and redistribute it freely, subject to the following restrictions:
+*
+*   1. The origin of this software must not be misrepresented; you must not claim that you  wrote the
+*      original  software. If you use this  software  in a product, an  acknowledgment in the product
+*      documentation would be appreciated but is not required.
+*   2. Altered source versions must  be plainly  marked as such, and  must not be  misrepresented  as
+*      being the original software.
+*   3. This notice may not be removed or altered from any source distribution.
+*
+* Compressor writes the LZ4 block format, see https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+*/
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include "Utils.h"
+
+namespace Utils
+{
+	// Number of bits used for the match finder hash table
+	constexpr DWORD LZ4HashLog = 12;
+
+	// Matches must be at least this long
+	constexpr size_t LZ4MinMatch = 4;
+
+	// The last match must start at least this many bytes before the end of the input
+	constexpr size_t LZ4MFLimit = 12;
+
+	// The last bytes of the input are always stored as literals
+	constexpr size_t LZ4LastLiterals = 5;
+
+	// Largest offset that fits in a sequence
+	constexpr size_t LZ4MaxOffset = 65535;
+
+	// Function declarations
+	inline DWORD LZ4Read32(const BYTE* p);
+	inline DWORD LZ4Hash(DWORD Sequence);
+	inline BYTE* LZ4WriteLength(BYTE* op, size_t Length);
+	inline bool LZ4ReadLength(const BYTE*& ip, const BYTE* iend, size_t& Length);
+}
+
+inline DWORD Utils::LZ4Read32(const BYTE* p)
+{
+	DWORD Value;
+	memcpy(&Value, p, sizeof(Value));
+	return Value;
+}
+
+inline DWORD Utils::LZ4Hash(DWORD Sequence)
+{
+	return (Sequence * 2654435761U) >> (32 - LZ4HashLog);
+}
+
+// Write the extra length bytes that follow a token nibble of 15
+inline BYTE* Utils::LZ4WriteLength(BYTE* op, size_t Length)
+{
+	for (; Length >= 255; Length -= 255)
+	{
+		*op++ = 255;
+	}
+	*op++ = (BYTE)Length;
+	return op;
+}
+
+// Read the extra length bytes that follow a token nibble of 15
+inline bool Utils::LZ4ReadLength(const BYTE*& ip, const BYTE* iend, size_t& Length)
+{
+	BYTE b;
+	do {
+		if (ip >= iend)
+		{
+			return false;
+		}
+		b = *ip++;
+		Length += b;
+	} while (b == 255);
+	return true;
+}
+
+// Compress the buffer, returns the compressed size or zero if the data does not fit in the destination buffer
+size_t Utils::LZ4Compress(const void* Src, size_t SrcSize, void* Dest, size_t DestSize)
+{
+	if (!Src || !Dest || !SrcSize)
+	{
+		return 0;
+	}
+
+	const BYTE* src = (const BYTE*)Src;
+	const BYTE* ip = src;
+	const BYTE* anchor = src;
+	const BYTE* iend = src + SrcSize;
+	BYTE* dst = (BYTE*)Dest;
+	BYTE* op = dst;
+	BYTE* oend = dst + DestSize;
+
+	if (SrcSize > LZ4MFLimit)
+	{
+		const BYTE* mflimit = iend - LZ4MFLimit;
+		const BYTE* matchlimit = iend - LZ4LastLiterals;
+
+		// Positions are stored relative to the start of the buffer
+		DWORD HashTable[1 << LZ4HashLog] = {};
+
+		while (ip < mflimit)
+		{
+			DWORD Sequence = LZ4Read32(ip);
+			DWORD Hash = LZ4Hash(Sequence);
+			const BYTE* ref = src + HashTable[Hash];
+			HashTable[Hash] = (DWORD)(ip - src);
+
+			if (ref >= ip || (size_t)(ip - ref) > LZ4MaxOffset || LZ4Read32(ref) != Sequence)
+			{
+				// Step faster through data that does not compress
+				ip += 1 + ((ip - anchor) >> 6);
+				continue;
+			}
+
+			// Extend match backwards into the pending literals
+			while (ip > anchor && ref > src && ip[-1] == ref[-1])
+			{
+				ip--;
+				ref--;
+			}
+
+			// Extend match forwards
+			const BYTE* mp = ip + LZ4MinMatch;
+			const BYTE* mr = ref + LZ4MinMatch;
+			while (mp < matchlimit && *mp == *mr)
+			{
+				mp++;
+				mr++;
+			}
+
+			size_t LiteralLength = ip - anchor;
+			size_t MatchLength = (mp - ip) - LZ4MinMatch;
+
+			// Token, literals, offset and both length extensions
+			if ((size_t)(oend - op) < 1 + LiteralLength + LiteralLength / 255 + 1 + 2 + MatchLength / 255 + 1)
+			{
+				return 0;
+			}
+
+			BYTE* token = op++;
+			*token = (BYTE)((min(LiteralLength, (size_t)15) << 4) | min(MatchLength, (size_t)15));
+			if (LiteralLength >= 15)
+			{
+				op = LZ4WriteLength(op, LiteralLength - 15);
+			}
+			memcpy(op, anchor, LiteralLength);
+			op += LiteralLength;
+
+			size_t Offset = ip - ref;
+			*op++ = (BYTE)(Offset & 0xFF);
+			*op++ = (BYTE)(Offset >> 8);
+
+			if (MatchLength >= 15)
+			{
+				op = LZ4WriteLength(op, MatchLength - 15);
+			}
+
+			ip = mp;
+			anchor = ip;
+		}
+	}
+
+	// Store the remaining data as the last literals
+	size_t LiteralLength = iend - anchor;
+	if ((size_t)(oend - op) < 1 + LiteralLength + LiteralLength / 255 + 1)
+	{
+		return 0;
+	}
+	*op++ = (BYTE)(min(LiteralLength, (size_t)15) << 4);
+	if (LiteralLength >= 15)
+	{
+		op = LZ4WriteLength(op, LiteralLength - 15);
+	}
+	memcpy(op, anchor, LiteralLength);
+	op += LiteralLength;
+
+	return op - dst;
+}
+
+// Decompress the buffer, fails if the data is malformed or does not decompress to exactly the destination size
+bool Utils::LZ4Decompress(const void* Src, size_t SrcSize, void* Dest, size_t DestSize)
+{
+	if (!Src || !Dest || !SrcSize)
+	{
+		return false;
+	}
+
+	const BYTE* ip = (const BYTE*)Src;
+	const BYTE* iend = ip + SrcSize;
+	BYTE* dst = (BYTE*)Dest;
+	BYTE* op = dst;
+	BYTE* oend = dst + DestSize;
+
+	while (ip < iend)
+	{
+		BYTE token = *ip++;
+
+		// Copy literals
+		size_t LiteralLength = token >> 4;
+		if (LiteralLength == 15 && !LZ4ReadLength(ip, iend, LiteralLength))
+		{
+			return false;
+		}
+		if (LiteralLength > (size_t)(iend - ip) || LiteralLength > (size_t)(oend - op))
+		{
+			return false;
+		}
+		memcpy(op, ip, LiteralLength);
+		ip += LiteralLength;
+		op += LiteralLength;
+
+		// The last sequence only has literals
+		if (ip == iend)
+		{
+			break;
+		}
+
+		// Copy match
+		if (iend - ip < 2)
+		{
+			return false;
+		}
+		size_t Offset = ip[0] | (ip[1] << 8);
+		ip += 2;
+		if (!Offset || Offset > (size_t)(op - dst))
+		{
+			return false;
+		}
+
+		size_t MatchLength = token & 15;
+		if (MatchLength == 15 && !LZ4ReadLength(ip, iend, MatchLength))
+		{
+			return false;
+		}
+		MatchLength += LZ4MinMatch;
+		if (MatchLength > (size_t)(oend - op))
+		{
+			return false;
+		}
+
+		// Matches can overlap the output, copy in chunks of whole periods so each chunk reads finished data
+		for (size_t Copied = 0; Copied < MatchLength;)
+		{
+			size_t Distance = ((Offset + Copied) / Offset) * Offset;
+			size_t Size = min(Distance, MatchLength - Copied);
+			memcpy(op + Copied, op + Copied - Distance, Size);
+			Copied += Size;
+		}
+		op += MatchLength;
+	}
+
+	return op == oend;
+}
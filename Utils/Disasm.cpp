@@ -26,6 +26,7 @@ extern "C"
 #include "Utils.h"
 #include "External\Hooking\Hook.h"
 #include "Logging\Logging.h"
+#include "Logging\AsyncLog.h"
 
 typedef LPTOP_LEVEL_EXCEPTION_FILTER(WINAPI* PFN_SetUnhandledExceptionFilter)(LPTOP_LEVEL_EXCEPTION_FILTER);
 
@@ -46,6 +47,7 @@ LONG WINAPI Utils::myUnhandledExceptionFilter(LPEXCEPTION_POINTERS ExceptionInfo
 		" code=" << ExceptionInfo->ExceptionRecord->ExceptionCode <<
 		" flags=" << ExceptionInfo->ExceptionRecord->ExceptionFlags <<
 		" addr=" << ExceptionInfo->ExceptionRecord->ExceptionAddress << std::dec << std::noshowbase;
+	Logging::FlushAsyncLog();
 	DWORD oldprot;
 	PVOID target = ExceptionInfo->ExceptionRecord->ExceptionAddress;
 	switch (ExceptionInfo->ExceptionRecord->ExceptionCode)
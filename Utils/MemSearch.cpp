@@ -0,0 +1,153 @@
+/**
+* Copyright (C) 2024 Elisha Riedlinger
+*
+* This software is  provided 'as-is', without any express  or implied  warranty. In no event will the
+* authors be held liable for any damages arising from the use of this software.
+* Permission  is granted  to anyone  to use  this software  for  any  purpose,  including  commercial
+* applications, and to alter it and redistribute it freely, subject to the following restrictions:
+*
+*   1. The origin of this software must not be misrepresented; you must not claim that you  wrote the
+*      original  software. If you use this  software  in a product, an  acknowledgment in the product
+*      documentation would be appreciated but is not required.
+*   2. Altered source versions must  be plainly  marked as such, and  must not be  misrepresented  as
+*      being the original software.
+*   3. This notice may not be removed or altered from any source distribution.
+*
+* SIMD substring search based on the "generic SIMD" algorithm by Wojciech Mula
+* http://0x80.pl/articles/simd-strfind.html
+*/
+
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#include <intrin.h>
+#include <emmintrin.h>
+#include "Utils.h"
+
+namespace Utils
+{
+	struct PATTERNSTATE
+	{
+		__m128i First;
+		__m128i Last;
+		const BYTE* Bytes = nullptr;
+		size_t Size = 0;
+	};
+
+	// Function declarations
+	const BYTE* HorspoolSearch(const BYTE* l, size_t l_len, const BYTE* s, size_t s_len);
+	const BYTE* SSE2Search(const BYTE* l, size_t l_len, const BYTE* s, size_t s_len);
+	const BYTE* ScalarSearch(const BYTE* cur, const BYTE* end, const BYTE* s, size_t s_len);
+	DWORD MatchBlock(const PATTERNSTATE& Pattern, const BYTE* cur);
+}
+
+// Boyer-Moore-Horspool search, used when SSE2 is not available
+const BYTE* Utils::HorspoolSearch(const BYTE* l, size_t l_len, const BYTE* s, size_t s_len)
+{
+	size_t skip[256];
+	for (size_t x = 0; x < 256; x++)
+	{
+		skip[x] = s_len;
+	}
+	for (size_t x = 0; x < s_len - 1; x++)
+	{
+		skip[s[x]] = s_len - 1 - x;
+	}
+
+	const BYTE lastByte = s[s_len - 1];
+	const BYTE* last = l + l_len - s_len;
+	for (const BYTE* cur = l; cur <= last; cur += skip[cur[s_len - 1]])
+	{
+		if (cur[s_len - 1] == lastByte && !memcmp(cur, s, s_len - 1))
+		{
+			return cur;
+		}
+	}
+	return nullptr;
+}
+
+// Checks each position from cur up to end, used for the tail of the buffer
+const BYTE* Utils::ScalarSearch(const BYTE* cur, const BYTE* end, const BYTE* s, size_t s_len)
+{
+	for (; cur < end; cur++)
+	{
+		if (cur[0] == s[0] && !memcmp(cur, s, s_len))
+		{
+			return cur;
+		}
+	}
+	return nullptr;
+}
+
+// Returns a bit mask of the positions in the 16 byte block starting at cur that match the pattern
+inline DWORD Utils::MatchBlock(const PATTERNSTATE& Pattern, const BYTE* cur)
+{
+	// Filter on first and last byte, then compare the bytes in between for each candidate
+	__m128i blockFirst = _mm_loadu_si128((const __m128i*)cur);
+	__m128i blockLast = _mm_loadu_si128((const __m128i*)(cur + Pattern.Size - 1));
+	DWORD mask = (DWORD)_mm_movemask_epi8(_mm_and_si128(_mm_cmpeq_epi8(Pattern.First, blockFirst), _mm_cmpeq_epi8(Pattern.Last, blockLast)));
+
+	DWORD result = 0;
+	while (mask)
+	{
+		unsigned long bit;
+		_BitScanForward(&bit, mask);
+		if (Pattern.Size <= 2 || !memcmp(cur + bit + 1, Pattern.Bytes + 1, Pattern.Size - 2))
+		{
+			result |= (1UL << bit);
+		}
+		mask &= mask - 1;
+	}
+	return result;
+}
+
+// SSE2 search for patterns of two or more bytes
+const BYTE* Utils::SSE2Search(const BYTE* l, size_t l_len, const BYTE* s, size_t s_len)
+{
+	PATTERNSTATE Pattern;
+	Pattern.First = _mm_set1_epi8((char)s[0]);
+	Pattern.Last = _mm_set1_epi8((char)s[s_len - 1]);
+	Pattern.Bytes = s;
+	Pattern.Size = s_len;
+
+	const BYTE* cur = l;
+	const BYTE* end = l + l_len - s_len + 1;
+	for (; cur + 16 <= end; cur += 16)
+	{
+		DWORD mask = MatchBlock(Pattern, cur);
+		if (mask)
+		{
+			unsigned long bit;
+			_BitScanForward(&bit, mask);
+			return cur + bit;
+		}
+	}
+	return ScalarSearch(cur, end, s, s_len);
+}
+
+// Searches the memory
+void *Utils::memmem(const void *l, size_t l_len, const void *s, size_t s_len)
+{
+	/* we need something to compare */
+	if (!l_len || !s_len)
+	{
+		return nullptr;
+	}
+
+	/* "s" must be smaller or equal to "l" */
+	if (l_len < s_len)
+	{
+		return nullptr;
+	}
+
+	/* special case where s_len == 1 */
+	if (s_len == 1)
+	{
+		return (void*)memchr(l, (int)*(const BYTE*)s, l_len);
+	}
+
+	if (IsSSE2Supported())
+	{
+		return (void*)SSE2Search((const BYTE*)l, l_len, (const BYTE*)s, s_len);
+	}
+	return (void*)HorspoolSearch((const BYTE*)l, l_len, (const BYTE*)s, s_len);
+}
@@ -124,7 +124,6 @@ namespace Utils
 	DWORD_PTR GetProcessMask();
 	void InitializeASI(HMODULE hModule);
 	void FindFiles(WIN32_FIND_DATA*);
-	void *memmem(const void *l, size_t l_len, const void *s, size_t s_len);
 	LRESULT CALLBACK WndProcFilter(HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam);
 }
 
@@ -730,43 +729,38 @@ HMEMORYMODULE Utils::LoadResourceToMemory(DWORD ResID)
 	return nullptr;
 }
 
-// Searches the memory
-void *Utils::memmem(const void *l, size_t l_len, const void *s, size_t s_len)
+bool Utils::IsSSE2Supported()
 {
-	char *cur, *last;
-	const char *cl = (const char *)l;
-	const char *cs = (const char *)s;
-
-	/* we need something to compare */
-	if (!l_len || !s_len)
-	{
-		return nullptr;
-	}
-
-	/* "s" must be smaller or equal to "l" */
-	if (l_len < s_len)
-	{
-		return nullptr;
-	}
-
-	/* special case where s_len == 1 */
-	if (s_len == 1)
-	{
-		return (void*)memchr(l, (int)*cs, l_len);
-	}
-
-	/* the last position where it's possible to find "s" in "l" */
-	last = (char *)cl + l_len - s_len;
+	static bool supports_sse2 = []() {
+		int cpu_info[4] = { 0 };
+		__cpuid(cpu_info, 1); // Query CPU features
+		return (cpu_info[3] & (1 << 26)) != 0; // Check for SSE2 support
+		}();
+	return supports_sse2;
+}
 
-	for (cur = (char *)cl; cur <= last; cur++)
-	{
-		if (cur[0] == cs[0] && !memcmp(cur, cs, s_len))
+bool Utils::IsAVX2Supported()
+{
+	static bool supports_avx2 = []() {
+		int cpu_info[4] = { 0 };
+		__cpuid(cpu_info, 0);
+		if (cpu_info[0] < 7)
 		{
-			return cur;
+			return false;
 		}
-	}
-
-	return nullptr;
+		__cpuid(cpu_info, 1); // Query CPU features
+		if ((cpu_info[2] & (1 << 27)) == 0 || (cpu_info[2] & (1 << 28)) == 0) // Check for OSXSAVE and AVX support
+		{
+			return false;
+		}
+		if ((_xgetbv(0) & 0x6) != 0x6) // Check that the OS saves the YMM registers
+		{
+			return false;
+		}
+		__cpuidex(cpu_info, 7, 0); // Query extended features
+		return (cpu_info[1] & (1 << 5)) != 0; // Check for AVX2 support
+		}();
+	return supports_avx2;
 }
 
 // Reverse bit order
@@ -803,14 +797,8 @@ void Utils::DDrawResolutionHack(HMODULE hD3DIm)
 
 void Utils::BusyWaitYield(DWORD RemainingMS)
 {
-	static bool supports_pause = []() {
-		int cpu_info[4] = { 0 };
-		__cpuid(cpu_info, 1); // Query CPU features
-		return (cpu_info[3] & (1 << 26)) != 0; // Check for SSE2 support
-		}();
-
 	// If remaining time is very small (e.g., 1 ms or less), use busy-wait with no operations
-	if (RemainingMS < 3 && supports_pause)
+	if (RemainingMS < 3 && IsSSE2Supported())
 	{
 		// Use _mm_pause or __asm { nop } to prevent unnecessary CPU cycles
 #ifdef YieldProcessor
@@ -41,6 +41,11 @@ namespace Utils
 	void UnloadAllDlls();
 	HMEMORYMODULE LoadMemoryToDLL(LPVOID pMemory, DWORD Size);
 	HMEMORYMODULE LoadResourceToMemory(DWORD ResID);
+	void *memmem(const void *l, size_t l_len, const void *s, size_t s_len);
+	size_t LZ4Compress(const void* Src, size_t SrcSize, void* Dest, size_t DestSize);
+	bool LZ4Decompress(const void* Src, size_t SrcSize, void* Dest, size_t DestSize);
+	bool IsSSE2Supported();
+	bool IsAVX2Supported();
 	DWORD ReverseBits(DWORD v);
 	void DDrawResolutionHack(HMODULE hD3DIm);
 	void BusyWaitYield(DWORD RemainingMS);
@@ -14,12 +14,20 @@
 *   3. This notice may not be removed or altered from any source distribution.
 */
 
+#include <algorithm>
 #include "Settings\Settings.h"
 #include "Utils.h"
 #include "Logging\Logging.h"
 
 namespace WriteMemory
 {
+	struct PAGERANGE
+	{
+		BYTE* Address = nullptr;			// Page aligned start address
+		SIZE_T Size = 0;					// Size in bytes, multiple of the page size
+		DWORD OldProtect = 0;				// Protection to restore after patching
+	};
+
 	// Declare variables
 	bool m_StopThreadFlag = false;
 	bool m_ThreadRunningFlag = false;
@@ -27,6 +35,9 @@ namespace WriteMemory
 	DWORD m_dwThreadID = 0;
 
 	// Function declarations
+	void PlanPageRanges(const std::vector<MEMORYINFO>& MemoryInfo, SIZE_T PageSize, std::vector<PAGERANGE>& PageRanges);
+	bool SplitByProtection(std::vector<PAGERANGE>& PageRanges);
+	void RestorePageRanges(std::vector<PAGERANGE>& PageRanges, size_t Count);
 	bool WriteAllByteMemory();
 	DWORD WINAPI StartThreadFunc(LPVOID);
 	bool IsThreadRunning();
@@ -90,43 +101,135 @@ bool WriteMemory::UpdateMemoryAddress(void *dataAddr, void *dataBytes, size_t da
 	return true;
 }
 
-// Writes all bytes in Config to memory
-bool WriteMemory::WriteAllByteMemory()
+// Groups the patches into sorted, non-overlapping page aligned ranges so each page is only unprotected once
+void WriteMemory::PlanPageRanges(const std::vector<MEMORYINFO>& MemoryInfo, SIZE_T PageSize, std::vector<PAGERANGE>& PageRanges)
 {
-	for (UINT x = 0; x < Config.MemoryInfo.size(); x++)
+	PageRanges.clear();
+
+	for (const MEMORYINFO& Entry : MemoryInfo)
 	{
-		std::vector<byte> tmpArray;
-		if (Config.MemoryInfo[x].AddressPointer && Config.MemoryInfo[x].Bytes.size())
+		if (Entry.AddressPointer && Entry.Bytes.size())
 		{
-			// Backup memory
-			if (Config.ResetMemoryAfter > 0)
-			{
-				tmpArray.resize(Config.MemoryInfo[x].Bytes.size(), '\0');
-				if (!UpdateMemoryAddress(&tmpArray[0], Config.MemoryInfo[x].AddressPointer, Config.MemoryInfo[x].Bytes.size()))
-				{
-					Logging::Log() << __FUNCTION__ << " Failed to backup memory...";
-					return false;
-				}
-			}
+			ULONG_PTR Start = (ULONG_PTR)Entry.AddressPointer & ~(ULONG_PTR)(PageSize - 1);
+			ULONG_PTR End = ((ULONG_PTR)Entry.AddressPointer + Entry.Bytes.size() + PageSize - 1) & ~(ULONG_PTR)(PageSize - 1);
+			PAGERANGE Range;
+			Range.Address = (BYTE*)Start;
+			Range.Size = End - Start;
+			PageRanges.push_back(Range);
+		}
+	}
+
+	std::sort(PageRanges.begin(), PageRanges.end(), [](const PAGERANGE& a, const PAGERANGE& b) { return a.Address < b.Address; });
+
+	// Merge overlapping and adjacent ranges
+	size_t Count = 0;
+	for (size_t x = 0; x < PageRanges.size(); x++)
+	{
+		if (Count && PageRanges[Count - 1].Address + PageRanges[Count - 1].Size >= PageRanges[x].Address)
+		{
+			BYTE* End = (std::max)(PageRanges[Count - 1].Address + PageRanges[Count - 1].Size, PageRanges[x].Address + PageRanges[x].Size);
+			PageRanges[Count - 1].Size = End - PageRanges[Count - 1].Address;
+		}
+		else
+		{
+			PageRanges[Count++] = PageRanges[x];
+		}
+	}
+	PageRanges.resize(Count);
+}
+
+// VirtualProtect only returns the protection of the first page, so split ranges where the protection changes
+bool WriteMemory::SplitByProtection(std::vector<PAGERANGE>& PageRanges)
+{
+	std::vector<PAGERANGE> SplitRanges;
+	SplitRanges.reserve(PageRanges.size());
 
-			// Write bytes to memory
-			if (!UpdateMemoryAddress(Config.MemoryInfo[x].AddressPointer, &Config.MemoryInfo[x].Bytes[0], Config.MemoryInfo[x].Bytes.size()))
+	for (const PAGERANGE& Range : PageRanges)
+	{
+		BYTE* Address = Range.Address;
+		BYTE* End = Range.Address + Range.Size;
+		while (Address < End)
+		{
+			MEMORY_BASIC_INFORMATION mbi = {};
+			if (!VirtualQuery(Address, &mbi, sizeof(mbi)))
 			{
-				Logging::Log() << __FUNCTION__ << " Failed to write bytes to memory...";
 				return false;
 			}
+			BYTE* RegionEnd = (BYTE*)mbi.BaseAddress + mbi.RegionSize;
+
+			PAGERANGE NewRange;
+			NewRange.Address = Address;
+			NewRange.Size = (SIZE_T)((std::min)(RegionEnd, End) - Address);
+			NewRange.OldProtect = mbi.Protect;
+			SplitRanges.push_back(NewRange);
+
+			Address += NewRange.Size;
+		}
+	}
 
-			// Prepare new memory to be written
+	PageRanges.swap(SplitRanges);
+	return true;
+}
+
+// Restore protection and flush cache on the first Count ranges
+void WriteMemory::RestorePageRanges(std::vector<PAGERANGE>& PageRanges, size_t Count)
+{
+	HANDLE hProcess = GetCurrentProcess();
+	for (size_t x = 0; x < Count; x++)
+	{
+		DWORD dwPrevProtect;
+		VirtualProtect(PageRanges[x].Address, PageRanges[x].Size, PageRanges[x].OldProtect, &dwPrevProtect);
+		FlushInstructionCache(hProcess, PageRanges[x].Address, PageRanges[x].Size);
+	}
+}
+
+// Writes all bytes in Config to memory
+bool WriteMemory::WriteAllByteMemory()
+{
+	SYSTEM_INFO si = {};
+	GetSystemInfo(&si);
+
+	std::vector<PAGERANGE> PageRanges;
+	PlanPageRanges(Config.MemoryInfo, si.dwPageSize ? si.dwPageSize : 4096, PageRanges);
+	if (!SplitByProtection(PageRanges))
+	{
+		Logging::Log() << __FUNCTION__ << " Error: could not query memory address";
+		return false;
+	}
+
+	// Unprotect each page range once
+	for (size_t x = 0; x < PageRanges.size(); x++)
+	{
+		if (!VirtualProtect(PageRanges[x].Address, PageRanges[x].Size, PAGE_EXECUTE_READWRITE, &PageRanges[x].OldProtect))
+		{
+			Logging::Log() << __FUNCTION__ << " Error: could not write to memory address";
+			RestorePageRanges(PageRanges, x);
+			return false;
+		}
+	}
+
+	// Write bytes in the order they were configured so overlapping patches behave the same
+	for (MEMORYINFO& Entry : Config.MemoryInfo)
+	{
+		if (Entry.AddressPointer && Entry.Bytes.size())
+		{
+			// Backup memory, the backup becomes the bytes written by the reset thread
 			if (Config.ResetMemoryAfter > 0)
 			{
-				if (!UpdateMemoryAddress(&Config.MemoryInfo[x].Bytes[0], &tmpArray[0], Config.MemoryInfo[x].Bytes.size()))
-				{
-					Logging::Log() << __FUNCTION__ << " Failed to prepare new memory bytes...";
-					return false;
-				}
+				std::vector<byte> tmpArray((byte*)Entry.AddressPointer, (byte*)Entry.AddressPointer + Entry.Bytes.size());
+				memcpy(Entry.AddressPointer, &Entry.Bytes[0], Entry.Bytes.size());
+				Entry.Bytes.swap(tmpArray);
+			}
+			else
+			{
+				memcpy(Entry.AddressPointer, &Entry.Bytes[0], Entry.Bytes.size());
 			}
 		}
 	}
+
+	// Restore protection
+	RestorePageRanges(PageRanges, PageRanges.size());
+
 	return true;
 }
 
@@ -0,0 +1,199 @@
+/**
+* Copyright (C) 2024 Elisha Riedlinger
+*
+* This software is  provided 'as-is', without any express  or implied  warranty. In no event will the
+* authors be held liable for any damages arising from the use of this software.
+* Permission  is granted  to anyone  to use  this software  for  any  purpose,  including  commercial
+* applications, and to alter it and redistribute it freely, subject to the following restrictions:
+*
+*   1. The origin of this software must not be misrepresented; you must not claim that you  wrote the
+*      original  software. If you use this  software  in a product, an  acknowledgment in the product
+*      documentation would be appreciated but is not required.
+*   2. Altered source versions must  be plainly  marked as such, and  must not be  misrepresented  as
+*      being the original software.
+*   3. This notice may not be removed or altered from any source distribution.
+*
+* Tables follow the gamma pixel shader: the channel is point sampled from a 256 entry ramp texture and
+* the float result is rounded to the channel size of the render target.
+*/
+
+#include "GammaRamp.h"
+
+// Scales ramp entry to a channel with the given max value, rounded to nearest
+static inline DWORD GetRampValue(WORD RampEntry, DWORD MaxValue)
+{
+	return (RampEntry * MaxValue + 32767) / 65535;
+}
+
+// Ramp texel the shader samples for a channel value, texture coordinate is Value / MaxValue
+static inline DWORD GetRampIndex(DWORD Value, DWORD MaxValue)
+{
+	return min(Value * 256 / MaxValue, (DWORD)255);
+}
+
+void CreateGammaRampLUT(const D3DGAMMARAMP& Ramp, GAMMARAMPLUT& LUT)
+{
+	const WORD* Channels[3] = { Ramp.red, Ramp.green, Ramp.blue };
+	const DWORD Shift32[3] = { 16, 8, 0 };
+	const DWORD Shift565[3] = { 11, 5, 0 };
+	const DWORD Bits565[3] = { 5, 6, 5 };
+	const DWORD Shift555[3] = { 10, 5, 0 };
+
+	LUT.IsIdentity = true;
+
+	for (UINT c = 0; c < 3; c++)
+	{
+		for (DWORD x = 0; x < 256; x++)
+		{
+			DWORD Value = GetRampValue(Channels[c][x], 255);
+			LUT.Color32[c][x] = Value << Shift32[c];
+			LUT.IsIdentity = LUT.IsIdentity && Value == x;
+		}
+
+		DWORD Max565 = (1 << Bits565[c]) - 1;
+		for (DWORD x = 0; x <= Max565; x++)
+		{
+			DWORD Value = GetRampValue(Channels[c][GetRampIndex(x, Max565)], Max565);
+			LUT.Color565[c][x] = (WORD)(Value << Shift565[c]);
+			LUT.IsIdentity = LUT.IsIdentity && Value == x;
+		}
+
+		for (DWORD x = 0; x <= 31; x++)
+		{
+			DWORD Value = GetRampValue(Channels[c][GetRampIndex(x, 31)], 31);
+			LUT.Color555[c][x] = (WORD)(Value << Shift555[c]);
+			LUT.IsIdentity = LUT.IsIdentity && Value == x;
+		}
+	}
+}
+
+bool IsGammaRampFormatSupported(D3DFORMAT Format)
+{
+	switch ((DWORD)Format)
+	{
+	case D3DFMT_X8R8G8B8:
+	case D3DFMT_A8R8G8B8:
+	case D3DFMT_R5G6B5:
+	case D3DFMT_X1R5G5B5:
+	case D3DFMT_A1R5G5B5:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Apply gamma ramp in place, alpha and unused bits are kept
+void ApplyGammaRampLUT(const GAMMARAMPLUT& LUT, D3DFORMAT Format, void* pBits, LONG Pitch, DWORD Width, DWORD Height)
+{
+	if (LUT.IsIdentity || !pBits)
+	{
+		return;
+	}
+
+	BYTE* pRow = (BYTE*)pBits;
+
+	switch ((DWORD)Format)
+	{
+	case D3DFMT_X8R8G8B8:
+	case D3DFMT_A8R8G8B8:
+		for (DWORD y = 0; y < Height; y++, pRow += Pitch)
+		{
+			DWORD* p = (DWORD*)pRow;
+			for (DWORD x = 0; x < Width; x++)
+			{
+				DWORD Color = p[x];
+				p[x] = (Color & 0xFF000000) |
+					LUT.Color32[0][(Color >> 16) & 0xFF] |
+					LUT.Color32[1][(Color >> 8) & 0xFF] |
+					LUT.Color32[2][Color & 0xFF];
+			}
+		}
+		break;
+
+	case D3DFMT_R5G6B5:
+		for (DWORD y = 0; y < Height; y++, pRow += Pitch)
+		{
+			WORD* p = (WORD*)pRow;
+			for (DWORD x = 0; x < Width; x++)
+			{
+				WORD Color = p[x];
+				p[x] = LUT.Color565[0][Color >> 11] |
+					LUT.Color565[1][(Color >> 5) & 0x3F] |
+					LUT.Color565[2][Color & 0x1F];
+			}
+		}
+		break;
+
+	case D3DFMT_X1R5G5B5:
+	case D3DFMT_A1R5G5B5:
+		for (DWORD y = 0; y < Height; y++, pRow += Pitch)
+		{
+			WORD* p = (WORD*)pRow;
+			for (DWORD x = 0; x < Width; x++)
+			{
+				WORD Color = p[x];
+				p[x] = (Color & 0x8000) |
+					LUT.Color555[0][(Color >> 10) & 0x1F] |
+					LUT.Color555[1][(Color >> 5) & 0x1F] |
+					LUT.Color555[2][Color & 0x1F];
+			}
+		}
+		break;
+	}
+}
+
+// Apply gamma ramp to a render target through a system memory copy, used when the gamma pixel shader is not available
+HRESULT ApplyGammaRampToRenderTarget(LPDIRECT3DDEVICE9 pDevice, LPDIRECT3DSURFACE9 pRenderTarget, LPDIRECT3DSURFACE9& pSysMemSurface, const GAMMARAMPLUT& LUT)
+{
+	if (!pDevice || !pRenderTarget)
+	{
+		return D3DERR_INVALIDCALL;
+	}
+
+	if (LUT.IsIdentity)
+	{
+		return D3D_OK;
+	}
+
+	D3DSURFACE_DESC Desc = {};
+	if (FAILED(pRenderTarget->GetDesc(&Desc)) || !IsGammaRampFormatSupported(Desc.Format))
+	{
+		return D3DERR_INVALIDCALL;
+	}
+
+	// Recreate system memory surface if the render target changed
+	if (pSysMemSurface)
+	{
+		D3DSURFACE_DESC SysMemDesc = {};
+		if (FAILED(pSysMemSurface->GetDesc(&SysMemDesc)) || SysMemDesc.Width != Desc.Width || SysMemDesc.Height != Desc.Height || SysMemDesc.Format != Desc.Format)
+		{
+			pSysMemSurface->Release();
+			pSysMemSurface = nullptr;
+		}
+	}
+	if (!pSysMemSurface)
+	{
+		HRESULT hr = pDevice->CreateOffscreenPlainSurface(Desc.Width, Desc.Height, Desc.Format, D3DPOOL_SYSTEMMEM, &pSysMemSurface, nullptr);
+		if (FAILED(hr))
+		{
+			return hr;
+		}
+	}
+
+	HRESULT hr = pDevice->GetRenderTargetData(pRenderTarget, pSysMemSurface);
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
+	D3DLOCKED_RECT LockedRect = {};
+	hr = pSysMemSurface->LockRect(&LockedRect, nullptr, 0);
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+	ApplyGammaRampLUT(LUT, Desc.Format, LockedRect.pBits, LockedRect.Pitch, Desc.Width, Desc.Height);
+	pSysMemSurface->UnlockRect();
+
+	return pDevice->UpdateSurface(pSysMemSurface, nullptr, pRenderTarget, nullptr);
+}
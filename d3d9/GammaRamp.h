@@ -0,0 +1,17 @@
+#pragma once
+
+#include <d3d9.h>
+
+// Gamma ramp lookup tables used to apply the ramp on the CPU
+struct GAMMARAMPLUT
+{
+	bool IsIdentity = true;				// Ramp does not change any color
+	DWORD Color32[3][256] = {};			// Red, green and blue for 8-bit channels, shifted into place
+	WORD Color565[3][64] = {};			// Red, green and blue for R5G6B5, shifted into place
+	WORD Color555[3][32] = {};			// Red, green and blue for X1R5G5B5, shifted into place
+};
+
+void CreateGammaRampLUT(const D3DGAMMARAMP& Ramp, GAMMARAMPLUT& LUT);
+bool IsGammaRampFormatSupported(D3DFORMAT Format);
+void ApplyGammaRampLUT(const GAMMARAMPLUT& LUT, D3DFORMAT Format, void* pBits, LONG Pitch, DWORD Width, DWORD Height);
+HRESULT ApplyGammaRampToRenderTarget(LPDIRECT3DDEVICE9 pDevice, LPDIRECT3DSURFACE9 pRenderTarget, LPDIRECT3DSURFACE9& pSysMemSurface, const GAMMARAMPLUT& LUT);
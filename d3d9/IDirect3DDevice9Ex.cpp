@@ -756,14 +756,6 @@ void m_IDirect3DDevice9Ex::ApplyBrightnessLevel()
 		SetBrightnessLevel(SHARED.RampData);
 	}
 
-	// Set shader
-	IDirect3DPixelShader9* pShader = GetGammaPixelShader();
-	if (!pShader)
-	{
-		LOG_LIMIT(100, __FUNCTION__ << " Error: Failed to retrieve gamma pixel shader!");
-		return;
-	}
-
 	// Get current backbuffer
 	IDirect3DSurface9* pBackBuffer = nullptr;
 	if (FAILED(ProxyInterface->GetBackBuffer(0, 0, D3DBACKBUFFER_TYPE_MONO, &pBackBuffer)))
@@ -772,6 +764,19 @@ void m_IDirect3DDevice9Ex::ApplyBrightnessLevel()
 		return;
 	}
 
+	// Set shader
+	IDirect3DPixelShader9* pShader = GetGammaPixelShader();
+	if (!pShader)
+	{
+		// Apply gamma on the CPU
+		if (FAILED(ApplyGammaRampToRenderTarget(ProxyInterface, pBackBuffer, SHARED.GammaCopySurface, SHARED.GammaLUT)))
+		{
+			LOG_LIMIT(100, __FUNCTION__ << " Error: Failed to retrieve gamma pixel shader and failed to apply gamma on the CPU!");
+		}
+		pBackBuffer->Release();
+		return;
+	}
+
 	// Create intermediate texture for shader input
 	D3DSURFACE_DESC desc;
 	pBackBuffer->GetDesc(&desc);
@@ -913,6 +918,16 @@ void m_IDirect3DDevice9Ex::ReleaseGammaResources() const
 		SHARED.ScreenCopyTexture = nullptr;
 	}
 
+	if (SHARED.GammaCopySurface)
+	{
+		ULONG ref = SHARED.GammaCopySurface->Release();
+		if (ref)
+		{
+			Logging::Log() << __FUNCTION__ << " Error: there is still a reference to 'GammaCopySurface' " << ref;
+		}
+		SHARED.GammaCopySurface = nullptr;
+	}
+
 	if (SHARED.gammaPixelShader)
 	{
 		ULONG ref = SHARED.gammaPixelShader->Release();
@@ -948,8 +963,13 @@ void m_IDirect3DDevice9Ex::SetGammaRamp(THIS_ UINT iSwapChain, DWORD Flags, CONS
 
 		if (memcmp(&SHARED.DefaultRampData, &SHARED.RampData, sizeof(D3DGAMMARAMP)) != S_OK)
 		{
-			SHARED.IsGammaSet = true;
-			SetBrightnessLevel(SHARED.RampData);
+			// Skip gamma if the ramp does not change any colors
+			CreateGammaRampLUT(SHARED.RampData, SHARED.GammaLUT);
+			if (!SHARED.GammaLUT.IsIdentity)
+			{
+				SHARED.IsGammaSet = true;
+				SetBrightnessLevel(SHARED.RampData);
+			}
 		}
 
 		return;
@@ -51,6 +51,8 @@ struct DEVICEDETAILS
 	LPDIRECT3DTEXTURE9 GammaLUTTexture = nullptr;
 	LPDIRECT3DTEXTURE9 ScreenCopyTexture = nullptr;
 	LPDIRECT3DPIXELSHADER9 gammaPixelShader = nullptr;
+	GAMMARAMPLUT GammaLUT;
+	LPDIRECT3DSURFACE9 GammaCopySurface = nullptr;
 };
 
 extern std::unordered_map<UINT, DEVICEDETAILS> DeviceDetailsMap;
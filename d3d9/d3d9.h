@@ -1,6 +1,7 @@
 #pragma once
 
 #include "d3d9External.h"
+#include "GammaRamp.h"
 #include <deque>
 #include "GDI\GDI.h"
 
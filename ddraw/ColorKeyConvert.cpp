@@ -0,0 +1,233 @@
+/**
+* Copyright (C) 2024 Elisha Riedlinger
+*
+* This software is  provided 'as-is', without any express  or implied  warranty. In no event will the
+* authors be held liable for any damages arising from the use of this software.
+* Permission  is granted  to anyone  to use  this software  for  any  purpose,  including  commercial
+* applications, and to alter it and redistribute it freely, subject to the following restrictions:
+*
+*   1. The origin of this software must not be misrepresented; you must not claim that you  wrote the
+*      original  software. If you use this  software  in a product, an  acknowledgment in the product
+*      documentation would be appreciated but is not required.
+*   2. Altered source versions must  be plainly  marked as such, and  must not be  misrepresented  as
+*      being the original software.
+*   3. This notice may not be removed or altered from any source distribution.
+*
+* Converts surface data to A8R8G8B8, texels that match the color key become transparent black. RGB
+* texels match on their color bits, palette texels match on their index like DirectDraw does. Channels
+* are scaled to 8 bits and rounded to nearest.
+*/
+
+#include <emmintrin.h>
+#include "ColorKeyConvert.h"
+#include "Utils\Utils.h"
+
+// Widens a channel to 8 bits, (((Value >> Shift) & Mask) * Mul + Add) >> PostShift, a zero mask means the channel is always 0xFF
+struct COLORKEYCHANNEL
+{
+	DWORD Shift;
+	DWORD Mask;
+	DWORD Mul;
+	DWORD Add;
+	DWORD PostShift;
+};
+
+// Channel layout of a 16-bit format, channels are in blue, green, red, alpha order
+struct COLORKEYFORMAT16
+{
+	DWORD KeyMask;
+	COLORKEYCHANNEL Channel[4];
+};
+
+static const COLORKEYFORMAT16 Format565 = { 0xFFFF, { { 0, 0x1F, 527, 23, 6 }, { 5, 0x3F, 259, 33, 6 }, { 11, 0x1F, 527, 23, 6 }, { 0, 0, 0, 0, 0 } } };
+static const COLORKEYFORMAT16 FormatX1555 = { 0x7FFF, { { 0, 0x1F, 527, 23, 6 }, { 5, 0x1F, 527, 23, 6 }, { 10, 0x1F, 527, 23, 6 }, { 0, 0, 0, 0, 0 } } };
+static const COLORKEYFORMAT16 FormatA1555 = { 0x7FFF, { { 0, 0x1F, 527, 23, 6 }, { 5, 0x1F, 527, 23, 6 }, { 10, 0x1F, 527, 23, 6 }, { 15, 0x01, 255, 0, 0 } } };
+static const COLORKEYFORMAT16 FormatX4444 = { 0x0FFF, { { 0, 0x0F, 17, 0, 0 }, { 4, 0x0F, 17, 0, 0 }, { 8, 0x0F, 17, 0, 0 }, { 0, 0, 0, 0, 0 } } };
+static const COLORKEYFORMAT16 FormatA4444 = { 0x0FFF, { { 0, 0x0F, 17, 0, 0 }, { 4, 0x0F, 17, 0, 0 }, { 8, 0x0F, 17, 0, 0 }, { 12, 0x0F, 17, 0, 0 } } };
+
+static inline const COLORKEYFORMAT16* GetFormat16(D3DFORMAT Format)
+{
+	switch ((DWORD)Format)
+	{
+	case D3DFMT_R5G6B5:
+		return &Format565;
+	case D3DFMT_X1R5G5B5:
+		return &FormatX1555;
+	case D3DFMT_A1R5G5B5:
+		return &FormatA1555;
+	case D3DFMT_X4R4G4B4:
+		return &FormatX4444;
+	case D3DFMT_A4R4G4B4:
+		return &FormatA4444;
+	default:
+		return nullptr;
+	}
+}
+
+static inline DWORD ExpandChannel(const COLORKEYCHANNEL& Channel, DWORD Value)
+{
+	return Channel.Mask ? (((Value >> Channel.Shift) & Channel.Mask) * Channel.Mul + Channel.Add) >> Channel.PostShift : 0xFF;
+}
+
+static inline void ConvertRowScalar16(const COLORKEYFORMAT16& Layout, const WORD* pSrc, DWORD* pDest, DWORD Start, DWORD Width, DWORD KeyMask, DWORD ColorKey)
+{
+	for (DWORD x = Start; x < Width; x++)
+	{
+		DWORD Value = pSrc[x];
+		pDest[x] = ((Value & KeyMask) == ColorKey) ? 0x00000000 :
+			(ExpandChannel(Layout.Channel[3], Value) << 24) |
+			(ExpandChannel(Layout.Channel[2], Value) << 16) |
+			(ExpandChannel(Layout.Channel[1], Value) << 8) |
+			ExpandChannel(Layout.Channel[0], Value);
+	}
+}
+
+static inline void ConvertRowScalar32(const DWORD* pSrc, DWORD* pDest, DWORD Start, DWORD Width, DWORD AlphaMask, DWORD KeyMask, DWORD ColorKey)
+{
+	for (DWORD x = Start; x < Width; x++)
+	{
+		DWORD Value = pSrc[x];
+		pDest[x] = ((Value & KeyMask) == ColorKey) ? 0x00000000 : (Value | AlphaMask);
+	}
+}
+
+// Converts eight texels per step, returns the number of texels done
+static inline DWORD ConvertRowSSE16(const COLORKEYFORMAT16& Layout, const WORD* pSrc, DWORD* pDest, DWORD Width, DWORD KeyMask, DWORD ColorKey)
+{
+	__m128i Shift[4], Mask[4], Mul[4], Add[4], PostShift[4];
+	for (DWORD c = 0; c < 4; c++)
+	{
+		Shift[c] = _mm_cvtsi32_si128(Layout.Channel[c].Shift);
+		Mask[c] = _mm_set1_epi16((short)Layout.Channel[c].Mask);
+		Mul[c] = _mm_set1_epi16((short)Layout.Channel[c].Mul);
+		Add[c] = _mm_set1_epi16((short)Layout.Channel[c].Add);
+		PostShift[c] = _mm_cvtsi32_si128(Layout.Channel[c].PostShift);
+	}
+	const __m128i KeyMaskVec = _mm_set1_epi16((short)KeyMask);
+	const __m128i ColorKeyVec = _mm_set1_epi16((short)ColorKey);
+	const __m128i Opaque = _mm_set1_epi16(0xFF);
+
+	DWORD x = 0;
+	for (; x + 8 <= Width; x += 8)
+	{
+		__m128i Value = _mm_loadu_si128((const __m128i*)(pSrc + x));
+		__m128i Key = _mm_cmpeq_epi16(_mm_and_si128(Value, KeyMaskVec), ColorKeyVec);
+
+		// Widen each channel to 8 bits in 16-bit lanes, products fit in 16 bits for all supported layouts
+		__m128i Channel[4];
+		for (DWORD c = 0; c < 4; c++)
+		{
+			Channel[c] = Layout.Channel[c].Mask ?
+				_mm_srl_epi16(_mm_add_epi16(_mm_mullo_epi16(_mm_and_si128(_mm_srl_epi16(Value, Shift[c]), Mask[c]), Mul[c]), Add[c]), PostShift[c]) :
+				Opaque;
+		}
+
+		// Interleave into B, G, R, A bytes
+		__m128i BlueGreen = _mm_or_si128(Channel[0], _mm_slli_epi16(Channel[1], 8));
+		__m128i RedAlpha = _mm_or_si128(Channel[2], _mm_slli_epi16(Channel[3], 8));
+
+		__m128i Lo = _mm_andnot_si128(_mm_unpacklo_epi16(Key, Key), _mm_unpacklo_epi16(BlueGreen, RedAlpha));
+		__m128i Hi = _mm_andnot_si128(_mm_unpackhi_epi16(Key, Key), _mm_unpackhi_epi16(BlueGreen, RedAlpha));
+
+		_mm_storeu_si128((__m128i*)(pDest + x), Lo);
+		_mm_storeu_si128((__m128i*)(pDest + x + 4), Hi);
+	}
+	return x;
+}
+
+// Converts four texels per step, returns the number of texels done
+static inline DWORD ConvertRowSSE32(const DWORD* pSrc, DWORD* pDest, DWORD Width, DWORD AlphaMask, DWORD KeyMask, DWORD ColorKey)
+{
+	const __m128i AlphaMaskVec = _mm_set1_epi32(AlphaMask);
+	const __m128i KeyMaskVec = _mm_set1_epi32(KeyMask);
+	const __m128i ColorKeyVec = _mm_set1_epi32(ColorKey);
+
+	DWORD x = 0;
+	for (; x + 4 <= Width; x += 4)
+	{
+		__m128i Value = _mm_loadu_si128((const __m128i*)(pSrc + x));
+		__m128i Key = _mm_cmpeq_epi32(_mm_and_si128(Value, KeyMaskVec), ColorKeyVec);
+		_mm_storeu_si128((__m128i*)(pDest + x), _mm_andnot_si128(Key, _mm_or_si128(Value, AlphaMaskVec)));
+	}
+	return x;
+}
+
+bool IsColorKeyConvertFormatSupported(D3DFORMAT Format)
+{
+	switch ((DWORD)Format)
+	{
+	case D3DFMT_P8:
+	case D3DFMT_X8R8G8B8:
+	case D3DFMT_A8R8G8B8:
+		return true;
+	default:
+		return GetFormat16(Format) != nullptr;
+	}
+}
+
+// Converts the source texels to A8R8G8B8, palette surfaces need the palette and use the index as the color key
+void ConvertColorKeyToAlpha(D3DFORMAT SrcFormat, const void* pSrcBits, LONG SrcPitch, const PALETTEENTRY* pPalette, void* pDestBits, LONG DestPitch, DWORD Width, DWORD Height, bool IsColorKeyed, DWORD ColorKey)
+{
+	if (!pSrcBits || !pDestBits || !IsColorKeyConvertFormatSupported(SrcFormat) || (SrcFormat == D3DFMT_P8 && !pPalette))
+	{
+		return;
+	}
+
+	// Palette surfaces are converted with a lookup table that has the color key entry cleared
+	if (SrcFormat == D3DFMT_P8)
+	{
+		DWORD Table[256];
+		for (DWORD x = 0; x < 256; x++)
+		{
+			Table[x] = D3DCOLOR_ARGB(pPalette[x].peFlags, pPalette[x].peRed, pPalette[x].peGreen, pPalette[x].peBlue);
+		}
+		if (IsColorKeyed)
+		{
+			Table[ColorKey & 0xFF] = 0x00000000;
+		}
+
+		for (DWORD y = 0; y < Height; y++)
+		{
+			const BYTE* pSrc = (const BYTE*)pSrcBits + y * SrcPitch;
+			DWORD* pDest = (DWORD*)((BYTE*)pDestBits + y * DestPitch);
+			for (DWORD x = 0; x < Width; x++)
+			{
+				pDest[x] = Table[pSrc[x]];
+			}
+		}
+		return;
+	}
+
+	const COLORKEYFORMAT16* Layout = GetFormat16(SrcFormat);
+	const bool UseSSE2 = Utils::IsSSE2Supported();
+
+	// Only the color bits are compared, without a color key nothing can match
+	DWORD KeyMask = Layout ? Layout->KeyMask : 0x00FFFFFF;
+	if (IsColorKeyed)
+	{
+		ColorKey &= KeyMask;
+	}
+	else
+	{
+		KeyMask = 0;
+		ColorKey = 1;
+	}
+	const DWORD AlphaMask = (SrcFormat == D3DFMT_X8R8G8B8) ? 0xFF000000 : 0x00000000;
+
+	for (DWORD y = 0; y < Height; y++)
+	{
+		const BYTE* pSrc = (const BYTE*)pSrcBits + y * SrcPitch;
+		DWORD* pDest = (DWORD*)((BYTE*)pDestBits + y * DestPitch);
+
+		if (Layout)
+		{
+			DWORD Done = UseSSE2 ? ConvertRowSSE16(*Layout, (const WORD*)pSrc, pDest, Width, KeyMask, ColorKey) : 0;
+			ConvertRowScalar16(*Layout, (const WORD*)pSrc, pDest, Done, Width, KeyMask, ColorKey);
+		}
+		else
+		{
+			DWORD Done = UseSSE2 ? ConvertRowSSE32((const DWORD*)pSrc, pDest, Width, AlphaMask, KeyMask, ColorKey) : 0;
+			ConvertRowScalar32((const DWORD*)pSrc, pDest, Done, Width, AlphaMask, KeyMask, ColorKey);
+		}
+	}
+}
@@ -0,0 +1,6 @@
+#pragma once
+
+#include <d3d9.h>
+
+bool IsColorKeyConvertFormatSupported(D3DFORMAT Format);
+void ConvertColorKeyToAlpha(D3DFORMAT SrcFormat, const void* pSrcBits, LONG SrcPitch, const PALETTEENTRY* pPalette, void* pDestBits, LONG DestPitch, DWORD Width, DWORD Height, bool IsColorKeyed, DWORD ColorKey);
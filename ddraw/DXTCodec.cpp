@@ -0,0 +1,561 @@
+/**
+* Copyright (C) 2024 Elisha Riedlinger
+*
+* This software is  provided 'as-is', without any express  or implied  warranty. In no event will the
+* authors be held liable for any damages arising from the use of this software.
+* Permission  is granted  to anyone  to use  this software  for  any  purpose,  including  commercial
+* applications, and to alter it and redistribute it freely, subject to the following restrictions:
+*
+*   1. The origin of this software must not be misrepresented; you must not claim that you  wrote the
+*      original  software. If you use this  software  in a product, an  acknowledgment in the product
+*      documentation would be appreciated but is not required.
+*   2. Altered source versions must  be plainly  marked as such, and  must not be  misrepresented  as
+*      being the original software.
+*   3. This notice may not be removed or altered from any source distribution.
+*
+* DXT1 to DXT5 blocks are decoded to and encoded from A8R8G8B8. DXT2 and DXT4 are handled like DXT3 and
+* DXT5, the color data is left premultiplied. The encoder uses the inset bounding box method from
+* "Real-Time DXT Compression" by J.M.P. van Waveren.
+*/
+
+#include <emmintrin.h>
+#include "DXTCodec.h"
+#include "SurfaceCopy.h"
+#include "Utils\Utils.h"
+
+// Images with at least this many texels are split across threads
+constexpr DWORD DXTMinThreadTexels = 256 * 256;
+
+// Number of block rows in each band handed to the worker pool
+constexpr DWORD DXTBandBlockRows = 8;
+
+struct DXTJOB
+{
+	bool IsEncode = false;
+	D3DFORMAT Format = D3DFMT_UNKNOWN;
+	const BYTE* pSrcBits = nullptr;
+	LONG SrcPitch = 0;
+	bool SrcHasAlpha = false;
+	BYTE* pDestBits = nullptr;
+	LONG DestPitch = 0;
+	DWORD Width = 0;
+	DWORD Height = 0;
+	DWORD StartBlockRow = 0;
+	DWORD EndBlockRow = 0;
+};
+
+static inline DWORD GetBlockSize(D3DFORMAT Format)
+{
+	return (Format == D3DFMT_DXT1) ? 8 : 16;
+}
+
+// Widens a R5G6B5 color to opaque A8R8G8B8 by bit replication
+static inline DWORD Expand565(DWORD Color)
+{
+	DWORD r = (Color >> 11) & 0x1F;
+	DWORD g = (Color >> 5) & 0x3F;
+	DWORD b = Color & 0x1F;
+	return 0xFF000000 | (((r << 3) | (r >> 2)) << 16) | (((g << 2) | (g >> 4)) << 8) | ((b << 3) | (b >> 2));
+}
+
+static inline DWORD Pack565(DWORD Color)
+{
+	return ((Color >> 8) & 0xF800) | ((Color >> 5) & 0x07E0) | ((Color >> 3) & 0x001F);
+}
+
+// Weighted average of the color channels of two colors, rounded to nearest, result is opaque
+static inline DWORD BlendColor(DWORD Color0, DWORD Color1, DWORD Weight0, DWORD Weight1)
+{
+	const DWORD Total = Weight0 + Weight1;
+	DWORD Result = 0xFF000000;
+	for (DWORD Shift = 0; Shift < 24; Shift += 8)
+	{
+		DWORD Value = (((Color0 >> Shift) & 0xFF) * Weight0 + ((Color1 >> Shift) & 0xFF) * Weight1 + Total / 2) / Total;
+		Result |= Value << Shift;
+	}
+	return Result;
+}
+
+// Builds the four colors of a color block, DXT1 blocks with Color0 <= Color1 have three colors and transparent black
+static inline void GetColorPalette(DWORD Color0, DWORD Color1, bool IsFourColor, DWORD Palette[4])
+{
+	Palette[0] = Expand565(Color0);
+	Palette[1] = Expand565(Color1);
+	if (IsFourColor || Color0 > Color1)
+	{
+		Palette[2] = BlendColor(Palette[0], Palette[1], 2, 1);
+		Palette[3] = BlendColor(Palette[0], Palette[1], 1, 2);
+	}
+	else
+	{
+		Palette[2] = BlendColor(Palette[0], Palette[1], 1, 1);
+		Palette[3] = 0x00000000;
+	}
+}
+
+// Builds the eight alpha values of a DXT5 alpha block
+static inline void GetAlphaPalette(DWORD Alpha0, DWORD Alpha1, DWORD Palette[8])
+{
+	Palette[0] = Alpha0;
+	Palette[1] = Alpha1;
+	if (Alpha0 > Alpha1)
+	{
+		for (DWORD k = 1; k < 7; k++)
+		{
+			Palette[k + 1] = ((7 - k) * Alpha0 + k * Alpha1 + 3) / 7;
+		}
+	}
+	else
+	{
+		for (DWORD k = 1; k < 5; k++)
+		{
+			Palette[k + 1] = ((5 - k) * Alpha0 + k * Alpha1 + 2) / 5;
+		}
+		Palette[6] = 0;
+		Palette[7] = 255;
+	}
+}
+
+static inline WORD ReadWord(const BYTE* p)
+{
+	return (WORD)(p[0] | (p[1] << 8));
+}
+
+static inline DWORD ReadDword(const BYTE* p)
+{
+	return p[0] | (p[1] << 8) | (p[2] << 16) | ((DWORD)p[3] << 24);
+}
+
+static inline void WriteWord(BYTE* p, DWORD Value)
+{
+	p[0] = (BYTE)Value;
+	p[1] = (BYTE)(Value >> 8);
+}
+
+static inline void WriteDword(BYTE* p, DWORD Value)
+{
+	WriteWord(p, Value);
+	WriteWord(p + 2, Value >> 16);
+}
+
+// Decodes one block into 16 texels in row order
+static inline void DecodeBlock(D3DFORMAT Format, const BYTE* pBlock, DWORD Texels[16])
+{
+	const BYTE* pColor = (Format == D3DFMT_DXT1) ? pBlock : pBlock + 8;
+
+	DWORD Palette[4];
+	GetColorPalette(ReadWord(pColor), ReadWord(pColor + 2), Format != D3DFMT_DXT1, Palette);
+
+	DWORD Indices = ReadDword(pColor + 4);
+	for (DWORD x = 0; x < 16; x++, Indices >>= 2)
+	{
+		Texels[x] = Palette[Indices & 3];
+	}
+
+	if (Format == D3DFMT_DXT2 || Format == D3DFMT_DXT3)
+	{
+		for (DWORD x = 0; x < 16; x++)
+		{
+			DWORD Alpha = (pBlock[x / 2] >> ((x & 1) * 4)) & 0x0F;
+			Texels[x] = (Texels[x] & 0x00FFFFFF) | ((Alpha * 17) << 24);
+		}
+	}
+	else if (Format == D3DFMT_DXT4 || Format == D3DFMT_DXT5)
+	{
+		DWORD AlphaPalette[8];
+		GetAlphaPalette(pBlock[0], pBlock[1], AlphaPalette);
+
+		unsigned long long AlphaIndices = ReadDword(pBlock + 2) | ((unsigned long long)ReadWord(pBlock + 6) << 32);
+		for (DWORD x = 0; x < 16; x++, AlphaIndices >>= 3)
+		{
+			Texels[x] = (Texels[x] & 0x00FFFFFF) | (AlphaPalette[AlphaIndices & 7] << 24);
+		}
+	}
+}
+
+// Reads a 4x4 block of texels, texels past the edge of the image repeat the last row or column
+static inline void LoadBlock(const DXTJOB& Job, DWORD BlockX, DWORD BlockY, DWORD Texels[16])
+{
+	const DWORD AlphaMask = Job.SrcHasAlpha ? 0x00000000 : 0xFF000000;
+	for (DWORD y = 0; y < 4; y++)
+	{
+		const DWORD* pRow = (const DWORD*)(Job.pSrcBits + min(BlockY * 4 + y, Job.Height - 1) * Job.SrcPitch);
+		for (DWORD x = 0; x < 4; x++)
+		{
+			Texels[y * 4 + x] = pRow[min(BlockX * 4 + x, Job.Width - 1)] | AlphaMask;
+		}
+	}
+}
+
+// Per byte minimum and maximum of the texels
+static inline void GetMinMaxColors(const DWORD Texels[16], DWORD& MinColor, DWORD& MaxColor)
+{
+	if (Utils::IsSSE2Supported())
+	{
+		__m128i t0 = _mm_loadu_si128((const __m128i*)Texels);
+		__m128i t1 = _mm_loadu_si128((const __m128i*)(Texels + 4));
+		__m128i t2 = _mm_loadu_si128((const __m128i*)(Texels + 8));
+		__m128i t3 = _mm_loadu_si128((const __m128i*)(Texels + 12));
+
+		__m128i Min = _mm_min_epu8(_mm_min_epu8(t0, t1), _mm_min_epu8(t2, t3));
+		__m128i Max = _mm_max_epu8(_mm_max_epu8(t0, t1), _mm_max_epu8(t2, t3));
+		Min = _mm_min_epu8(Min, _mm_shuffle_epi32(Min, _MM_SHUFFLE(1, 0, 3, 2)));
+		Max = _mm_max_epu8(Max, _mm_shuffle_epi32(Max, _MM_SHUFFLE(1, 0, 3, 2)));
+		Min = _mm_min_epu8(Min, _mm_shuffle_epi32(Min, _MM_SHUFFLE(2, 3, 0, 1)));
+		Max = _mm_max_epu8(Max, _mm_shuffle_epi32(Max, _MM_SHUFFLE(2, 3, 0, 1)));
+
+		MinColor = (DWORD)_mm_cvtsi128_si32(Min);
+		MaxColor = (DWORD)_mm_cvtsi128_si32(Max);
+		return;
+	}
+
+	MinColor = 0;
+	MaxColor = 0;
+	for (DWORD Shift = 0; Shift < 32; Shift += 8)
+	{
+		DWORD Low = 255, High = 0;
+		for (DWORD x = 0; x < 16; x++)
+		{
+			DWORD Value = (Texels[x] >> Shift) & 0xFF;
+			Low = min(Low, Value);
+			High = max(High, Value);
+		}
+		MinColor |= Low << Shift;
+		MaxColor |= High << Shift;
+	}
+}
+
+// Moves the color channels of the bounding box inward by 1/16 of its size
+static inline void InsetColors(DWORD& MinColor, DWORD& MaxColor)
+{
+	DWORD NewMin = MinColor & 0xFF000000, NewMax = MaxColor & 0xFF000000;
+	for (DWORD Shift = 0; Shift < 24; Shift += 8)
+	{
+		DWORD Low = (MinColor >> Shift) & 0xFF;
+		DWORD High = (MaxColor >> Shift) & 0xFF;
+		DWORD Inset = (High - Low) >> 4;
+		NewMin |= (Low + Inset) << Shift;
+		NewMax |= (High - Inset) << Shift;
+	}
+	MinColor = NewMin;
+	MaxColor = NewMax;
+}
+
+// Picks the closest palette color for each texel by sum of absolute differences, ties go to the lower index
+static inline DWORD GetColorIndices(const DWORD Texels[16], const DWORD Palette[4], DWORD PaletteCount, bool HasTransparency)
+{
+	DWORD Index[16];
+
+	if (Utils::IsSSE2Supported())
+	{
+		const __m128i ColorMask = _mm_set1_epi32(0x00FFFFFF);
+		const __m128i ByteMask = _mm_set1_epi32(0xFF);
+		const __m128i Half = _mm_set1_epi32(128);
+
+		__m128i Colors[4];
+		for (DWORD k = 0; k < 4; k++)
+		{
+			Colors[k] = _mm_set1_epi32(Palette[k]);
+		}
+
+		for (DWORD x = 0; x < 16; x += 4)
+		{
+			__m128i Texel = _mm_loadu_si128((const __m128i*)(Texels + x));
+			__m128i Best = _mm_set1_epi32(0x7FFFFFFF);
+			__m128i BestIndex = _mm_setzero_si128();
+
+			for (DWORD k = 0; k < PaletteCount; k++)
+			{
+				__m128i Diff = _mm_and_si128(_mm_or_si128(_mm_subs_epu8(Texel, Colors[k]), _mm_subs_epu8(Colors[k], Texel)), ColorMask);
+				__m128i Distance = _mm_add_epi32(_mm_add_epi32(_mm_and_si128(Diff, ByteMask), _mm_and_si128(_mm_srli_epi32(Diff, 8), ByteMask)), _mm_srli_epi32(Diff, 16));
+
+				__m128i IsCloser = _mm_cmplt_epi32(Distance, Best);
+				Best = _mm_or_si128(_mm_and_si128(IsCloser, Distance), _mm_andnot_si128(IsCloser, Best));
+				BestIndex = _mm_or_si128(_mm_and_si128(IsCloser, _mm_set1_epi32(k)), _mm_andnot_si128(IsCloser, BestIndex));
+			}
+
+			if (HasTransparency)
+			{
+				__m128i IsTransparent = _mm_cmplt_epi32(_mm_srli_epi32(Texel, 24), Half);
+				BestIndex = _mm_or_si128(_mm_and_si128(IsTransparent, _mm_set1_epi32(3)), _mm_andnot_si128(IsTransparent, BestIndex));
+			}
+
+			_mm_storeu_si128((__m128i*)(Index + x), BestIndex);
+		}
+	}
+	else
+	{
+		for (DWORD x = 0; x < 16; x++)
+		{
+			DWORD Best = 0x7FFFFFFF;
+			Index[x] = 0;
+			for (DWORD k = 0; k < PaletteCount; k++)
+			{
+				DWORD Distance = 0;
+				for (DWORD Shift = 0; Shift < 24; Shift += 8)
+				{
+					LONG Diff = (LONG)((Texels[x] >> Shift) & 0xFF) - (LONG)((Palette[k] >> Shift) & 0xFF);
+					Distance += (Diff < 0) ? -Diff : Diff;
+				}
+				if (Distance < Best)
+				{
+					Best = Distance;
+					Index[x] = k;
+				}
+			}
+			if (HasTransparency && (Texels[x] >> 24) < 128)
+			{
+				Index[x] = 3;
+			}
+		}
+	}
+
+	DWORD Indices = 0;
+	for (DWORD x = 0; x < 16; x++)
+	{
+		Indices |= Index[x] << (x * 2);
+	}
+	return Indices;
+}
+
+// Encodes the color part of a block, DXT1 blocks with transparent texels use the three color mode
+static inline void EncodeColorBlock(const DWORD Texels[16], bool IsDXT1, bool HasTransparency, BYTE* pBlock)
+{
+	DWORD MinColor, MaxColor;
+	if (HasTransparency)
+	{
+		// Only the opaque texels define the colors
+		DWORD Opaque[16];
+		DWORD Count = 0;
+		for (DWORD x = 0; x < 16; x++)
+		{
+			if ((Texels[x] >> 24) >= 128)
+			{
+				Opaque[Count++] = Texels[x];
+			}
+		}
+		if (!Count)
+		{
+			WriteDword(pBlock, 0x00000000);
+			WriteDword(pBlock + 4, 0xFFFFFFFF);
+			return;
+		}
+		for (DWORD x = Count; x < 16; x++)
+		{
+			Opaque[x] = Opaque[0];
+		}
+		GetMinMaxColors(Opaque, MinColor, MaxColor);
+	}
+	else
+	{
+		GetMinMaxColors(Texels, MinColor, MaxColor);
+	}
+	InsetColors(MinColor, MaxColor);
+
+	DWORD Color0 = Pack565(MaxColor);
+	DWORD Color1 = Pack565(MinColor);
+
+	// Four color blocks need Color0 > Color1, three color blocks need Color0 <= Color1
+	if ((Color0 < Color1) != HasTransparency)
+	{
+		DWORD Temp = Color0;
+		Color0 = Color1;
+		Color1 = Temp;
+	}
+
+	DWORD Palette[4];
+	GetColorPalette(Color0, Color1, !IsDXT1, Palette);
+
+	DWORD Indices = 0;
+	if (Color0 != Color1 || HasTransparency)
+	{
+		Indices = GetColorIndices(Texels, Palette, HasTransparency ? 3 : 4, HasTransparency);
+	}
+
+	WriteWord(pBlock, Color0);
+	WriteWord(pBlock + 2, Color1);
+	WriteDword(pBlock + 4, Indices);
+}
+
+// Encodes the DXT5 alpha part of a block using the eight value mode
+static inline void EncodeAlphaBlock(const DWORD Texels[16], BYTE* pBlock)
+{
+	DWORD MinAlpha = 255, MaxAlpha = 0;
+	for (DWORD x = 0; x < 16; x++)
+	{
+		MinAlpha = min(MinAlpha, Texels[x] >> 24);
+		MaxAlpha = max(MaxAlpha, Texels[x] >> 24);
+	}
+
+	pBlock[0] = (BYTE)MaxAlpha;
+	pBlock[1] = (BYTE)MinAlpha;
+
+	unsigned long long Indices = 0;
+	if (MaxAlpha != MinAlpha)
+	{
+		DWORD Palette[8];
+		GetAlphaPalette(MaxAlpha, MinAlpha, Palette);
+
+		for (DWORD x = 0; x < 16; x++)
+		{
+			DWORD Alpha = Texels[x] >> 24;
+			DWORD Best = 256, BestIndex = 0;
+			for (DWORD k = 0; k < 8; k++)
+			{
+				DWORD Distance = (Alpha > Palette[k]) ? Alpha - Palette[k] : Palette[k] - Alpha;
+				if (Distance < Best)
+				{
+					Best = Distance;
+					BestIndex = k;
+				}
+			}
+			Indices |= (unsigned long long)BestIndex << (x * 3);
+		}
+	}
+
+	WriteDword(pBlock + 2, (DWORD)Indices);
+	WriteWord(pBlock + 6, (DWORD)(Indices >> 32));
+}
+
+static inline void EncodeBlock(D3DFORMAT Format, const DWORD Texels[16], bool SrcHasAlpha, BYTE* pBlock)
+{
+	if (Format == D3DFMT_DXT1)
+	{
+		bool HasTransparency = false;
+		for (DWORD x = 0; SrcHasAlpha && x < 16; x++)
+		{
+			HasTransparency |= (Texels[x] >> 24) < 128;
+		}
+		EncodeColorBlock(Texels, true, HasTransparency, pBlock);
+		return;
+	}
+
+	if (Format == D3DFMT_DXT2 || Format == D3DFMT_DXT3)
+	{
+		for (DWORD x = 0; x < 16; x += 2)
+		{
+			DWORD Alpha0 = ((Texels[x] >> 24) * 15 + 127) / 255;
+			DWORD Alpha1 = ((Texels[x + 1] >> 24) * 15 + 127) / 255;
+			pBlock[x / 2] = (BYTE)(Alpha0 | (Alpha1 << 4));
+		}
+	}
+	else
+	{
+		EncodeAlphaBlock(Texels, pBlock);
+	}
+	EncodeColorBlock(Texels, false, false, pBlock + 8);
+}
+
+// Decodes or encodes the block rows of the job
+static void RunDXTJob(const DXTJOB& Job)
+{
+	const DWORD BlockSize = GetBlockSize(Job.Format);
+	const DWORD BlockCountX = (Job.Width + 3) / 4;
+
+	DWORD Texels[16];
+	for (DWORD BlockY = Job.StartBlockRow; BlockY < Job.EndBlockRow; BlockY++)
+	{
+		for (DWORD BlockX = 0; BlockX < BlockCountX; BlockX++)
+		{
+			if (Job.IsEncode)
+			{
+				LoadBlock(Job, BlockX, BlockY, Texels);
+				EncodeBlock(Job.Format, Texels, Job.SrcHasAlpha, Job.pDestBits + BlockY * Job.DestPitch + BlockX * BlockSize);
+				continue;
+			}
+
+			DecodeBlock(Job.Format, Job.pSrcBits + BlockY * Job.SrcPitch + BlockX * BlockSize, Texels);
+
+			// Blocks on the right and bottom edge can be partly outside of the image
+			const DWORD CopyWidth = min((DWORD)4, Job.Width - BlockX * 4);
+			const DWORD CopyHeight = min((DWORD)4, Job.Height - BlockY * 4);
+			for (DWORD y = 0; y < CopyHeight; y++)
+			{
+				memcpy(Job.pDestBits + (BlockY * 4 + y) * Job.DestPitch + BlockX * 16, &Texels[y * 4], CopyWidth * sizeof(DWORD));
+			}
+		}
+	}
+}
+
+static void RunDXTBand(void* pContext, DWORD Band)
+{
+	DXTJOB Job = *(const DXTJOB*)pContext;
+	Job.StartBlockRow = Band * DXTBandBlockRows;
+	Job.EndBlockRow = min(Job.StartBlockRow + DXTBandBlockRows, (Job.Height + 3) / 4);
+	RunDXTJob(Job);
+}
+
+// Splits large images into bands of block rows that run on the surface copy worker pool
+static void RunDXTJobThreaded(DXTJOB& Job)
+{
+	const DWORD BlockRows = (Job.Height + 3) / 4;
+
+	if (Job.Width * Job.Height < DXTMinThreadTexels || BlockRows <= DXTBandBlockRows)
+	{
+		Job.StartBlockRow = 0;
+		Job.EndBlockRow = BlockRows;
+		RunDXTJob(Job);
+		return;
+	}
+
+	RunSurfaceBands(RunDXTBand, &Job, (BlockRows + DXTBandBlockRows - 1) / DXTBandBlockRows);
+}
+
+bool IsDXTCodecFormat(D3DFORMAT Format)
+{
+	switch ((DWORD)Format)
+	{
+	case D3DFMT_DXT1:
+	case D3DFMT_DXT2:
+	case D3DFMT_DXT3:
+	case D3DFMT_DXT4:
+	case D3DFMT_DXT5:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Decodes DXT blocks to A8R8G8B8, the source pitch is the size of one row of blocks
+bool DecodeDXT(D3DFORMAT SrcFormat, const void* pSrcBits, LONG SrcPitch, void* pDestBits, LONG DestPitch, DWORD Width, DWORD Height)
+{
+	if (!pSrcBits || !pDestBits || !Width || !Height || !IsDXTCodecFormat(SrcFormat))
+	{
+		return false;
+	}
+
+	DXTJOB Job;
+	Job.Format = SrcFormat;
+	Job.pSrcBits = (const BYTE*)pSrcBits;
+	Job.SrcPitch = SrcPitch;
+	Job.pDestBits = (BYTE*)pDestBits;
+	Job.DestPitch = DestPitch;
+	Job.Width = Width;
+	Job.Height = Height;
+	RunDXTJobThreaded(Job);
+
+	return true;
+}
+
+// Encodes A8R8G8B8 or X8R8G8B8 texels to DXT blocks, the destination pitch is the size of one row of blocks
+bool EncodeDXT(D3DFORMAT DestFormat, const void* pSrcBits, LONG SrcPitch, bool SrcHasAlpha, void* pDestBits, LONG DestPitch, DWORD Width, DWORD Height)
+{
+	if (!pSrcBits || !pDestBits || !Width || !Height || !IsDXTCodecFormat(DestFormat))
+	{
+		return false;
+	}
+
+	DXTJOB Job;
+	Job.IsEncode = true;
+	Job.Format = DestFormat;
+	Job.pSrcBits = (const BYTE*)pSrcBits;
+	Job.SrcPitch = SrcPitch;
+	Job.SrcHasAlpha = SrcHasAlpha;
+	Job.pDestBits = (BYTE*)pDestBits;
+	Job.DestPitch = DestPitch;
+	Job.Width = Width;
+	Job.Height = Height;
+	RunDXTJobThreaded(Job);
+
+	return true;
+}
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <d3d9.h>
+
+bool IsDXTCodecFormat(D3DFORMAT Format);
+bool DecodeDXT(D3DFORMAT SrcFormat, const void* pSrcBits, LONG SrcPitch, void* pDestBits, LONG DestPitch, DWORD Width, DWORD Height);
+bool EncodeDXT(D3DFORMAT DestFormat, const void* pSrcBits, LONG SrcPitch, bool SrcHasAlpha, void* pDestBits, LONG DestPitch, DWORD Width, DWORD Height);
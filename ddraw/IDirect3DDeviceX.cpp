@@ -25,6 +25,13 @@ namespace {
 	m_IDirect3DDevice7* WrapperInterfaceBackup7 = nullptr;
 }
 
+// Render states that pre-DirectX 7 draw flags can override
+namespace {
+	constexpr DWORD DrawOverrideClipping = 0x01;
+	constexpr DWORD DrawOverrideLighting = 0x02;
+	constexpr DWORD DrawOverrideExtents = 0x04;
+}
+
 HRESULT m_IDirect3DDeviceX::QueryInterface(REFIID riid, LPVOID FAR * ppvObj, DWORD DirectXVersion)
 {
 	Logging::LogDebug() << __FUNCTION__ << " (" << this << ") " << riid;
@@ -264,8 +271,30 @@ HRESULT m_IDirect3DDeviceX::Execute(LPDIRECT3DEXECUTEBUFFER lpDirect3DExecuteBuf
 
 	if (ProxyDirectXVersion != 1)
 	{
-		LOG_LIMIT(100, __FUNCTION__ << " Error: Not Implemented");
-		return DDERR_UNSUPPORTED;
+		if (!lpDirect3DExecuteBuffer)
+		{
+			return DDERR_INVALIDPARAMS;
+		}
+
+		m_IDirect3DExecuteBuffer* pExecuteBuffer = nullptr;
+		if (FAILED(lpDirect3DExecuteBuffer->QueryInterface(IID_GetInterfaceX, (LPVOID*)&pExecuteBuffer)) || !pExecuteBuffer)
+		{
+			LOG_LIMIT(100, __FUNCTION__ << " Error: could not get execute buffer wrapper!");
+			return DDERR_INVALIDPARAMS;
+		}
+
+		// Execute uses the viewport passed in
+		if (lpDirect3DViewport && (LPDIRECT3DVIEWPORT3)lpDirect3DViewport != lpCurrentViewport)
+		{
+			HRESULT hr = SetCurrentViewport((LPDIRECT3DVIEWPORT3)lpDirect3DViewport);
+			if (FAILED(hr))
+			{
+				LOG_LIMIT(100, __FUNCTION__ << " Error: failed to set viewport: " << (D3DERR)hr);
+				return hr;
+			}
+		}
+
+		return ExecuteInstructions(pExecuteBuffer, dwFlags);
 	}
 
 	if (lpDirect3DExecuteBuffer)
@@ -321,8 +350,23 @@ HRESULT m_IDirect3DDeviceX::CreateMatrix(LPD3DMATRIXHANDLE lpD3DMatHandle)
 
 	if (ProxyDirectXVersion != 1)
 	{
-		LOG_LIMIT(100, __FUNCTION__ << " Error: Not Implemented");
-		return DDERR_UNSUPPORTED;
+		if (!lpD3DMatHandle)
+		{
+			return DDERR_INVALIDPARAMS;
+		}
+
+		// Handle zero is not valid
+		do {
+			LastMatrixHandle++;
+		} while (!LastMatrixHandle || MatrixHandleMap.find(LastMatrixHandle) != MatrixHandleMap.end());
+
+		D3DMATRIX Matrix = {};
+		Matrix._11 = Matrix._22 = Matrix._33 = Matrix._44 = 1.0f;
+		MatrixHandleMap[LastMatrixHandle] = Matrix;
+
+		*lpD3DMatHandle = LastMatrixHandle;
+
+		return D3D_OK;
 	}
 
 	return GetProxyInterfaceV1()->CreateMatrix(lpD3DMatHandle);
@@ -334,8 +378,21 @@ HRESULT m_IDirect3DDeviceX::SetMatrix(D3DMATRIXHANDLE d3dMatHandle, const LPD3DM
 
 	if (ProxyDirectXVersion != 1)
 	{
-		LOG_LIMIT(100, __FUNCTION__ << " Error: Not Implemented");
-		return DDERR_UNSUPPORTED;
+		if (!lpD3DMatrix)
+		{
+			return DDERR_INVALIDPARAMS;
+		}
+
+		auto it = MatrixHandleMap.find(d3dMatHandle);
+		if (it == MatrixHandleMap.end())
+		{
+			LOG_LIMIT(100, __FUNCTION__ << " Error: could not find matrix handle: " << d3dMatHandle);
+			return D3DERR_MATRIX_SETDATA_FAILED;
+		}
+
+		it->second = *lpD3DMatrix;
+
+		return D3D_OK;
 	}
 
 	return GetProxyInterfaceV1()->SetMatrix(d3dMatHandle, lpD3DMatrix);
@@ -347,8 +404,21 @@ HRESULT m_IDirect3DDeviceX::GetMatrix(D3DMATRIXHANDLE lpD3DMatHandle, LPD3DMATRI
 
 	if (ProxyDirectXVersion != 1)
 	{
-		LOG_LIMIT(100, __FUNCTION__ << " Error: Not Implemented");
-		return DDERR_UNSUPPORTED;
+		if (!lpD3DMatrix)
+		{
+			return DDERR_INVALIDPARAMS;
+		}
+
+		auto it = MatrixHandleMap.find(lpD3DMatHandle);
+		if (it == MatrixHandleMap.end())
+		{
+			LOG_LIMIT(100, __FUNCTION__ << " Error: could not find matrix handle: " << lpD3DMatHandle);
+			return D3DERR_MATRIX_GETDATA_FAILED;
+		}
+
+		*lpD3DMatrix = it->second;
+
+		return D3D_OK;
 	}
 
 	return GetProxyInterfaceV1()->GetMatrix(lpD3DMatHandle, lpD3DMatrix);
@@ -360,8 +430,13 @@ HRESULT m_IDirect3DDeviceX::DeleteMatrix(D3DMATRIXHANDLE d3dMatHandle)
 
 	if (ProxyDirectXVersion != 1)
 	{
-		LOG_LIMIT(100, __FUNCTION__ << " Error: Not Implemented");
-		return DDERR_UNSUPPORTED;
+		if (!MatrixHandleMap.erase(d3dMatHandle))
+		{
+			LOG_LIMIT(100, __FUNCTION__ << " Error: could not find matrix handle: " << d3dMatHandle);
+			return D3DERR_MATRIX_DESTROY_FAILED;
+		}
+
+		return D3D_OK;
 	}
 
 	return GetProxyInterfaceV1()->DeleteMatrix(d3dMatHandle);
@@ -1026,6 +1101,14 @@ HRESULT m_IDirect3DDeviceX::SetTexture(DWORD dwStage, LPDIRECTDRAWSURFACE7 lpSur
 		{
 			AttachedTexture[dwStage] = lpSurface;
 			CurrentTextureSurfaceX[dwStage] = lpDDSrcSurfaceX;
+			if (lpDDSrcSurfaceX)
+			{
+				TextureStageMask |= (1UL << dwStage);
+			}
+			else
+			{
+				TextureStageMask &= ~(1UL << dwStage);
+			}
 		}
 
 		return hr;
@@ -1775,14 +1858,22 @@ HRESULT m_IDirect3DDeviceX::GetViewport(LPD3DVIEWPORT7 lpViewport)
 	return GetProxyInterfaceV7()->GetViewport(lpViewport);
 }
 
-HRESULT m_IDirect3DDeviceX::Begin(D3DPRIMITIVETYPE d3dpt, DWORD d3dvt, DWORD dwFlags)
+HRESULT m_IDirect3DDeviceX::Begin(D3DPRIMITIVETYPE d3dpt, DWORD d3dvt, DWORD dwFlags, DWORD DirectXVersion)
 {
 	Logging::LogDebug() << __FUNCTION__ << " (" << this << ")";
 
 	if (ProxyDirectXVersion > 3)
 	{
-		LOG_LIMIT(100, __FUNCTION__ << " Error: Not Implemented");
-		return DDERR_UNSUPPORTED;
+		HRESULT hr = StartBeginEnd(d3dpt, d3dvt, dwFlags, DirectXVersion);
+		if (FAILED(hr))
+		{
+			return hr;
+		}
+
+		BeginEnd.IsActive = true;
+		BeginEnd.IsIndexed = false;
+
+		return D3D_OK;
 	}
 
 	switch (ProxyDirectXVersion)
@@ -1797,14 +1888,30 @@ HRESULT m_IDirect3DDeviceX::Begin(D3DPRIMITIVETYPE d3dpt, DWORD d3dvt, DWORD dwF
 	}
 }
 
-HRESULT m_IDirect3DDeviceX::BeginIndexed(D3DPRIMITIVETYPE dptPrimitiveType, DWORD dvtVertexType, LPVOID lpvVertices, DWORD dwNumVertices, DWORD dwFlags)
+HRESULT m_IDirect3DDeviceX::BeginIndexed(D3DPRIMITIVETYPE dptPrimitiveType, DWORD dvtVertexType, LPVOID lpvVertices, DWORD dwNumVertices, DWORD dwFlags, DWORD DirectXVersion)
 {
 	Logging::LogDebug() << __FUNCTION__ << " (" << this << ")";
 
 	if (ProxyDirectXVersion > 3)
 	{
-		LOG_LIMIT(100, __FUNCTION__ << " Error: Not Implemented");
-		return DDERR_UNSUPPORTED;
+		if (!lpvVertices || !dwNumVertices)
+		{
+			return DDERR_INVALIDPARAMS;
+		}
+
+		HRESULT hr = StartBeginEnd(dptPrimitiveType, dvtVertexType, dwFlags, DirectXVersion);
+		if (FAILED(hr))
+		{
+			return hr;
+		}
+
+		// Vertices stay owned by the application until End is called
+		BeginEnd.IsActive = true;
+		BeginEnd.IsIndexed = true;
+		BeginEnd.lpIndexedVertices = lpvVertices;
+		BeginEnd.IndexedVertexCount = dwNumVertices;
+
+		return D3D_OK;
 	}
 
 	switch (ProxyDirectXVersion)
@@ -1825,8 +1932,27 @@ HRESULT m_IDirect3DDeviceX::Vertex(LPVOID lpVertexType)
 
 	if (ProxyDirectXVersion > 3)
 	{
-		LOG_LIMIT(100, __FUNCTION__ << " Error: Not Implemented");
-		return DDERR_UNSUPPORTED;
+		if (!lpVertexType)
+		{
+			return DDERR_INVALIDPARAMS;
+		}
+
+		if (!BeginEnd.IsActive)
+		{
+			LOG_LIMIT(100, __FUNCTION__ << " Error: called outside of Begin and End!");
+			return D3DERR_NOTINBEGIN;
+		}
+
+		// Indexed primitives take their vertices from BeginIndexed
+		if (BeginEnd.IsIndexed)
+		{
+			LOG_LIMIT(100, __FUNCTION__ << " Error: called after BeginIndexed!");
+			return DDERR_INVALIDPARAMS;
+		}
+
+		BeginEnd.Vertices.insert(BeginEnd.Vertices.end(), (BYTE*)lpVertexType, (BYTE*)lpVertexType + BeginEnd.VertexStride);
+
+		return D3D_OK;
 	}
 
 	switch (ProxyDirectXVersion)
@@ -1847,8 +1973,21 @@ HRESULT m_IDirect3DDeviceX::Index(WORD wVertexIndex)
 
 	if (ProxyDirectXVersion > 3)
 	{
-		LOG_LIMIT(100, __FUNCTION__ << " Error: Not Implemented");
-		return DDERR_UNSUPPORTED;
+		if (!BeginEnd.IsActive || !BeginEnd.IsIndexed)
+		{
+			LOG_LIMIT(100, __FUNCTION__ << " Error: called outside of BeginIndexed and End!");
+			return D3DERR_NOTINBEGIN;
+		}
+
+		if (wVertexIndex >= BeginEnd.IndexedVertexCount)
+		{
+			LOG_LIMIT(100, __FUNCTION__ << " Error: index out of range: " << wVertexIndex << " vertex count: " << BeginEnd.IndexedVertexCount);
+			return DDERR_INVALIDPARAMS;
+		}
+
+		BeginEnd.Indices.push_back(wVertexIndex);
+
+		return D3D_OK;
 	}
 
 	switch (ProxyDirectXVersion)
@@ -1869,8 +2008,41 @@ HRESULT m_IDirect3DDeviceX::End(DWORD dwFlags)
 
 	if (ProxyDirectXVersion > 3)
 	{
-		LOG_LIMIT(100, __FUNCTION__ << " Error: Not Implemented");
-		return DDERR_UNSUPPORTED;
+		UNREFERENCED_PARAMETER(dwFlags);
+
+		if (!BeginEnd.IsActive)
+		{
+			LOG_LIMIT(100, __FUNCTION__ << " Error: called without Begin!");
+			return D3DERR_NOTINBEGIN;
+		}
+		BeginEnd.IsActive = false;
+
+		// Draw everything collected since Begin as a single primitive
+		HRESULT hr = D3D_OK;
+		if (BeginEnd.IsIndexed)
+		{
+			if (BeginEnd.Indices.size())
+			{
+				hr = DrawIndexedPrimitive(BeginEnd.PrimitiveType, BeginEnd.VertexType, BeginEnd.lpIndexedVertices, BeginEnd.IndexedVertexCount,
+					BeginEnd.Indices.data(), BeginEnd.Indices.size(), BeginEnd.Flags, BeginEnd.DirectXVersion);
+			}
+		}
+		else
+		{
+			DWORD VertexCount = BeginEnd.Vertices.size() / BeginEnd.VertexStride;
+			if (VertexCount)
+			{
+				hr = DrawPrimitive(BeginEnd.PrimitiveType, BeginEnd.VertexType, BeginEnd.Vertices.data(), VertexCount, BeginEnd.Flags, BeginEnd.DirectXVersion);
+			}
+		}
+
+		// Keep the storage for the next primitive
+		BeginEnd.Vertices.clear();
+		BeginEnd.Indices.clear();
+		BeginEnd.lpIndexedVertices = nullptr;
+		BeginEnd.IndexedVertexCount = 0;
+
+		return hr;
 	}
 
 	switch (ProxyDirectXVersion)
@@ -2668,6 +2840,17 @@ HRESULT m_IDirect3DDeviceX::SetRenderState(D3DRENDERSTATETYPE dwRenderStateType,
 {
 	Logging::LogDebug() << __FUNCTION__ << " (" << this << ") " << dwRenderStateType << " " << dwRenderState;
 
+	// State is overridden by the last draw, store the value so it is set when the override ends
+	if (DrawStates.rsOverrides)
+	{
+		DWORD* pSavedState = GetDrawStateOverride(dwRenderStateType);
+		if (pSavedState)
+		{
+			*pSavedState = dwRenderState;
+			return D3D_OK;
+		}
+	}
+
 	if (Config.Dd7to9)
 	{
 		// Check for device interface
@@ -3071,6 +3254,17 @@ HRESULT m_IDirect3DDeviceX::GetRenderState(D3DRENDERSTATETYPE dwRenderStateType,
 {
 	Logging::LogDebug() << __FUNCTION__ << " (" << this << ") " << dwRenderStateType;
 
+	// State is overridden by the last draw, return the value the application set
+	if (DrawStates.rsOverrides && lpdwRenderState)
+	{
+		DWORD* pSavedState = GetDrawStateOverride(dwRenderStateType);
+		if (pSavedState)
+		{
+			*lpdwRenderState = *pSavedState;
+			return D3D_OK;
+		}
+	}
+
 	if (Config.Dd7to9)
 	{
 		if (!lpdwRenderState)
@@ -3240,6 +3434,9 @@ HRESULT m_IDirect3DDeviceX::BeginStateBlock()
 {
 	Logging::LogDebug() << __FUNCTION__ << " (" << this << ")";
 
+	// End draw overrides so state blocks only see the application's states
+	UpdateDrawStateOverrides(0);
+
 	if (Config.Dd7to9)
 	{
 		// Check for device interface
@@ -3263,7 +3460,14 @@ HRESULT m_IDirect3DDeviceX::BeginStateBlock()
 		return hr;
 	}
 
-	return GetProxyInterfaceV7()->BeginStateBlock();
+	HRESULT hr = GetProxyInterfaceV7()->BeginStateBlock();
+
+	if (SUCCEEDED(hr))
+	{
+		IsRecordingState = true;
+	}
+
+	return hr;
 }
 
 HRESULT m_IDirect3DDeviceX::EndStateBlock(LPDWORD lpdwBlockHandle)
@@ -3300,7 +3504,14 @@ HRESULT m_IDirect3DDeviceX::EndStateBlock(LPDWORD lpdwBlockHandle)
 		return hr;
 	}
 
-	return GetProxyInterfaceV7()->EndStateBlock(lpdwBlockHandle);
+	HRESULT hr = GetProxyInterfaceV7()->EndStateBlock(lpdwBlockHandle);
+
+	if (SUCCEEDED(hr))
+	{
+		IsRecordingState = false;
+	}
+
+	return hr;
 }
 
 HRESULT m_IDirect3DDeviceX::DrawPrimitive(D3DPRIMITIVETYPE dptPrimitiveType, DWORD dwVertexTypeDesc, LPVOID lpVertices, DWORD dwVertexCount, DWORD dwFlags, DWORD DirectXVersion)
@@ -3403,6 +3614,9 @@ HRESULT m_IDirect3DDeviceX::DrawPrimitive(D3DPRIMITIVETYPE dptPrimitiveType, DWO
 		}
 		else
 		{
+			// End overrides left by earlier draws
+			UpdateDrawStateOverrides(0);
+
 			return GetProxyInterfaceV7()->DrawPrimitive(dptPrimitiveType, dwVertexTypeDesc, lpVertices, dwVertexCount, dwFlags);
 		}
 	}
@@ -3442,6 +3656,9 @@ HRESULT m_IDirect3DDeviceX::DrawPrimitiveStrided(D3DPRIMITIVETYPE dptPrimitiveTy
 		}
 		else
 		{
+			// End overrides left by earlier draws
+			UpdateDrawStateOverrides(0);
+
 			return GetProxyInterfaceV7()->DrawPrimitiveStrided(dptPrimitiveType, dwVertexTypeDesc, lpVertexArray, dwVertexCount, dwFlags);
 		}
 	}
@@ -3560,6 +3777,9 @@ HRESULT m_IDirect3DDeviceX::DrawPrimitiveVB(D3DPRIMITIVETYPE dptPrimitiveType, L
 		}
 		else
 		{
+			// End overrides left by earlier draws
+			UpdateDrawStateOverrides(0);
+
 			return GetProxyInterfaceV7()->DrawPrimitiveVB(dptPrimitiveType, lpd3dVertexBuffer, dwStartVertex, dwNumVertices, dwFlags);
 		}
 	}
@@ -3667,6 +3887,9 @@ HRESULT m_IDirect3DDeviceX::DrawIndexedPrimitive(D3DPRIMITIVETYPE dptPrimitiveTy
 		}
 		else
 		{
+			// End overrides left by earlier draws
+			UpdateDrawStateOverrides(0);
+
 			return GetProxyInterfaceV7()->DrawIndexedPrimitive(dptPrimitiveType, dwVertexTypeDesc, lpVertices, dwVertexCount, lpIndices, dwIndexCount, dwFlags);
 		}
 	}
@@ -3706,6 +3929,9 @@ HRESULT m_IDirect3DDeviceX::DrawIndexedPrimitiveStrided(D3DPRIMITIVETYPE dptPrim
 		}
 		else
 		{
+			// End overrides left by earlier draws
+			UpdateDrawStateOverrides(0);
+
 			return GetProxyInterfaceV7()->DrawIndexedPrimitiveStrided(dptPrimitiveType, dwVertexTypeDesc, lpVertexArray, dwVertexCount, lpwIndices, dwIndexCount, dwFlags);
 		}
 	}
@@ -3842,6 +4068,9 @@ HRESULT m_IDirect3DDeviceX::DrawIndexedPrimitiveVB(D3DPRIMITIVETYPE dptPrimitive
 		}
 		else
 		{
+			// End overrides left by earlier draws
+			UpdateDrawStateOverrides(0);
+
 			return GetProxyInterfaceV7()->DrawIndexedPrimitiveVB(dptPrimitiveType, lpd3dVertexBuffer, dwStartVertex, dwNumVertices, lpwIndices, dwIndexCount, dwFlags);
 		}
 	}
@@ -3858,16 +4087,38 @@ HRESULT m_IDirect3DDeviceX::ComputeSphereVisibility(LPD3DVECTOR lpCenters, LPD3D
 			return DDERR_INVALIDPARAMS;
 		}
 
-		LOG_LIMIT(100, __FUNCTION__ << " Warning: function not fully implemented");
+		if (dwFlags)
+		{
+			LOG_LIMIT(100, __FUNCTION__ << " Warning: flags not supported. dwFlags: " << Logging::hex(dwFlags));
+		}
+
+		// Check for device interface
+		if (FAILED(CheckInterface(__FUNCTION__, true)))
+		{
+			return DDERR_INVALIDOBJECT;
+		}
+
+		// Sphere visibility is computed by moving the viewing frustum to the model space using the combined world, view and projection matrices.
+		// If the combined matrix is degenerate the method fails, returning D3DERR_INVALIDMATRIX.
+		D3DMATRIX WorldMatrix, ViewMatrix, ProjectionMatrix, WorldViewMatrix, Matrix;
+		if (FAILED((*d3d9Device)->GetTransform(D3DTS_WORLD, &WorldMatrix)) ||
+			FAILED((*d3d9Device)->GetTransform(D3DTS_VIEW, &ViewMatrix)) ||
+			FAILED((*d3d9Device)->GetTransform(D3DTS_PROJECTION, &ProjectionMatrix)))
+		{
+			return DDERR_GENERIC;
+		}
+		MultiplyMatrix(WorldViewMatrix, WorldMatrix, ViewMatrix);
+		MultiplyMatrix(Matrix, WorldViewMatrix, ProjectionMatrix);
 
-		// Sphere visibility is computed by back-transforming the viewing frustum to the model space, using the inverse of the combined world, view, or projection matrices.
-		// If the combined matrix can't be inverted (if the determinant is 0), the method will fail, returning D3DERR_INVALIDMATRIX.
-		for (UINT x = 0; x < dwNumSpheres; x++)
+		D3DFRUSTUM Frustum;
+		if (!ComputeFrustumPlanes(Frustum, Matrix))
 		{
-			// If a sphere is completely visible, the corresponding entry in lpdwReturnValues is 0.
-			lpdwReturnValues[x] = 0;	// Just return all is visible for now
+			return D3DERR_INVALIDMATRIX;
 		}
 
+		// If a sphere is completely visible, the corresponding entry in lpdwReturnValues is 0.
+		CheckSphereVisibility(Frustum, lpCenters, lpRadii, dwNumSpheres, lpdwReturnValues);
+
 		return D3D_OK;
 	}
 
@@ -3944,6 +4195,9 @@ HRESULT m_IDirect3DDeviceX::ApplyStateBlock(DWORD dwBlockHandle)
 {
 	Logging::LogDebug() << __FUNCTION__ << " (" << this << ")";
 
+	// End draw overrides so state blocks only see the application's states
+	UpdateDrawStateOverrides(0);
+
 	if (Config.Dd7to9)
 	{
 		if (!dwBlockHandle || StateBlockTokens.find(dwBlockHandle) == StateBlockTokens.end())
@@ -3966,6 +4220,9 @@ HRESULT m_IDirect3DDeviceX::CaptureStateBlock(DWORD dwBlockHandle)
 {
 	Logging::LogDebug() << __FUNCTION__ << " (" << this << ")";
 
+	// End draw overrides so state blocks only see the application's states
+	UpdateDrawStateOverrides(0);
+
 	if (Config.Dd7to9)
 	{
 		if (!dwBlockHandle || StateBlockTokens.find(dwBlockHandle) == StateBlockTokens.end())
@@ -4014,6 +4271,9 @@ HRESULT m_IDirect3DDeviceX::CreateStateBlock(D3DSTATEBLOCKTYPE d3dsbtype, LPDWOR
 {
 	Logging::LogDebug() << __FUNCTION__ << " (" << this << ")";
 
+	// End draw overrides so state blocks only see the application's states
+	UpdateDrawStateOverrides(0);
+
 	if (Config.Dd7to9)
 	{
 		if (!lpdwBlockHandle)
@@ -4530,6 +4790,9 @@ HRESULT m_IDirect3DDeviceX::RestoreStates()
 
 void m_IDirect3DDeviceX::BeforeResetDevice()
 {
+	// End the draw flag overrides so the application values are backed up and restored
+	UpdateDrawStateOverrides(0);
+
 	BackupStates();
 	if (IsRecordingState)
 	{
@@ -4598,6 +4861,12 @@ void m_IDirect3DDeviceX::SetDefaults()
 	rsDestBlend = 0;
 	rsColorKeyEnabled = FALSE;
 
+	// Draw flag overrides, the new device has its own render states
+	DrawStates.rsOverrides = 0;
+	DrawStates.rsClipping = 0;
+	DrawStates.rsLighting = 0;
+	DrawStates.rsExtents = 0;
+
 	// Set DirectDraw defaults
 	SetTextureStageState(1, D3DTSS_TEXCOORDINDEX, 0);
 	SetTextureStageState(2, D3DTSS_TEXCOORDINDEX, 0);
@@ -4621,24 +4890,19 @@ inline void m_IDirect3DDeviceX::SetDrawStates(DWORD dwVertexTypeDesc, DWORD& dwF
 		{
 			DWORD RenderState = (rsTextureWrappingU ? D3DWRAP_U : 0) | (rsTextureWrappingV ? D3DWRAP_V : 0);
 			SetRenderState(D3DRENDERSTATE_WRAP0, RenderState);
+			rsTextureWrappingChanged = false;
 		}
 
-		// Handle dwFlags
-		if (dwFlags & D3DDP_DONOTCLIP)
-		{
-			GetRenderState(D3DRENDERSTATE_CLIPPING, &DrawStates.rsClipping);
-			SetRenderState(D3DRENDERSTATE_CLIPPING, FALSE);
-		}
-		if ((dwFlags & D3DDP_DONOTLIGHT) || !(dwVertexTypeDesc & D3DFVF_NORMAL))
-		{
-			GetRenderState(D3DRENDERSTATE_LIGHTING, &DrawStates.rsLighting);
-			SetRenderState(D3DRENDERSTATE_LIGHTING, FALSE);
-		}
-		if (dwFlags & D3DDP_DONOTUPDATEEXTENTS)
-		{
-			GetRenderState(D3DRENDERSTATE_EXTENTS, &DrawStates.rsExtents);
-			SetRenderState(D3DRENDERSTATE_EXTENTS, FALSE);
-		}
+		// Handle dwFlags, only the states that differ from the last draw are changed
+		UpdateDrawStateOverrides(
+			((dwFlags & D3DDP_DONOTCLIP) ? DrawOverrideClipping : 0) |
+			(((dwFlags & D3DDP_DONOTLIGHT) || !(dwVertexTypeDesc & D3DFVF_NORMAL)) ? DrawOverrideLighting : 0) |
+			((dwFlags & D3DDP_DONOTUPDATEEXTENTS) ? DrawOverrideExtents : 0));
+	}
+	else
+	{
+		// DirectX 7 draws use the application's states
+		UpdateDrawStateOverrides(0);
 	}
 	// Handle antialiasing
 	if (rsAntiAliasChanged)
@@ -4655,7 +4919,7 @@ inline void m_IDirect3DDeviceX::SetDrawStates(DWORD dwVertexTypeDesc, DWORD& dwF
 		}
 		if (Config.DdrawFixByteAlignment > 1)
 		{
-			for (UINT x = 0; x < MaxTextureStages; x++)
+			for (UINT x = 0; x < MaxTextureStages && (TextureStageMask >> x); x++)
 			{
 				if (CurrentTextureSurfaceX[x] && CurrentTextureSurfaceX[x]->GetWasBitAlignLocked())
 				{
@@ -4667,7 +4931,8 @@ inline void m_IDirect3DDeviceX::SetDrawStates(DWORD dwVertexTypeDesc, DWORD& dwF
 				}
 			}
 		}
-		for (UINT x = 0; x < MaxTextureStages; x++)
+		// Only stages up to the highest bound texture need to be checked
+		for (UINT x = 0; x < MaxTextureStages && (TextureStageMask >> x); x++)
 		{
 			if (ssMipFilter[x] != D3DTEXF_NONE && CurrentTextureSurfaceX[x] && !CurrentTextureSurfaceX[x]->IsMipMapGenerated())
 			{
@@ -4677,7 +4942,7 @@ inline void m_IDirect3DDeviceX::SetDrawStates(DWORD dwVertexTypeDesc, DWORD& dwF
 		if (rsColorKeyEnabled)
 		{
 			// Check for color key alpha texture
-			for (UINT x = 0; x < MaxTextureStages; x++)
+			for (UINT x = 0; x < MaxTextureStages && (TextureStageMask >> x); x++)
 			{
 				if (CurrentTextureSurfaceX[x] && CurrentTextureSurfaceX[x]->IsColorKeyTexture() && CurrentTextureSurfaceX[x]->GetD3d9DrawTexture())
 				{
@@ -4714,27 +4979,18 @@ inline void m_IDirect3DDeviceX::SetDrawStates(DWORD dwVertexTypeDesc, DWORD& dwF
 
 inline void m_IDirect3DDeviceX::RestoreDrawStates(DWORD dwVertexTypeDesc, DWORD dwFlags, DWORD DirectXVersion)
 {
-	if (DirectXVersion < 7)
+	UNREFERENCED_PARAMETER(dwVertexTypeDesc);
+
+	// Overrides for dwFlags are left set for the next draw unless a state block is being recorded
+	if (DirectXVersion < 7 && IsRecordingState)
 	{
-		// Handle dwFlags
-		if (dwFlags & D3DDP_DONOTCLIP)
-		{
-			SetRenderState(D3DRENDERSTATE_CLIPPING, DrawStates.rsClipping);
-		}
-		if ((dwFlags & D3DDP_DONOTLIGHT) || !(dwVertexTypeDesc & D3DFVF_NORMAL))
-		{
-			SetRenderState(D3DRENDERSTATE_LIGHTING, DrawStates.rsLighting);
-		}
-		if (dwFlags & D3DDP_DONOTUPDATEEXTENTS)
-		{
-			SetRenderState(D3DRENDERSTATE_EXTENTS, DrawStates.rsExtents);
-		}
+		UpdateDrawStateOverrides(0);
 	}
 	if (Config.Dd7to9)
 	{
 		if (Config.DdrawFixByteAlignment > 1)
 		{
-			for (UINT x = 0; x < MaxTextureStages; x++)
+			for (UINT x = 0; x < MaxTextureStages && (TextureStageMask >> x); x++)
 			{
 				if (CurrentTextureSurfaceX[x] && CurrentTextureSurfaceX[x]->GetWasBitAlignLocked())
 				{
@@ -4756,19 +5012,63 @@ inline void m_IDirect3DDeviceX::RestoreDrawStates(DWORD dwVertexTypeDesc, DWORD
 	}
 }
 
+void m_IDirect3DDeviceX::SetDrawStateOverride(D3DRENDERSTATETYPE dwRenderStateType, DWORD OverrideFlag, DWORD& SavedState, bool Enable)
+{
+	if (Enable == ((DrawStates.rsOverrides & OverrideFlag) != 0))
+	{
+		return;
+	}
+
+	if (Enable)
+	{
+		GetRenderState(dwRenderStateType, &SavedState);
+		SetRenderState(dwRenderStateType, FALSE);
+		DrawStates.rsOverrides |= OverrideFlag;
+	}
+	else
+	{
+		DrawStates.rsOverrides &= ~OverrideFlag;
+		SetRenderState(dwRenderStateType, SavedState);
+	}
+}
+
+// Applies the render state overrides needed for the draw flags, states already overridden by the last draw are left as they are
+void m_IDirect3DDeviceX::UpdateDrawStateOverrides(DWORD Overrides)
+{
+	if (Overrides == DrawStates.rsOverrides)
+	{
+		return;
+	}
+
+	SetDrawStateOverride(D3DRENDERSTATE_CLIPPING, DrawOverrideClipping, DrawStates.rsClipping, (Overrides & DrawOverrideClipping) != 0);
+	SetDrawStateOverride(D3DRENDERSTATE_LIGHTING, DrawOverrideLighting, DrawStates.rsLighting, (Overrides & DrawOverrideLighting) != 0);
+	SetDrawStateOverride(D3DRENDERSTATE_EXTENTS, DrawOverrideExtents, DrawStates.rsExtents, (Overrides & DrawOverrideExtents) != 0);
+}
+
+// Returns the saved application value if the render state is currently overridden by the draw flags
+DWORD* m_IDirect3DDeviceX::GetDrawStateOverride(D3DRENDERSTATETYPE dwRenderStateType)
+{
+	switch ((DWORD)dwRenderStateType)
+	{
+	case D3DRENDERSTATE_CLIPPING:
+		return (DrawStates.rsOverrides & DrawOverrideClipping) ? &DrawStates.rsClipping : nullptr;
+	case D3DRENDERSTATE_LIGHTING:
+		return (DrawStates.rsOverrides & DrawOverrideLighting) ? &DrawStates.rsLighting : nullptr;
+	case D3DRENDERSTATE_EXTENTS:
+		return (DrawStates.rsOverrides & DrawOverrideExtents) ? &DrawStates.rsExtents : nullptr;
+	}
+	return nullptr;
+}
+
 inline void m_IDirect3DDeviceX::ScaleVertices(DWORD dwVertexTypeDesc, LPVOID& lpVertices, DWORD dwVertexCount)
 {
 	if (dwVertexTypeDesc == 3)
 	{
 		VertexCache.resize(dwVertexCount * sizeof(D3DTLVERTEX));
-		memcpy(VertexCache.data(), lpVertices, dwVertexCount * sizeof(D3DTLVERTEX));
 		D3DTLVERTEX* pVert = (D3DTLVERTEX*)VertexCache.data();
 
-		for (DWORD x = 0; x < dwVertexCount; x++)
-		{
-			pVert[x].sx = (D3DVALUE)(pVert[x].sx * ScaleDDWidthRatio) + ScaleDDPadX;
-			pVert[x].sy = (D3DVALUE)(pVert[x].sy * ScaleDDHeightRatio) + ScaleDDPadY;
-		}
+		// Copy and scale in one pass
+		ScaleTLVertices(pVert, (D3DTLVERTEX*)lpVertices, dwVertexCount, ScaleDDWidthRatio, ScaleDDHeightRatio, (float)ScaleDDPadX, (float)ScaleDDPadY);
 
 		lpVertices = pVert;
 	}
@@ -4785,3 +5085,262 @@ inline void m_IDirect3DDeviceX::UpdateVertices(DWORD& dwVertexTypeDesc, LPVOID&
 		lpVertices = VertexCache.data();
 	}
 }
+
+// Replays the decoded instructions of an execute buffer on the device
+HRESULT m_IDirect3DDeviceX::ExecuteInstructions(m_IDirect3DExecuteBuffer* pExecuteBuffer, DWORD dwFlags)
+{
+	const EXECUTEINSTRUCTION* lpInstructions = nullptr;
+	const WORD* lpIndices = nullptr;
+	DWORD dwInstructionCount = 0;
+	HRESULT hr = pExecuteBuffer->GetInstructions(lpInstructions, dwInstructionCount, lpIndices);
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
+	const LPBYTE lpData = pExecuteBuffer->GetBufferData();
+	const D3DEXECUTEDATA& ExecuteData = pExecuteBuffer->GetExecuteDataRef();
+	D3DSTATUS Status = ExecuteData.dsStatus;
+
+	const DWORD dwVertexOffset = ExecuteData.dwVertexOffset;
+	const DWORD dwVertexCount = ExecuteData.dwVertexCount;
+	const DWORD dwDrawFlags = (dwFlags & D3DEXECUTE_UNCLIPPED) ? D3DDP_DONOTCLIP : 0;
+
+	for (DWORD x = 0; x < dwInstructionCount; x++)
+	{
+		const EXECUTEINSTRUCTION& Instruction = lpInstructions[x];
+		const BYTE* lpItem = lpData + ExecuteData.dwInstructionOffset + Instruction.dwOffset;
+
+		switch (Instruction.bOpcode)
+		{
+		case D3DOP_POINT:
+		case D3DOP_LINE:
+		case D3DOP_TRIANGLE:
+		{
+			if (Instruction.dwMaxIndex >= ExecuteVertices.size())
+			{
+				LOG_LIMIT(100, __FUNCTION__ << " Error: vertex index out of range: " << Instruction.dwMaxIndex << " vertex count: " << ExecuteVertices.size());
+				break;
+			}
+
+			// Vertex ranges can be processed with different flags, so the draw is split where the vertex type changes
+			const DWORD IndicesPerPrimitive = (Instruction.bOpcode == D3DOP_POINT) ? 1 : (Instruction.bOpcode == D3DOP_LINE) ? 2 : 3;
+			const WORD* lpDrawIndices = lpIndices + Instruction.dwOffset;
+			for (DWORD Start = 0, End; Start < Instruction.dwCount; Start = End)
+			{
+				const DWORD VertexType = ExecuteVertexTypes[lpDrawIndices[Start]];
+				End = Start + IndicesPerPrimitive;
+				while (End < Instruction.dwCount && ExecuteVertexTypes[lpDrawIndices[End]] == VertexType)
+				{
+					End += IndicesPerPrimitive;
+				}
+				End = min(End, Instruction.dwCount);
+
+				DrawIndexedPrimitive(Instruction.dptPrimitiveType, VertexType, ExecuteVertices.data(), Instruction.dwMaxIndex + 1,
+					(LPWORD)(lpDrawIndices + Start), End - Start, dwDrawFlags, 1);
+			}
+			break;
+		}
+
+		case D3DOP_PROCESSVERTICES:
+			for (DWORD i = 0; i < Instruction.dwCount; i++)
+			{
+				const D3DPROCESSVERTICES* lpProcess = (const D3DPROCESSVERTICES*)(lpItem + i * Instruction.dwSize);
+				if (lpProcess->wStart + lpProcess->dwCount > dwVertexCount || lpProcess->dwCount > 0xFFFF)
+				{
+					LOG_LIMIT(100, __FUNCTION__ << " Error: invalid vertex range: " << lpProcess->wStart << " " << lpProcess->dwCount << " vertex count: " << dwVertexCount);
+					continue;
+				}
+
+				// Direct3D9 does the transform and lighting when drawing, so just select the vertex type
+				DWORD VertexType = 0;
+				switch (lpProcess->dwFlags & D3DPROCESSVERTICES_OPMASK)
+				{
+				case D3DPROCESSVERTICES_TRANSFORMLIGHT:
+					VertexType = D3DFVF_VERTEX;
+					break;
+				case D3DPROCESSVERTICES_TRANSFORM:
+					VertexType = D3DFVF_LVERTEX;
+					break;
+				case D3DPROCESSVERTICES_COPY:
+					VertexType = D3DFVF_TLVERTEX;
+					break;
+				default:
+					LOG_LIMIT(100, __FUNCTION__ << " Error: unknown process vertices flags: " << Logging::hex(lpProcess->dwFlags));
+					continue;
+				}
+
+				if (ExecuteVertices.size() < (size_t)lpProcess->wDest + lpProcess->dwCount)
+				{
+					ExecuteVertices.resize(lpProcess->wDest + lpProcess->dwCount);
+					ExecuteVertexTypes.resize(lpProcess->wDest + lpProcess->dwCount, D3DFVF_TLVERTEX);
+				}
+				memcpy(&ExecuteVertices[lpProcess->wDest], lpData + dwVertexOffset + lpProcess->wStart * sizeof(D3DTLVERTEX), lpProcess->dwCount * sizeof(D3DTLVERTEX));
+				std::fill(ExecuteVertexTypes.begin() + lpProcess->wDest, ExecuteVertexTypes.begin() + lpProcess->wDest + lpProcess->dwCount, VertexType);
+			}
+			break;
+
+		case D3DOP_MATRIXLOAD:
+			for (DWORD i = 0; i < Instruction.dwCount; i++)
+			{
+				const D3DMATRIXLOAD* lpLoad = (const D3DMATRIXLOAD*)(lpItem + i * Instruction.dwSize);
+				auto Dest = MatrixHandleMap.find(lpLoad->hDestMatrix);
+				auto Src = MatrixHandleMap.find(lpLoad->hSrcMatrix);
+				if (Dest == MatrixHandleMap.end() || Src == MatrixHandleMap.end())
+				{
+					LOG_LIMIT(100, __FUNCTION__ << " Error: could not find matrix handle: " << lpLoad->hDestMatrix << " " << lpLoad->hSrcMatrix);
+					continue;
+				}
+				Dest->second = Src->second;
+			}
+			break;
+
+		case D3DOP_MATRIXMULTIPLY:
+			for (DWORD i = 0; i < Instruction.dwCount; i++)
+			{
+				const D3DMATRIXMULTIPLY* lpMultiply = (const D3DMATRIXMULTIPLY*)(lpItem + i * Instruction.dwSize);
+				auto Dest = MatrixHandleMap.find(lpMultiply->hDestMatrix);
+				auto Src1 = MatrixHandleMap.find(lpMultiply->hSrcMatrix1);
+				auto Src2 = MatrixHandleMap.find(lpMultiply->hSrcMatrix2);
+				if (Dest == MatrixHandleMap.end() || Src1 == MatrixHandleMap.end() || Src2 == MatrixHandleMap.end())
+				{
+					LOG_LIMIT(100, __FUNCTION__ << " Error: could not find matrix handle: " << lpMultiply->hDestMatrix << " " << lpMultiply->hSrcMatrix1 << " " << lpMultiply->hSrcMatrix2);
+					continue;
+				}
+				D3DMATRIX Matrix;
+				MultiplyMatrix(Matrix, Src1->second, Src2->second);
+				Dest->second = Matrix;
+			}
+			break;
+
+		case D3DOP_STATETRANSFORM:
+			for (DWORD i = 0; i < Instruction.dwCount; i++)
+			{
+				const D3DSTATE* lpState = (const D3DSTATE*)(lpItem + i * Instruction.dwSize);
+				auto it = MatrixHandleMap.find(lpState->dwArg[0]);
+				if (it == MatrixHandleMap.end())
+				{
+					LOG_LIMIT(100, __FUNCTION__ << " Error: could not find matrix handle: " << lpState->dwArg[0]);
+					continue;
+				}
+				SetTransform(lpState->dtstTransformStateType, &it->second);
+			}
+			break;
+
+		case D3DOP_STATELIGHT:
+			for (DWORD i = 0; i < Instruction.dwCount; i++)
+			{
+				const D3DSTATE* lpState = (const D3DSTATE*)(lpItem + i * Instruction.dwSize);
+				SetLightState(lpState->dlstLightStateType, lpState->dwArg[0]);
+			}
+			break;
+
+		case D3DOP_STATERENDER:
+			for (DWORD i = 0; i < Instruction.dwCount; i++)
+			{
+				const D3DSTATE* lpState = (const D3DSTATE*)(lpItem + i * Instruction.dwSize);
+				SetRenderState(lpState->drstRenderStateType, lpState->dwArg[0]);
+			}
+			break;
+
+		case D3DOP_TEXTURELOAD:
+			for (DWORD i = 0; i < Instruction.dwCount; i++)
+			{
+				const D3DTEXTURELOAD* lpLoad = (const D3DTEXTURELOAD*)(lpItem + i * Instruction.dwSize);
+				auto Dest = TextureHandleMap.find(lpLoad->hDestTexture);
+				auto Src = TextureHandleMap.find(lpLoad->hSrcTexture);
+				if (Dest == TextureHandleMap.end() || Src == TextureHandleMap.end() || !Dest->second || !Src->second)
+				{
+					LOG_LIMIT(100, __FUNCTION__ << " Error: could not find texture handle: " << lpLoad->hDestTexture << " " << lpLoad->hSrcTexture);
+					continue;
+				}
+				LPDIRECT3DTEXTURE2 lpSrcTexture = (LPDIRECT3DTEXTURE2)Src->second->GetWrapperInterfaceX(0);
+				if (!lpSrcTexture)
+				{
+					LOG_LIMIT(100, __FUNCTION__ << " Error: could not get texture address!");
+					continue;
+				}
+				Dest->second->Load(lpSrcTexture);
+			}
+			break;
+
+		case D3DOP_BRANCHFORWARD:
+		{
+			const D3DBRANCH* lpBranch = (const D3DBRANCH*)lpItem;
+			if (((Status.dwStatus & lpBranch->dwMask) == lpBranch->dwValue) != (lpBranch->bNegate != FALSE))
+			{
+				// Continue at the target, the loop increment is undone here
+				x = Instruction.dwBranchTarget - 1;
+			}
+			break;
+		}
+
+		case D3DOP_SETSTATUS:
+			for (DWORD i = 0; i < Instruction.dwCount; i++)
+			{
+				const D3DSTATUS* lpStatus = (const D3DSTATUS*)(lpItem + i * Instruction.dwSize);
+				if (lpStatus->dwFlags & D3DSETSTATUS_STATUS)
+				{
+					Status.dwStatus = lpStatus->dwStatus;
+				}
+				if (lpStatus->dwFlags & D3DSETSTATUS_EXTENTS)
+				{
+					Status.drExtent = lpStatus->drExtent;
+				}
+			}
+			break;
+
+		case D3DOP_SPAN:
+			LOG_LIMIT(100, __FUNCTION__ << " Error: 'D3DOP_SPAN' Not Implemented");
+			break;
+
+		case D3DOP_EXIT:
+			x = dwInstructionCount;
+			break;
+		}
+	}
+
+	pExecuteBuffer->SetExecuteStatus(Status);
+
+	return D3D_OK;
+}
+
+// Sets up a Begin/End primitive, the vertex type is a D3DVERTEXTYPE for version 2 and an FVF for version 3
+HRESULT m_IDirect3DDeviceX::StartBeginEnd(D3DPRIMITIVETYPE dptPrimitiveType, DWORD dwVertexTypeDesc, DWORD dwFlags, DWORD DirectXVersion)
+{
+	if (BeginEnd.IsActive)
+	{
+		LOG_LIMIT(100, __FUNCTION__ << " Error: already in Begin!");
+		return D3DERR_INBEGIN;
+	}
+
+	if (dptPrimitiveType < D3DPT_POINTLIST || dptPrimitiveType > D3DPT_TRIANGLEFAN)
+	{
+		LOG_LIMIT(100, __FUNCTION__ << " Error: invalid primitive type: " << dptPrimitiveType);
+		return DDERR_INVALIDPARAMS;
+	}
+
+	DWORD FVF = dwVertexTypeDesc;
+	if (DirectXVersion == 2)
+	{
+		FVF = ConvertVertexTypeToFVF((D3DVERTEXTYPE)dwVertexTypeDesc);
+	}
+
+	// D3DLVERTEX has a reserved dword after its position that the FVF does not include
+	DWORD Stride = (FVF == D3DFVF_LVERTEX) ? sizeof(D3DLVERTEX) : GetVertexStride(FVF);
+	if (!FVF || !Stride)
+	{
+		LOG_LIMIT(100, __FUNCTION__ << " Error: invalid Vertex type: " << Logging::hex(dwVertexTypeDesc));
+		return D3DERR_INVALIDVERTEXTYPE;
+	}
+
+	BeginEnd.PrimitiveType = dptPrimitiveType;
+	BeginEnd.VertexType = dwVertexTypeDesc;
+	BeginEnd.VertexStride = Stride;
+	BeginEnd.Flags = dwFlags;
+	BeginEnd.DirectXVersion = DirectXVersion;
+	BeginEnd.Vertices.clear();
+	BeginEnd.Indices.clear();
+
+	return D3D_OK;
+}
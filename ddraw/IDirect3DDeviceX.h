@@ -45,6 +45,7 @@ private:
 	} backup;
 
 	struct {
+		DWORD rsOverrides = 0;		// Render states forced off by draw flags, these stay set between draws until the flags change
 		DWORD rsClipping = 0;
 		DWORD rsLighting = 0;
 		DWORD rsExtents = 0;
@@ -94,6 +95,7 @@ private:
 	LPDIRECTDRAWSURFACE7 CurrentRenderTarget = nullptr;
 	m_IDirectDrawSurfaceX* CurrentTextureSurfaceX[MaxTextureStages] = {};
 	LPDIRECTDRAWSURFACE7 AttachedTexture[MaxTextureStages] = {};
+	DWORD TextureStageMask = 0;		// One bit for each stage in CurrentTextureSurfaceX that has a texture
 
 	// Texture handle map
 	std::unordered_map<DWORD, m_IDirect3DTextureX*> TextureHandleMap;
@@ -104,9 +106,32 @@ private:
 	// Light index map
 	std::unordered_map<DWORD, m_IDirect3DLight*> LightIndexMap;
 
+	// Matrix handle map
+	std::unordered_map<D3DMATRIXHANDLE, D3DMATRIX> MatrixHandleMap;
+	D3DMATRIXHANDLE LastMatrixHandle = 0;
+
+	// Processed execute buffer vertices, all execute buffer vertex types are 32 bytes
+	std::vector<D3DTLVERTEX> ExecuteVertices;
+	std::vector<DWORD> ExecuteVertexTypes;		// Vertex type of each processed vertex
+
 	// Vector temporary buffer cache
 	std::vector<BYTE> VertexCache;
 
+	// Begin/End immediate mode primitive, vertex and index storage is kept between primitives
+	struct {
+		bool IsActive = false;
+		bool IsIndexed = false;
+		D3DPRIMITIVETYPE PrimitiveType = D3DPT_TRIANGLELIST;
+		DWORD VertexType = 0;
+		DWORD VertexStride = 0;
+		DWORD Flags = 0;
+		DWORD DirectXVersion = 0;
+		LPVOID lpIndexedVertices = nullptr;
+		DWORD IndexedVertexCount = 0;
+		std::vector<BYTE> Vertices;
+		std::vector<WORD> Indices;
+	} BeginEnd;
+
 	// Viewport array
 	std::vector<LPDIRECT3DVIEWPORT3> AttachedViewports;
 
@@ -167,8 +192,13 @@ private:
 	void SetDefaults();
 	void SetDrawStates(DWORD dwVertexTypeDesc, DWORD& dwFlags, DWORD DirectXVersion);
 	void RestoreDrawStates(DWORD dwVertexTypeDesc, DWORD dwFlags, DWORD DirectXVersion);
+	void SetDrawStateOverride(D3DRENDERSTATETYPE dwRenderStateType, DWORD OverrideFlag, DWORD& SavedState, bool Enable);
+	void UpdateDrawStateOverrides(DWORD Overrides);
+	DWORD* GetDrawStateOverride(D3DRENDERSTATETYPE dwRenderStateType);
 	void ScaleVertices(DWORD dwVertexTypeDesc, LPVOID& lpVertices, DWORD dwVertexCount);
 	void UpdateVertices(DWORD& dwVertexTypeDesc, LPVOID& lpVertices, DWORD dwVertexCount);
+	HRESULT ExecuteInstructions(m_IDirect3DExecuteBuffer* pExecuteBuffer, DWORD dwFlags);
+	HRESULT StartBeginEnd(D3DPRIMITIVETYPE dptPrimitiveType, DWORD dwVertexTypeDesc, DWORD dwFlags, DWORD DirectXVersion);
 
 	// Interface initialization functions
 	void InitInterface(DWORD DirectXVersion);
@@ -246,8 +276,8 @@ public:
 	STDMETHOD(GetCurrentViewport)(THIS_ LPDIRECT3DVIEWPORT3 *, DWORD);
 	STDMETHOD(SetViewport)(THIS_ LPD3DVIEWPORT7);
 	STDMETHOD(GetViewport)(THIS_ LPD3DVIEWPORT7);
-	STDMETHOD(Begin)(THIS_ D3DPRIMITIVETYPE, DWORD, DWORD);
-	STDMETHOD(BeginIndexed)(THIS_ D3DPRIMITIVETYPE, DWORD, LPVOID, DWORD, DWORD);
+	STDMETHOD(Begin)(THIS_ D3DPRIMITIVETYPE, DWORD, DWORD, DWORD);
+	STDMETHOD(BeginIndexed)(THIS_ D3DPRIMITIVETYPE, DWORD, LPVOID, DWORD, DWORD, DWORD);
 	STDMETHOD(Vertex)(THIS_ LPVOID);
 	STDMETHOD(Index)(THIS_ WORD);
 	STDMETHOD(End)(THIS_ DWORD);
@@ -314,6 +344,9 @@ public:
 	// Light index function
 	void ReleaseLightInterface(m_IDirect3DLight* lpLight);
 
+	// Draw flag overrides are left set between draws, end them before the device states are used outside of a draw
+	inline void EndDrawStateOverrides() { UpdateDrawStateOverrides(0); }
+
 	// Functions handling the ddraw parent interface
 	void ClearSurface(m_IDirectDrawSurfaceX* lpSurfaceX)
 	{
@@ -329,6 +362,7 @@ public:
 				SetTexture(x, (LPDIRECTDRAWSURFACE7)nullptr);
 				AttachedTexture[x] = nullptr;
 				CurrentTextureSurfaceX[x] = nullptr;
+				TextureStageMask &= ~(1UL << x);
 			}
 		}
 	}
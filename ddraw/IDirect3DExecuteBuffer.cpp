@@ -14,6 +14,7 @@
 *   3. This notice may not be removed or altered from any source distribution.
 */
 
+#include <algorithm>
 #include "ddraw.h"
 
 // Cached wrapper interface
@@ -367,6 +368,12 @@ void m_IDirect3DExecuteBuffer::InitInterface(LPD3DEXECUTEBUFFERDESC lpDesc)
 	Desc = {};
 	Desc.dwSize = sizeof(D3DEXECUTEBUFFERDESC);
 	MemoryData.clear();
+	InstructionCache.clear();
+	IndexCache.clear();
+	IsInstructionCacheValid = false;
+	InstructionHash = 0;
+	InstructionOffset = 0;
+	InstructionLength = 0;
 
 	if (lpDesc)
 	{
@@ -394,3 +401,264 @@ void m_IDirect3DExecuteBuffer::ReleaseInterface()
 		D3DDeviceInterface->ReleaseExecuteBuffer(this);
 	}
 }
+
+// FNV-1a hash of the instruction region, used to check if the cached instructions are still current
+ULONGLONG m_IDirect3DExecuteBuffer::HashInstructions(const BYTE* lpData, DWORD dwLength)
+{
+	constexpr ULONGLONG FNVPrime = 0x100000001B3ULL;
+	ULONGLONG Hash = 0xCBF29CE484222325ULL;
+
+	DWORD x = 0;
+	for (; x + sizeof(DWORD) <= dwLength; x += sizeof(DWORD))
+	{
+		Hash = (Hash ^ *(const DWORD*)(lpData + x)) * FNVPrime;
+	}
+	for (; x < dwLength; x++)
+	{
+		Hash = (Hash ^ lpData[x]) * FNVPrime;
+	}
+	return Hash;
+}
+
+// Decodes the instruction region into the instruction and index caches
+bool m_IDirect3DExecuteBuffer::DecodeInstructions(const BYTE* lpData, DWORD dwLength)
+{
+	InstructionCache.clear();
+	IndexCache.clear();
+
+	// Find branch targets first so primitives are not batched across them
+	std::vector<DWORD> BranchTargets;
+	DWORD LastBranchTarget = 0;
+	for (DWORD Offset = 0; Offset + sizeof(D3DINSTRUCTION) <= dwLength; )
+	{
+		const D3DINSTRUCTION* lpInstruction = (const D3DINSTRUCTION*)(lpData + Offset);
+		const DWORD ItemOffset = Offset + sizeof(D3DINSTRUCTION);
+
+		// Data after the exit is not decoded unless a branch jumps past it, the instruction length often covers the whole buffer
+		if (lpInstruction->bOpcode == D3DOP_EXIT && Offset >= LastBranchTarget)
+		{
+			break;
+		}
+
+		const DWORD DataSize = lpInstruction->bSize * lpInstruction->wCount;
+		if (DataSize > dwLength - ItemOffset)
+		{
+			LOG_LIMIT(100, __FUNCTION__ << " Error: instruction data exceeds instruction length: " << (DWORD)lpInstruction->bOpcode << " " << Offset);
+			return false;
+		}
+		if (lpInstruction->bOpcode == D3DOP_BRANCHFORWARD && lpInstruction->bSize >= sizeof(D3DBRANCH))
+		{
+			for (DWORD i = 0; i < lpInstruction->wCount; i++)
+			{
+				const D3DBRANCH* lpBranch = (const D3DBRANCH*)(lpData + ItemOffset + i * lpInstruction->bSize);
+				if (lpBranch->dwOffset && lpBranch->dwOffset < dwLength - Offset)
+				{
+					BranchTargets.push_back(Offset + lpBranch->dwOffset);
+					LastBranchTarget = max(LastBranchTarget, Offset + lpBranch->dwOffset);
+				}
+			}
+		}
+		Offset = ItemOffset + DataSize;
+	}
+	std::sort(BranchTargets.begin(), BranchTargets.end());
+
+	// Instruction offset and the index of its first decoded entry, used to resolve branch targets
+	std::vector<std::pair<DWORD, DWORD>> InstructionStart;
+	std::vector<std::pair<DWORD, DWORD>> Branches;
+
+	for (DWORD Offset = 0; Offset + sizeof(D3DINSTRUCTION) <= dwLength; )
+	{
+		const D3DINSTRUCTION* lpInstruction = (const D3DINSTRUCTION*)(lpData + Offset);
+		const BYTE bOpcode = lpInstruction->bOpcode;
+		const DWORD dwSize = lpInstruction->bSize;
+		const DWORD dwCount = lpInstruction->wCount;
+		const DWORD ItemOffset = Offset + sizeof(D3DINSTRUCTION);
+		const BYTE* lpItem = lpData + ItemOffset;
+
+		InstructionStart.push_back({ Offset, (DWORD)InstructionCache.size() });
+
+		// Minimum size of each item
+		DWORD RequiredSize = 0;
+		D3DPRIMITIVETYPE PrimitiveType = D3DPT_TRIANGLELIST;
+		switch (bOpcode)
+		{
+		case D3DOP_POINT: RequiredSize = sizeof(D3DPOINT); PrimitiveType = D3DPT_POINTLIST; break;
+		case D3DOP_LINE: RequiredSize = sizeof(D3DLINE); PrimitiveType = D3DPT_LINELIST; break;
+		case D3DOP_TRIANGLE: RequiredSize = sizeof(D3DTRIANGLE); PrimitiveType = D3DPT_TRIANGLELIST; break;
+		case D3DOP_MATRIXLOAD: RequiredSize = sizeof(D3DMATRIXLOAD); break;
+		case D3DOP_MATRIXMULTIPLY: RequiredSize = sizeof(D3DMATRIXMULTIPLY); break;
+		case D3DOP_STATETRANSFORM:
+		case D3DOP_STATELIGHT:
+		case D3DOP_STATERENDER: RequiredSize = sizeof(D3DSTATE); break;
+		case D3DOP_PROCESSVERTICES: RequiredSize = sizeof(D3DPROCESSVERTICES); break;
+		case D3DOP_TEXTURELOAD: RequiredSize = sizeof(D3DTEXTURELOAD); break;
+		case D3DOP_BRANCHFORWARD: RequiredSize = sizeof(D3DBRANCH); break;
+		case D3DOP_SETSTATUS: RequiredSize = sizeof(D3DSTATUS); break;
+		case D3DOP_SPAN: RequiredSize = sizeof(D3DSPAN); break;
+		case D3DOP_EXIT: break;
+		default:
+			LOG_LIMIT(100, __FUNCTION__ << " Error: unknown opcode: " << (DWORD)bOpcode);
+			return false;
+		}
+		if (dwCount && dwSize < RequiredSize)
+		{
+			LOG_LIMIT(100, __FUNCTION__ << " Error: invalid item size: " << dwSize << " for opcode: " << (DWORD)bOpcode);
+			return false;
+		}
+
+		switch (bOpcode)
+		{
+		case D3DOP_POINT:
+		case D3DOP_LINE:
+		case D3DOP_TRIANGLE:
+		{
+			if (!dwCount)
+			{
+				break;
+			}
+
+			// Append to the previous draw unless it is a different type or this instruction is a branch target
+			if (InstructionCache.empty() || InstructionCache.back().bOpcode != bOpcode ||
+				std::binary_search(BranchTargets.begin(), BranchTargets.end(), Offset))
+			{
+				EXECUTEINSTRUCTION Draw;
+				Draw.bOpcode = bOpcode;
+				Draw.dptPrimitiveType = PrimitiveType;
+				Draw.dwOffset = IndexCache.size();
+				InstructionCache.push_back(Draw);
+			}
+			EXECUTEINSTRUCTION& Draw = InstructionCache.back();
+
+			for (DWORD i = 0; i < dwCount; i++, lpItem += dwSize)
+			{
+				if (bOpcode == D3DOP_POINT)
+				{
+					const D3DPOINT* lpPoint = (const D3DPOINT*)lpItem;
+					for (DWORD v = lpPoint->wFirst; v < (DWORD)lpPoint->wFirst + lpPoint->wCount && v <= 0xFFFF; v++)
+					{
+						IndexCache.push_back((WORD)v);
+						Draw.dwMaxIndex = max(Draw.dwMaxIndex, v);
+					}
+				}
+				else if (bOpcode == D3DOP_LINE)
+				{
+					const D3DLINE* lpLine = (const D3DLINE*)lpItem;
+					IndexCache.push_back(lpLine->v1);
+					IndexCache.push_back(lpLine->v2);
+					Draw.dwMaxIndex = max(Draw.dwMaxIndex, (DWORD)max(lpLine->v1, lpLine->v2));
+				}
+				else
+				{
+					const D3DTRIANGLE* lpTriangle = (const D3DTRIANGLE*)lpItem;
+					IndexCache.push_back(lpTriangle->v1);
+					IndexCache.push_back(lpTriangle->v2);
+					IndexCache.push_back(lpTriangle->v3);
+					Draw.dwMaxIndex = max(Draw.dwMaxIndex, (DWORD)max(lpTriangle->v1, max(lpTriangle->v2, lpTriangle->v3)));
+				}
+			}
+			Draw.dwCount = IndexCache.size() - Draw.dwOffset;
+			break;
+		}
+		case D3DOP_BRANCHFORWARD:
+			// Each branch gets its own entry so it can jump to its own target
+			for (DWORD i = 0; i < dwCount; i++)
+			{
+				const D3DBRANCH* lpBranch = (const D3DBRANCH*)(lpItem + i * dwSize);
+				Branches.push_back({ (DWORD)InstructionCache.size(), lpBranch->dwOffset ? Offset + lpBranch->dwOffset : 0 });
+
+				EXECUTEINSTRUCTION Branch;
+				Branch.bOpcode = bOpcode;
+				Branch.dwOffset = ItemOffset + i * dwSize;
+				Branch.dwCount = 1;
+				Branch.dwSize = dwSize;
+				InstructionCache.push_back(Branch);
+			}
+			break;
+		default:
+			if (dwCount || bOpcode == D3DOP_EXIT)
+			{
+				EXECUTEINSTRUCTION Instruction;
+				Instruction.bOpcode = bOpcode;
+				Instruction.dwOffset = ItemOffset;
+				Instruction.dwCount = dwCount;
+				Instruction.dwSize = dwSize;
+				InstructionCache.push_back(Instruction);
+			}
+			break;
+		}
+
+		// Stop at the same exit as the branch target pass
+		if (bOpcode == D3DOP_EXIT && (BranchTargets.empty() || Offset >= BranchTargets.back()))
+		{
+			break;
+		}
+
+		Offset = ItemOffset + dwSize * dwCount;
+	}
+
+	// Resolve branch targets to decoded entries, branches with no target or past the end exit the buffer
+	for (auto& Branch : Branches)
+	{
+		DWORD Target = InstructionCache.size();
+		if (Branch.second)
+		{
+			auto it = std::lower_bound(InstructionStart.begin(), InstructionStart.end(), std::make_pair(Branch.second, (DWORD)0));
+			if (it != InstructionStart.end() && it->first == Branch.second)
+			{
+				Target = it->second;
+			}
+			else if (it != InstructionStart.end())
+			{
+				LOG_LIMIT(100, __FUNCTION__ << " Warning: branch target is not at an instruction: " << Branch.second);
+			}
+		}
+		InstructionCache[Branch.first].dwBranchTarget = Target;
+	}
+
+	return true;
+}
+
+// Returns the decoded instructions, the buffer is only decoded again if its instructions have changed
+HRESULT m_IDirect3DExecuteBuffer::GetInstructions(const EXECUTEINSTRUCTION*& lpInstructions, DWORD& dwInstructionCount, const WORD*& lpIndices)
+{
+	if (IsLocked)
+	{
+		LOG_LIMIT(100, __FUNCTION__ << " Error: Buffer is locked!");
+		return D3DERR_EXECUTE_LOCKED;
+	}
+
+	const DWORD dwOffset = ExecuteData.dwInstructionOffset;
+	const DWORD dwLength = ExecuteData.dwInstructionLength;
+	if (!Desc.lpData || dwOffset > Desc.dwBufferSize || dwLength > Desc.dwBufferSize - dwOffset)
+	{
+		LOG_LIMIT(100, __FUNCTION__ << " Error: invalid instruction data: " << dwOffset << " " << dwLength << " buffer size: " << Desc.dwBufferSize);
+		return DDERR_INVALIDPARAMS;
+	}
+	if (ExecuteData.dwVertexOffset > Desc.dwBufferSize || ExecuteData.dwVertexCount > (Desc.dwBufferSize - ExecuteData.dwVertexOffset) / sizeof(D3DVERTEX))
+	{
+		LOG_LIMIT(100, __FUNCTION__ << " Error: invalid vertex data: " << ExecuteData.dwVertexOffset << " " << ExecuteData.dwVertexCount << " buffer size: " << Desc.dwBufferSize);
+		return DDERR_INVALIDPARAMS;
+	}
+
+	const BYTE* lpData = (const BYTE*)Desc.lpData + dwOffset;
+	const ULONGLONG Hash = HashInstructions(lpData, dwLength);
+	if (!IsInstructionCacheValid || Hash != InstructionHash || dwOffset != InstructionOffset || dwLength != InstructionLength)
+	{
+		InstructionHash = Hash;
+		InstructionOffset = dwOffset;
+		InstructionLength = dwLength;
+		IsInstructionCacheValid = DecodeInstructions(lpData, dwLength);
+		if (!IsInstructionCacheValid)
+		{
+			InstructionCache.clear();
+			IndexCache.clear();
+			return DDERR_INVALIDPARAMS;
+		}
+	}
+
+	lpInstructions = InstructionCache.data();
+	dwInstructionCount = InstructionCache.size();
+	lpIndices = IndexCache.data();
+
+	return D3D_OK;
+}
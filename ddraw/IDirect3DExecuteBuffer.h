@@ -1,5 +1,17 @@
 #pragma once
 
+// Decoded execute buffer instruction, consecutive point, line and triangle instructions are batched into one indexed draw
+struct EXECUTEINSTRUCTION
+{
+	BYTE bOpcode = 0;				// D3DOPCODE of the instruction
+	D3DPRIMITIVETYPE dptPrimitiveType = D3DPT_TRIANGLELIST;	// Primitive type of batched draws
+	DWORD dwOffset = 0;				// Buffer offset of the first item, or the first index of batched draws
+	DWORD dwCount = 0;				// Number of items, or number of indices of batched draws
+	DWORD dwSize = 0;				// Size of each item
+	DWORD dwMaxIndex = 0;			// Highest vertex index used by batched draws
+	DWORD dwBranchTarget = 0;		// Instruction to continue at when a D3DOP_BRANCHFORWARD is taken
+};
+
 m_IDirect3DExecuteBuffer* CreateDirect3DExecuteBuffer(IDirect3DExecuteBuffer* aOriginal, m_IDirect3DDeviceX* NewD3DDInterface, LPD3DEXECUTEBUFFERDESC lpDesc);
 
 class m_IDirect3DExecuteBuffer : public IDirect3DExecuteBuffer, public AddressLookupTableDdrawObject
@@ -16,6 +28,18 @@ private:
 	bool IsLocked = false;
 	D3DEXECUTEDATA ExecuteData = {};
 
+	// Decoded instruction cache, only rebuilt when the instruction region changes
+	std::vector<EXECUTEINSTRUCTION> InstructionCache;
+	std::vector<WORD> IndexCache;
+	bool IsInstructionCacheValid = false;
+	ULONGLONG InstructionHash = 0;
+	DWORD InstructionOffset = 0;
+	DWORD InstructionLength = 0;
+
+	// Helper functions
+	ULONGLONG HashInstructions(const BYTE* lpData, DWORD dwLength);
+	bool DecodeInstructions(const BYTE* lpData, DWORD dwLength);
+
 	// Interface initialization functions
 	void InitInterface(LPD3DEXECUTEBUFFERDESC lpDesc);
 	void ReleaseInterface();
@@ -76,4 +100,10 @@ public:
 	STDMETHOD(GetExecuteData)(THIS_ LPD3DEXECUTEDATA);
 	STDMETHOD(Validate)(THIS_ LPDWORD, LPD3DVALIDATECALLBACK, LPVOID, DWORD);
 	STDMETHOD(Optimize)(THIS_ DWORD);
+
+	// Helper functions
+	HRESULT GetInstructions(const EXECUTEINSTRUCTION*& lpInstructions, DWORD& dwInstructionCount, const WORD*& lpIndices);
+	LPBYTE GetBufferData() const { return (LPBYTE)Desc.lpData; }
+	const D3DEXECUTEDATA& GetExecuteDataRef() const { return ExecuteData; }
+	void SetExecuteStatus(const D3DSTATUS& Status) { ExecuteData.dsStatus = Status; }
 };
@@ -0,0 +1,578 @@
+/**
+* Copyright (C) 2024 Elisha Riedlinger
+*
+* This software is  provided 'as-is', without any express  or implied  warranty. In no event will the
+* authors be held liable for any damages arising from the use of this software.
+* Permission  is granted  to anyone  to use  this software  for  any  purpose,  including  commercial
+* applications, and to alter it and redistribute it freely, subject to the following restrictions:
+*
+*   1. The origin of this software must not be misrepresented; you must not claim that you  wrote the
+*      original  software. If you use this  software  in a product, an  acknowledgment in the product
+*      documentation would be appreciated but is not required.
+*   2. Altered source versions must  be plainly  marked as such, and  must not be  misrepresented  as
+*      being the original software.
+*   3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include <emmintrin.h>
+#include <math.h>
+#include <float.h>
+#include <vector>
+#include "ddraw.h"
+#include "Utils\Utils.h"
+
+namespace
+{
+	// Plane index matches the D3DCLIP bit order: left, right, top, bottom, front, back
+	constexpr DWORD FrustumPlaneCount = 6;
+
+	// D3DSTATUS_CLIPINTERSECTION bits are the D3DSTATUS_CLIPUNION bits shifted by this amount
+	constexpr DWORD ClipIntersectionShift = 12;
+
+	// All clip flags set by TransformScreenVertices
+	constexpr DWORD ScreenClipFlags = D3DCLIP_LEFT | D3DCLIP_RIGHT | D3DCLIP_TOP | D3DCLIP_BOTTOM | D3DCLIP_FRONT | D3DCLIP_BACK;
+
+	// Screen extents of the visible transformed vertices
+	struct SCREENEXTENT
+	{
+		float Left = FLT_MAX;
+		float Top = FLT_MAX;
+		float Right = -FLT_MAX;
+		float Bottom = -FLT_MAX;
+	};
+
+	// Light with its values prepared for LightVertices
+	struct LIGHTPARAMS
+	{
+		bool IsDirectional = false;
+		bool HasSpecular = false;
+		float r = 0.0f, g = 0.0f, b = 0.0f;
+		float x = 0.0f, y = 0.0f, z = 0.0f;		// Direction towards the light or light position
+		float Range2 = 0.0f;
+		float Attenuation0 = 0.0f, Attenuation1 = 0.0f, Attenuation2 = 0.0f;
+	};
+
+	// Function declarations
+	void CheckSphereVisibilityScalar(const D3DFRUSTUM& Frustum, const D3DVECTOR* lpCenters, const D3DVALUE* lpRadii, DWORD dwNumSpheres, LPDWORD lpdwReturnValues);
+	DWORD CheckSphereVisibilitySSE(const D3DFRUSTUM& Frustum, const D3DVECTOR* lpCenters, const D3DVALUE* lpRadii, DWORD dwNumSpheres, LPDWORD lpdwReturnValues);
+	void StoreScreenVertex(D3DTRANSFORMDATA& Data, DWORD Index, float sx, float sy, float sz, float rhw, float hx, float hy, float hz, DWORD ClipFlags, bool Clip, SCREENEXTENT& Extent);
+	void TransformScreenVerticesScalar(const D3DSCREENTRANSFORM& Transform, D3DTRANSFORMDATA& Data, DWORD Start, DWORD dwVertexCount, bool Clip, DWORD& ClipUnion, DWORD& ClipIntersection, SCREENEXTENT& Extent);
+	DWORD TransformScreenVerticesSSE(const D3DSCREENTRANSFORM& Transform, D3DTRANSFORMDATA& Data, DWORD dwVertexCount, bool Clip, DWORD& ClipUnion, DWORD& ClipIntersection, SCREENEXTENT& Extent);
+	LONG ExtentToLong(float Value);
+	DWORD ColorToByte(float Value);
+}
+
+// Multiplies two matrices, Out may not alias either input
+void MultiplyMatrix(D3DMATRIX& Out, const D3DMATRIX& a, const D3DMATRIX& b)
+{
+	for (int i = 0; i < 4; i++)
+	{
+		for (int j = 0; j < 4; j++)
+		{
+			Out.m[i][j] = a.m[i][0] * b.m[0][j] + a.m[i][1] * b.m[1][j] + a.m[i][2] * b.m[2][j] + a.m[i][3] * b.m[3][j];
+		}
+	}
+}
+
+// Extracts the six clipping planes from a combined world, view and projection matrix, the planes are in model space
+// with normals pointing into the frustum. Returns false if the matrix is degenerate.
+bool ComputeFrustumPlanes(D3DFRUSTUM& Frustum, const D3DMATRIX& Matrix)
+{
+	// Direct3D uses row vectors so each clip space coordinate is a column of the matrix.
+	// A point is inside when -w <= x <= w, -w <= y <= w and 0 <= z <= w.
+	for (int i = 0; i < 4; i++)
+	{
+		const float x = Matrix.m[i][0], y = Matrix.m[i][1], z = Matrix.m[i][2], w = Matrix.m[i][3];
+		Frustum.Plane[0][i] = w + x;	// Left
+		Frustum.Plane[1][i] = w - x;	// Right
+		Frustum.Plane[2][i] = w - y;	// Top
+		Frustum.Plane[3][i] = w + y;	// Bottom
+		Frustum.Plane[4][i] = z;		// Front
+		Frustum.Plane[5][i] = w - z;	// Back
+	}
+
+	// Normalize so that the plane equation returns a distance that can be compared with the radius
+	for (DWORD x = 0; x < FrustumPlaneCount; x++)
+	{
+		float* Plane = Frustum.Plane[x];
+		float Length = sqrtf(Plane[0] * Plane[0] + Plane[1] * Plane[1] + Plane[2] * Plane[2]);
+		if (Length == 0.0f || !isfinite(Length))
+		{
+			return false;
+		}
+		float InvLength = 1.0f / Length;
+		for (int i = 0; i < 4; i++)
+		{
+			Plane[i] *= InvLength;
+		}
+	}
+
+	return true;
+}
+
+namespace
+{
+	// Reference version, also used for the spheres left over after the SIMD loop
+	void CheckSphereVisibilityScalar(const D3DFRUSTUM& Frustum, const D3DVECTOR* lpCenters, const D3DVALUE* lpRadii, DWORD dwNumSpheres, LPDWORD lpdwReturnValues)
+	{
+		for (DWORD s = 0; s < dwNumSpheres; s++)
+		{
+			const D3DVECTOR& Center = lpCenters[s];
+			const float Radius = lpRadii[s];
+
+			DWORD Result = 0;
+			for (DWORD x = 0; x < FrustumPlaneCount; x++)
+			{
+				const float* Plane = Frustum.Plane[x];
+				float Distance = Plane[0] * Center.x + Plane[1] * Center.y + Plane[2] * Center.z + Plane[3];
+
+				// Sphere crosses or is outside of this plane
+				if (Distance < Radius)
+				{
+					Result |= (D3DCLIP_LEFT << x);
+				}
+				// Sphere is completely outside of this plane
+				if (Distance < -Radius)
+				{
+					Result |= (D3DSTATUS_CLIPINTERSECTIONLEFT << x);
+				}
+			}
+			lpdwReturnValues[s] = Result;
+		}
+	}
+
+	// Tests four spheres at a time, returns the number of spheres processed
+	DWORD CheckSphereVisibilitySSE(const D3DFRUSTUM& Frustum, const D3DVECTOR* lpCenters, const D3DVALUE* lpRadii, DWORD dwNumSpheres, LPDWORD lpdwReturnValues)
+	{
+		__m128 PlaneX[FrustumPlaneCount], PlaneY[FrustumPlaneCount], PlaneZ[FrustumPlaneCount], PlaneW[FrustumPlaneCount];
+		for (DWORD x = 0; x < FrustumPlaneCount; x++)
+		{
+			PlaneX[x] = _mm_set1_ps(Frustum.Plane[x][0]);
+			PlaneY[x] = _mm_set1_ps(Frustum.Plane[x][1]);
+			PlaneZ[x] = _mm_set1_ps(Frustum.Plane[x][2]);
+			PlaneW[x] = _mm_set1_ps(Frustum.Plane[x][3]);
+		}
+		const __m128 SignMask = _mm_set1_ps(-0.0f);
+
+		DWORD s = 0;
+		for (; s + 4 <= dwNumSpheres; s += 4)
+		{
+			// Load four packed x, y, z centers and transpose them into separate x, y and z vectors
+			const float* c = &lpCenters[s].x;
+			__m128 v0 = _mm_loadu_ps(c);		// x0 y0 z0 x1
+			__m128 v1 = _mm_loadu_ps(c + 4);	// y1 z1 x2 y2
+			__m128 v2 = _mm_loadu_ps(c + 8);	// z2 x3 y3 z3
+			__m128 t0 = _mm_shuffle_ps(v1, v2, _MM_SHUFFLE(1, 0, 3, 2));	// x2 y2 z2 x3
+			__m128 cx = _mm_shuffle_ps(v0, t0, _MM_SHUFFLE(3, 0, 3, 0));
+			__m128 t1 = _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(0, 0, 2, 1));	// y0 z0 y1 y1
+			__m128 t2 = _mm_shuffle_ps(v1, v2, _MM_SHUFFLE(2, 2, 3, 3));	// y2 y2 y3 y3
+			__m128 cy = _mm_shuffle_ps(t1, t2, _MM_SHUFFLE(2, 0, 2, 0));
+			__m128 t3 = _mm_shuffle_ps(v0, v1, _MM_SHUFFLE(1, 1, 2, 2));	// z0 z0 z1 z1
+			__m128 t4 = _mm_shuffle_ps(v2, v2, _MM_SHUFFLE(3, 3, 0, 0));	// z2 z2 z3 z3
+			__m128 cz = _mm_shuffle_ps(t3, t4, _MM_SHUFFLE(2, 0, 2, 0));
+
+			__m128 Radius = _mm_loadu_ps(&lpRadii[s]);
+			__m128 NegRadius = _mm_xor_ps(Radius, SignMask);
+
+			DWORD Result[4] = {};
+			for (DWORD x = 0; x < FrustumPlaneCount; x++)
+			{
+				__m128 Distance = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(PlaneX[x], cx), _mm_mul_ps(PlaneY[x], cy)),
+					_mm_add_ps(_mm_mul_ps(PlaneZ[x], cz), PlaneW[x]));
+
+				DWORD UnionMask = (DWORD)_mm_movemask_ps(_mm_cmplt_ps(Distance, Radius));
+				DWORD IntersectionMask = (DWORD)_mm_movemask_ps(_mm_cmplt_ps(Distance, NegRadius));
+				if (UnionMask)
+				{
+					for (DWORD i = 0; i < 4; i++)
+					{
+						Result[i] |= (((UnionMask >> i) & 1) | (((IntersectionMask >> i) & 1) << ClipIntersectionShift)) << x;
+					}
+				}
+			}
+
+			lpdwReturnValues[s] = Result[0];
+			lpdwReturnValues[s + 1] = Result[1];
+			lpdwReturnValues[s + 2] = Result[2];
+			lpdwReturnValues[s + 3] = Result[3];
+		}
+		return s;
+	}
+}
+
+// Computes the D3DCLIP union and D3DSTATUS_CLIPINTERSECTION bits for each sphere against the frustum
+void CheckSphereVisibility(const D3DFRUSTUM& Frustum, const D3DVECTOR* lpCenters, const D3DVALUE* lpRadii, DWORD dwNumSpheres, LPDWORD lpdwReturnValues)
+{
+	DWORD Done = 0;
+	if (Utils::IsSSE2Supported())
+	{
+		Done = CheckSphereVisibilitySSE(Frustum, lpCenters, lpRadii, dwNumSpheres, lpdwReturnValues);
+	}
+	if (Done < dwNumSpheres)
+	{
+		CheckSphereVisibilityScalar(Frustum, lpCenters + Done, lpRadii + Done, dwNumSpheres - Done, lpdwReturnValues + Done);
+	}
+}
+
+// Copies transformed vertices and scales their screen coordinates in a single pass
+void ScaleTLVertices(D3DTLVERTEX* pDest, const D3DTLVERTEX* pSrc, DWORD dwVertexCount, float ScaleX, float ScaleY, float PadX, float PadY)
+{
+	DWORD x = 0;
+	if (Utils::IsSSE2Supported())
+	{
+		// Scale sx and sy, sz and rhw are masked back in so their bits are kept exactly
+		const __m128 Scale = _mm_setr_ps(ScaleX, ScaleY, 1.0f, 1.0f);
+		const __m128 Pad = _mm_setr_ps(PadX, PadY, 0.0f, 0.0f);
+		const __m128 Mask = _mm_castsi128_ps(_mm_setr_epi32(-1, -1, 0, 0));
+		for (; x < dwVertexCount; x++)
+		{
+			__m128 Position = _mm_loadu_ps(&pSrc[x].sx);
+			__m128 Color = _mm_loadu_ps((const float*)&pSrc[x].color);
+			__m128 Scaled = _mm_add_ps(_mm_mul_ps(Position, Scale), Pad);
+			_mm_storeu_ps(&pDest[x].sx, _mm_or_ps(_mm_and_ps(Mask, Scaled), _mm_andnot_ps(Mask, Position)));
+			_mm_storeu_ps((float*)&pDest[x].color, Color);
+		}
+	}
+	for (; x < dwVertexCount; x++)
+	{
+		pDest[x] = pSrc[x];
+		pDest[x].sx = (D3DVALUE)(pSrc[x].sx * ScaleX) + PadX;
+		pDest[x].sy = (D3DVALUE)(pSrc[x].sy * ScaleY) + PadY;
+	}
+}
+
+namespace
+{
+	// Writes a transformed vertex and updates the extents, clipped vertices only get their homogeneous coordinates
+	inline void StoreScreenVertex(D3DTRANSFORMDATA& Data, DWORD Index, float sx, float sy, float sz, float rhw, float hx, float hy, float hz, DWORD ClipFlags, bool Clip, SCREENEXTENT& Extent)
+	{
+		if (Clip && Data.lpHOut)
+		{
+			D3DHVERTEX& HVertex = Data.lpHOut[Index];
+			HVertex.dwFlags = ClipFlags;
+			HVertex.hx = hx;
+			HVertex.hy = hy;
+			HVertex.hz = hz;
+		}
+		if (!ClipFlags)
+		{
+			// Only the position is written, the rest of the output vertex is left to the application
+			float* Out = (float*)((BYTE*)Data.lpOut + Index * Data.dwOutSize);
+			Out[0] = sx;
+			Out[1] = sy;
+			Out[2] = sz;
+			Out[3] = rhw;
+
+			Extent.Left = min(Extent.Left, sx);
+			Extent.Right = max(Extent.Right, sx);
+			Extent.Top = min(Extent.Top, sy);
+			Extent.Bottom = max(Extent.Bottom, sy);
+		}
+	}
+
+	// Reference version, also used for the vertices left over after the SIMD loop
+	void TransformScreenVerticesScalar(const D3DSCREENTRANSFORM& Transform, D3DTRANSFORMDATA& Data, DWORD Start, DWORD dwVertexCount, bool Clip, DWORD& ClipUnion, DWORD& ClipIntersection, SCREENEXTENT& Extent)
+	{
+		const D3DMATRIX& m = Transform.Matrix;
+		const float ScaleZ = Transform.MaxZ - Transform.MinZ;
+
+		for (DWORD i = Start; i < dwVertexCount; i++)
+		{
+			const float* In = (const float*)((const BYTE*)Data.lpIn + i * Data.dwInSize);
+			const float x = In[0], y = In[1], z = In[2];
+
+			const float X = (x * m._11 + y * m._21) + (z * m._31 + m._41);
+			const float Y = (x * m._12 + y * m._22) + (z * m._32 + m._42);
+			const float Z = (x * m._13 + y * m._23) + (z * m._33 + m._43);
+			const float W = (x * m._14 + y * m._24) + (z * m._34 + m._44);
+
+			DWORD ClipFlags = 0;
+			if (Clip)
+			{
+				ClipFlags =
+					(X < Transform.ClipMinX * W ? D3DCLIP_LEFT : 0) |
+					(X > Transform.ClipMaxX * W ? D3DCLIP_RIGHT : 0) |
+					(Y > Transform.ClipMaxY * W ? D3DCLIP_TOP : 0) |
+					(Y < Transform.ClipMinY * W ? D3DCLIP_BOTTOM : 0) |
+					(Z < 0.0f ? D3DCLIP_FRONT : 0) |
+					(Z > W ? D3DCLIP_BACK : 0);
+				ClipUnion |= ClipFlags;
+				ClipIntersection &= ClipFlags;
+			}
+
+			const float rhw = 1.0f / W;
+			StoreScreenVertex(Data, i,
+				Transform.OffsetX + (X * rhw) * Transform.ScaleX,
+				Transform.OffsetY - (Y * rhw) * Transform.ScaleY,
+				Transform.MinZ + (Z * rhw) * ScaleZ,
+				rhw, X, Y, Z, ClipFlags, Clip, Extent);
+		}
+	}
+
+	// Transforms four vertices at a time, returns the number of vertices processed
+	DWORD TransformScreenVerticesSSE(const D3DSCREENTRANSFORM& Transform, D3DTRANSFORMDATA& Data, DWORD dwVertexCount, bool Clip, DWORD& ClipUnion, DWORD& ClipIntersection, SCREENEXTENT& Extent)
+	{
+		const D3DMATRIX& m = Transform.Matrix;
+		__m128 Row[4][4];
+		for (int i = 0; i < 4; i++)
+		{
+			for (int j = 0; j < 4; j++)
+			{
+				Row[i][j] = _mm_set1_ps(m.m[i][j]);
+			}
+		}
+		const __m128 ClipMinX = _mm_set1_ps(Transform.ClipMinX);
+		const __m128 ClipMaxX = _mm_set1_ps(Transform.ClipMaxX);
+		const __m128 ClipMinY = _mm_set1_ps(Transform.ClipMinY);
+		const __m128 ClipMaxY = _mm_set1_ps(Transform.ClipMaxY);
+		const __m128 ScaleX = _mm_set1_ps(Transform.ScaleX);
+		const __m128 ScaleY = _mm_set1_ps(Transform.ScaleY);
+		const __m128 ScaleZ = _mm_set1_ps(Transform.MaxZ - Transform.MinZ);
+		const __m128 OffsetX = _mm_set1_ps(Transform.OffsetX);
+		const __m128 OffsetY = _mm_set1_ps(Transform.OffsetY);
+		const __m128 OffsetZ = _mm_set1_ps(Transform.MinZ);
+		const __m128 Zero = _mm_setzero_ps();
+		const __m128 One = _mm_set1_ps(1.0f);
+
+		const BYTE* lpIn = (const BYTE*)Data.lpIn;
+		const DWORD dwInSize = Data.dwInSize;
+
+		DWORD i = 0;
+		for (; i + 4 <= dwVertexCount; i += 4)
+		{
+			// Gather the positions of four vertices into separate x, y and z vectors
+			const float* In0 = (const float*)(lpIn + i * dwInSize);
+			const float* In1 = (const float*)(lpIn + (i + 1) * dwInSize);
+			const float* In2 = (const float*)(lpIn + (i + 2) * dwInSize);
+			const float* In3 = (const float*)(lpIn + (i + 3) * dwInSize);
+			const __m128 x = _mm_setr_ps(In0[0], In1[0], In2[0], In3[0]);
+			const __m128 y = _mm_setr_ps(In0[1], In1[1], In2[1], In3[1]);
+			const __m128 z = _mm_setr_ps(In0[2], In1[2], In2[2], In3[2]);
+
+			__m128 Out[4];
+			for (int j = 0; j < 4; j++)
+			{
+				Out[j] = _mm_add_ps(
+					_mm_add_ps(_mm_mul_ps(x, Row[0][j]), _mm_mul_ps(y, Row[1][j])),
+					_mm_add_ps(_mm_mul_ps(z, Row[2][j]), Row[3][j]));
+			}
+			const __m128 X = Out[0], Y = Out[1], Z = Out[2], W = Out[3];
+
+			DWORD ClipFlags[4] = {};
+			if (Clip)
+			{
+				const DWORD Left = (DWORD)_mm_movemask_ps(_mm_cmplt_ps(X, _mm_mul_ps(ClipMinX, W)));
+				const DWORD Right = (DWORD)_mm_movemask_ps(_mm_cmpgt_ps(X, _mm_mul_ps(ClipMaxX, W)));
+				const DWORD Top = (DWORD)_mm_movemask_ps(_mm_cmpgt_ps(Y, _mm_mul_ps(ClipMaxY, W)));
+				const DWORD Bottom = (DWORD)_mm_movemask_ps(_mm_cmplt_ps(Y, _mm_mul_ps(ClipMinY, W)));
+				const DWORD Front = (DWORD)_mm_movemask_ps(_mm_cmplt_ps(Z, Zero));
+				const DWORD Back = (DWORD)_mm_movemask_ps(_mm_cmpgt_ps(Z, W));
+				for (DWORD l = 0; l < 4; l++)
+				{
+					ClipFlags[l] =
+						(((Left >> l) & 1) ? D3DCLIP_LEFT : 0) |
+						(((Right >> l) & 1) ? D3DCLIP_RIGHT : 0) |
+						(((Top >> l) & 1) ? D3DCLIP_TOP : 0) |
+						(((Bottom >> l) & 1) ? D3DCLIP_BOTTOM : 0) |
+						(((Front >> l) & 1) ? D3DCLIP_FRONT : 0) |
+						(((Back >> l) & 1) ? D3DCLIP_BACK : 0);
+					ClipUnion |= ClipFlags[l];
+					ClipIntersection &= ClipFlags[l];
+				}
+			}
+
+			const __m128 rhw = _mm_div_ps(One, W);
+			float sx[4], sy[4], sz[4], srhw[4], hx[4], hy[4], hz[4];
+			_mm_storeu_ps(sx, _mm_add_ps(OffsetX, _mm_mul_ps(_mm_mul_ps(X, rhw), ScaleX)));
+			_mm_storeu_ps(sy, _mm_sub_ps(OffsetY, _mm_mul_ps(_mm_mul_ps(Y, rhw), ScaleY)));
+			_mm_storeu_ps(sz, _mm_add_ps(OffsetZ, _mm_mul_ps(_mm_mul_ps(Z, rhw), ScaleZ)));
+			_mm_storeu_ps(srhw, rhw);
+			_mm_storeu_ps(hx, X);
+			_mm_storeu_ps(hy, Y);
+			_mm_storeu_ps(hz, Z);
+
+			for (DWORD l = 0; l < 4; l++)
+			{
+				StoreScreenVertex(Data, i + l, sx[l], sy[l], sz[l], srhw[l], hx[l], hy[l], hz[l], ClipFlags[l], Clip, Extent);
+			}
+		}
+		return i;
+	}
+
+	// Clamps extents so that vertices with huge or infinite coordinates cannot overflow the rect
+	inline LONG ExtentToLong(float Value)
+	{
+		constexpr float Limit = 1.0e9f;
+		return (LONG)max(-Limit, min(Limit, Value));
+	}
+
+	inline DWORD ColorToByte(float Value)
+	{
+		return (DWORD)(max(0.0f, min(1.0f, Value)) * 255.0f + 0.5f);
+	}
+}
+
+// Transforms vertices to screen coordinates using the viewport, sets the clip flags and screen extents
+void TransformScreenVertices(const D3DSCREENTRANSFORM& Transform, D3DTRANSFORMDATA& Data, DWORD dwVertexCount, bool Clip)
+{
+	DWORD ClipUnion = 0;
+	DWORD ClipIntersection = dwVertexCount ? ScreenClipFlags : 0;
+	SCREENEXTENT Extent;
+
+	DWORD Done = 0;
+	if (Utils::IsSSE2Supported())
+	{
+		Done = TransformScreenVerticesSSE(Transform, Data, dwVertexCount, Clip, ClipUnion, ClipIntersection, Extent);
+	}
+	if (Done < dwVertexCount)
+	{
+		TransformScreenVerticesScalar(Transform, Data, Done, dwVertexCount, Clip, ClipUnion, ClipIntersection, Extent);
+	}
+
+	Data.dwClipUnion = Clip ? ClipUnion : 0;
+	Data.dwClipIntersection = Clip ? ClipIntersection : 0;
+	Data.drExtent = {};
+	if (Extent.Left <= Extent.Right)
+	{
+		Data.drExtent.x1 = ExtentToLong(floorf(Extent.Left));
+		Data.drExtent.y1 = ExtentToLong(floorf(Extent.Top));
+		Data.drExtent.x2 = ExtentToLong(ceilf(Extent.Right));
+		Data.drExtent.y2 = ExtentToLong(ceilf(Extent.Bottom));
+	}
+}
+
+// Lights vertices with directional and point lights, writes the diffuse and specular colors of the output vertices.
+// Positions, normals, lights and the viewer are all expected in world space.
+void LightVertices(const D3DMATERIAL7& Material, D3DCOLOR Ambient, const D3DLIGHT2* lpLights, DWORD dwLightCount, const D3DVECTOR& Viewer, const D3DLIGHTDATA& Data, DWORD dwElementCount)
+{
+	// Ambient and emissive are the same for every vertex
+	const float AmbientR = Material.dcvEmissive.r + Material.dcvAmbient.r * (float)((Ambient >> 16) & 0xFF) / 255.0f;
+	const float AmbientG = Material.dcvEmissive.g + Material.dcvAmbient.g * (float)((Ambient >> 8) & 0xFF) / 255.0f;
+	const float AmbientB = Material.dcvEmissive.b + Material.dcvAmbient.b * (float)(Ambient & 0xFF) / 255.0f;
+	const DWORD Alpha = ColorToByte(Material.dcvDiffuse.a);
+	const bool UseSpecular = (Material.dvPower > 0.0f);
+
+	std::vector<LIGHTPARAMS> Lights(dwLightCount);
+	for (DWORD x = 0; x < dwLightCount; x++)
+	{
+		const D3DLIGHT2& Light = lpLights[x];
+		LIGHTPARAMS& Params = Lights[x];
+
+		Params.r = Light.dcvColor.r;
+		Params.g = Light.dcvColor.g;
+		Params.b = Light.dcvColor.b;
+		Params.HasSpecular = UseSpecular && !(Light.dwFlags & D3DLIGHT_NO_SPECULAR);
+
+		if (Light.dltType == D3DLIGHT_DIRECTIONAL || Light.dltType == D3DLIGHT_PARALLELPOINT)
+		{
+			// Directional lights shine along their direction, parallel point lights shine from their position towards the origin
+			D3DVECTOR Direction = (Light.dltType == D3DLIGHT_DIRECTIONAL) ?
+				D3DVECTOR{ -Light.dvDirection.x, -Light.dvDirection.y, -Light.dvDirection.z } : Light.dvPosition;
+			float Length = sqrtf(Direction.x * Direction.x + Direction.y * Direction.y + Direction.z * Direction.z);
+			float InvLength = (Length > 0.0f) ? 1.0f / Length : 0.0f;
+			Params.IsDirectional = true;
+			Params.x = Direction.x * InvLength;
+			Params.y = Direction.y * InvLength;
+			Params.z = Direction.z * InvLength;
+		}
+		else
+		{
+			// Spot lights are lit as point lights
+			Params.x = Light.dvPosition.x;
+			Params.y = Light.dvPosition.y;
+			Params.z = Light.dvPosition.z;
+			Params.Range2 = (Light.dvRange > 0.0f) ? Light.dvRange * Light.dvRange : FLT_MAX;
+			Params.Attenuation0 = Light.dvAttenuation0;
+			Params.Attenuation1 = Light.dvAttenuation1;
+			Params.Attenuation2 = Light.dvAttenuation2;
+		}
+	}
+
+	for (DWORD i = 0; i < dwElementCount; i++)
+	{
+		const D3DLIGHTINGELEMENT& Element = *(const D3DLIGHTINGELEMENT*)((const BYTE*)Data.lpIn + i * Data.dwInSize);
+		D3DTLVERTEX& Out = *(D3DTLVERTEX*)((BYTE*)Data.lpOut + i * Data.dwOutSize);
+
+		const D3DVECTOR& P = Element.dvPosition;
+		const D3DVECTOR& N = Element.dvNormal;
+
+		// Direction towards the viewer, only needed for specular
+		float vx = 0.0f, vy = 0.0f, vz = 0.0f;
+		if (UseSpecular)
+		{
+			vx = Viewer.x - P.x;
+			vy = Viewer.y - P.y;
+			vz = Viewer.z - P.z;
+			float Length = sqrtf(vx * vx + vy * vy + vz * vz);
+			float InvLength = (Length > 0.0f) ? 1.0f / Length : 0.0f;
+			vx *= InvLength;
+			vy *= InvLength;
+			vz *= InvLength;
+		}
+
+		float DiffuseR = 0.0f, DiffuseG = 0.0f, DiffuseB = 0.0f;
+		float SpecularR = 0.0f, SpecularG = 0.0f, SpecularB = 0.0f;
+
+		for (const LIGHTPARAMS& Light : Lights)
+		{
+			float lx = Light.x, ly = Light.y, lz = Light.z;
+			float Attenuation = 1.0f;
+
+			if (!Light.IsDirectional)
+			{
+				lx -= P.x;
+				ly -= P.y;
+				lz -= P.z;
+				float Distance2 = lx * lx + ly * ly + lz * lz;
+				if (Distance2 > Light.Range2)
+				{
+					continue;
+				}
+				float Distance = sqrtf(Distance2);
+				float InvDistance = (Distance > 0.0f) ? 1.0f / Distance : 0.0f;
+				lx *= InvDistance;
+				ly *= InvDistance;
+				lz *= InvDistance;
+
+				float Factor = Light.Attenuation0 + Light.Attenuation1 * Distance + Light.Attenuation2 * Distance2;
+				Attenuation = (Factor > 0.0f) ? 1.0f / Factor : 1.0f;
+			}
+
+			float NdotL = N.x * lx + N.y * ly + N.z * lz;
+			if (NdotL <= 0.0f)
+			{
+				continue;
+			}
+
+			float Intensity = NdotL * Attenuation;
+			DiffuseR += Light.r * Intensity;
+			DiffuseG += Light.g * Intensity;
+			DiffuseB += Light.b * Intensity;
+
+			if (Light.HasSpecular)
+			{
+				// Blinn-Phong half vector between the light and viewer directions
+				float hx = lx + vx, hy = ly + vy, hz = lz + vz;
+				float Length = sqrtf(hx * hx + hy * hy + hz * hz);
+				float NdotH = (Length > 0.0f) ? (N.x * hx + N.y * hy + N.z * hz) / Length : 0.0f;
+				if (NdotH > 0.0f)
+				{
+					float Specular = powf(NdotH, Material.dvPower) * Attenuation;
+					SpecularR += Light.r * Specular;
+					SpecularG += Light.g * Specular;
+					SpecularB += Light.b * Specular;
+				}
+			}
+		}
+
+		Out.color = (Alpha << 24) |
+			(ColorToByte(AmbientR + DiffuseR * Material.dcvDiffuse.r) << 16) |
+			(ColorToByte(AmbientG + DiffuseG * Material.dcvDiffuse.g) << 8) |
+			ColorToByte(AmbientB + DiffuseB * Material.dcvDiffuse.b);
+		Out.specular = 0xFF000000 |
+			(ColorToByte(SpecularR * Material.dcvSpecular.r) << 16) |
+			(ColorToByte(SpecularG * Material.dcvSpecular.g) << 8) |
+			ColorToByte(SpecularB * Material.dcvSpecular.b);
+	}
+}
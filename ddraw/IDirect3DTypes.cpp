@@ -14,7 +14,9 @@
 *   3. This notice may not be removed or altered from any source distribution.
 */
 
+#include <xmmintrin.h>
 #include "ddraw.h"
+#include "Utils\Utils.h"
 
 void ConvertLight(D3DLIGHT7& Light7, const D3DLIGHT& Light)
 {
@@ -587,7 +589,21 @@ void ConvertVertices(D3DLVERTEX* lFVF, const D3DLVERTEX9* lFVF9, DWORD NumVertic
 
 void ConvertVertices(D3DLVERTEX9* lFVF9, const D3DLVERTEX* lFVF, DWORD NumVertices)
 {
-	for (UINT x = 0; x < NumVertices; x++)
+	UINT x = 0;
+	if (Utils::IsSSE2Supported() && NumVertices > 1)
+	{
+		// Drop the reserved dword with shuffles, each store writes 4 bytes past the vertex which the next vertex
+		// overwrites so the last vertex is left for the scalar loop
+		for (; x < NumVertices - 1; x++)
+		{
+			__m128 a = _mm_loadu_ps(&lFVF[x].x);	// x y z reserved
+			__m128 b = _mm_loadu_ps((const float*)&lFVF[x].color);	// color specular tu tv
+			__m128 t = _mm_shuffle_ps(a, b, _MM_SHUFFLE(0, 0, 2, 2));	// z z color color
+			_mm_storeu_ps(&lFVF9[x].x, _mm_shuffle_ps(a, t, _MM_SHUFFLE(2, 0, 1, 0)));
+			_mm_storeu_ps((float*)&lFVF9[x].specular, _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 3, 2, 1)));
+		}
+	}
+	for (; x < NumVertices; x++)
 	{
 		lFVF9[x].x = lFVF[x].x;
 		lFVF9[x].y = lFVF[x].y;
@@ -85,6 +85,24 @@ typedef enum _D3DSURFACETYPE {
     D3DTYPE_DEPTHSTENCIL = 4
 } D3DSURFACETYPE;
 
+typedef struct {
+	float Plane[6][4];      // Left, right, top, bottom, front and back planes as a, b, c, d
+} D3DFRUSTUM;
+
+typedef struct {
+	D3DMATRIX Matrix;       // Combined world, view and projection matrix
+	float ClipMinX;         // Clip volume in homogeneous units
+	float ClipMaxX;
+	float ClipMinY;
+	float ClipMaxY;
+	float ScaleX;           // Screen x = OffsetX + x / w * ScaleX
+	float ScaleY;           // Screen y = OffsetY - y / w * ScaleY
+	float OffsetX;
+	float OffsetY;
+	float MinZ;             // Depth range
+	float MaxZ;
+} D3DSCREENTRANSFORM;
+
 void ConvertLight(D3DLIGHT7& Light7, const D3DLIGHT& Light);
 void ConvertMaterial(D3DMATERIAL& Material, const D3DMATERIAL7& Material7);
 void ConvertMaterial(D3DMATERIAL7& Material7, const D3DMATERIAL& Material);
@@ -105,3 +123,9 @@ void ConvertVertex(BYTE* pDestVertex, DWORD DestFVF, const BYTE* pSrcVertex, DWO
 DWORD ConvertVertexTypeToFVF(D3DVERTEXTYPE d3dVertexType);
 UINT GetVertexStride(DWORD dwVertexTypeDesc);
 UINT GetNumberOfPrimitives(D3DPRIMITIVETYPE dptPrimitiveType, DWORD dwVertexCount);
+void MultiplyMatrix(D3DMATRIX& Out, const D3DMATRIX& a, const D3DMATRIX& b);
+bool ComputeFrustumPlanes(D3DFRUSTUM& Frustum, const D3DMATRIX& Matrix);
+void CheckSphereVisibility(const D3DFRUSTUM& Frustum, const D3DVECTOR* lpCenters, const D3DVALUE* lpRadii, DWORD dwNumSpheres, LPDWORD lpdwReturnValues);
+void ScaleTLVertices(D3DTLVERTEX* pDest, const D3DTLVERTEX* pSrc, DWORD dwVertexCount, float ScaleX, float ScaleY, float PadX, float PadY);
+void TransformScreenVertices(const D3DSCREENTRANSFORM& Transform, D3DTRANSFORMDATA& Data, DWORD dwVertexCount, bool Clip);
+void LightVertices(const D3DMATERIAL7& Material, D3DCOLOR Ambient, const D3DLIGHT2* lpLights, DWORD dwLightCount, const D3DVECTOR& Viewer, const D3DLIGHTDATA& Data, DWORD dwElementCount);
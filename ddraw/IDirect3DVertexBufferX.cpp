@@ -306,6 +306,17 @@ HRESULT m_IDirect3DVertexBufferX::ProcessVertices(DWORD dwVertexOp, DWORD dwDest
 		}
 		LPDIRECT3DVERTEXBUFFER9 d3d9DestVertexBuffer = d3d9VertexBuffer;
 
+		// Process with the application's lighting and clipping states, not the ones left by the last draw
+		m_IDirect3DDeviceX* pDeviceX = nullptr;
+		if (lpD3DDevice)
+		{
+			lpD3DDevice->QueryInterface(IID_GetInterfaceX, (LPVOID*)&pDeviceX);
+		}
+		if (pDeviceX)
+		{
+			pDeviceX->EndDrawStateOverrides();
+		}
+
 		// Get and verify FVF
 		DWORD SrcFVF = pSrcVertexBufferX->GetFVF9();
 		DWORD DestFVF = GetFVF9();
@@ -269,8 +269,40 @@ HRESULT m_IDirect3DViewportX::TransformVertices(DWORD dwVertexCount, LPD3DTRANSF
 
 	if (!ProxyInterface)
 	{
-		LOG_LIMIT(100, __FUNCTION__ << " Error: Not Implemented");
-		return DDERR_UNSUPPORTED;
+		if (!lpData || lpData->dwSize != sizeof(D3DTRANSFORMDATA))
+		{
+			LOG_LIMIT(100, __FUNCTION__ << " Error: Incorrect dwSize: " << ((lpData) ? lpData->dwSize : -1));
+			return DDERR_INVALIDPARAMS;
+		}
+
+		if (!lpData->lpIn || !lpData->lpOut || lpData->dwInSize < sizeof(D3DVECTOR) || lpData->dwOutSize < 4 * sizeof(D3DVALUE) ||
+			(dwFlags != D3DTRANSFORM_CLIPPED && dwFlags != D3DTRANSFORM_UNCLIPPED))
+		{
+			LOG_LIMIT(100, __FUNCTION__ << " Error: invalid transform data: " << lpData->dwInSize << " " << lpData->dwOutSize << " " << Logging::hex(dwFlags));
+			return DDERR_INVALIDPARAMS;
+		}
+
+		if (!D3DDeviceInterface || !*D3DDeviceInterface)
+		{
+			LOG_LIMIT(100, __FUNCTION__ << " Error: no D3DirectDevice interface!");
+			return DDERR_GENERIC;
+		}
+
+		D3DSCREENTRANSFORM Transform;
+		if (!GetScreenTransform(Transform))
+		{
+			return DDERR_GENERIC;
+		}
+
+		TransformScreenVertices(Transform, *lpData, dwVertexCount, (dwFlags == D3DTRANSFORM_CLIPPED));
+
+		// Nonzero if all vertices are off-screen
+		if (lpOffscreen)
+		{
+			*lpOffscreen = lpData->dwClipIntersection;
+		}
+
+		return D3D_OK;
 	}
 
 	return ProxyInterface->TransformVertices(dwVertexCount, lpData, dwFlags, lpOffscreen);
@@ -282,8 +314,61 @@ HRESULT m_IDirect3DViewportX::LightElements(DWORD dwElementCount, LPD3DLIGHTDATA
 
 	if (!ProxyInterface)
 	{
-		LOG_LIMIT(100, __FUNCTION__ << " Error: Not Implemented");
-		return DDERR_UNSUPPORTED;
+		if (!lpData || lpData->dwSize != sizeof(D3DLIGHTDATA))
+		{
+			LOG_LIMIT(100, __FUNCTION__ << " Error: Incorrect dwSize: " << ((lpData) ? lpData->dwSize : -1));
+			return DDERR_INVALIDPARAMS;
+		}
+
+		if (!lpData->lpIn || !lpData->lpOut || lpData->dwInSize < sizeof(D3DLIGHTINGELEMENT) || lpData->dwOutSize < sizeof(D3DTLVERTEX))
+		{
+			LOG_LIMIT(100, __FUNCTION__ << " Error: invalid light data: " << lpData->dwInSize << " " << lpData->dwOutSize);
+			return DDERR_INVALIDPARAMS;
+		}
+
+		if (!D3DDeviceInterface || !*D3DDeviceInterface)
+		{
+			LOG_LIMIT(100, __FUNCTION__ << " Error: no D3DirectDevice interface!");
+			return DDERR_GENERIC;
+		}
+
+		D3DMATERIAL7 Material = {};
+		DWORD Ambient = 0;
+		D3DMATRIX View = {};
+		if (FAILED((*D3DDeviceInterface)->GetMaterial(&Material)) ||
+			FAILED((*D3DDeviceInterface)->GetRenderState(D3DRENDERSTATE_AMBIENT, &Ambient)) ||
+			FAILED((*D3DDeviceInterface)->GetTransform(D3DTRANSFORMSTATE_VIEW, &View)))
+		{
+			LOG_LIMIT(100, __FUNCTION__ << " Error: could not get device lighting state!");
+			return DDERR_GENERIC;
+		}
+
+		// Lights attached to the viewport are all active, see SetCurrentViewportActive()
+		std::vector<D3DLIGHT2> Lights;
+		for (auto& entry : AttachedLights)
+		{
+			D3DLIGHT2 Light2 = {};
+			Light2.dwSize = sizeof(D3DLIGHT2);
+			if (FAILED(entry->GetLight((LPD3DLIGHT)&Light2)))
+			{
+				continue;
+			}
+			if (Light2.dltType == D3DLIGHT_SPOT || Light2.dltType == D3DLIGHT_GLSPOT)
+			{
+				LOG_LIMIT(100, __FUNCTION__ << " Warning: spot lights are lit as point lights!");
+			}
+			Lights.push_back(Light2);
+		}
+
+		// Viewer position is the view matrix translation moved back through its rotation
+		D3DVECTOR Viewer;
+		Viewer.x = -(View._41 * View._11 + View._42 * View._12 + View._43 * View._13);
+		Viewer.y = -(View._41 * View._21 + View._42 * View._22 + View._43 * View._23);
+		Viewer.z = -(View._41 * View._31 + View._42 * View._32 + View._43 * View._33);
+
+		LightVertices(Material, Ambient, Lights.data(), Lights.size(), Viewer, *lpData, dwElementCount);
+
+		return D3D_OK;
 	}
 
 	return ProxyInterface->LightElements(dwElementCount, lpData);
@@ -651,6 +736,72 @@ HRESULT m_IDirect3DViewportX::SetViewport2(LPD3DVIEWPORT2 lpData)
 	return ProxyInterface->SetViewport2(lpData);
 }
 
+// Gets the combined device transform and the viewport clip volume and screen mapping
+bool m_IDirect3DViewportX::GetScreenTransform(D3DSCREENTRANSFORM& Transform)
+{
+	D3DMATRIX World, View, Projection, WorldView;
+	if (FAILED((*D3DDeviceInterface)->GetTransform(D3DTRANSFORMSTATE_WORLD, &World)) ||
+		FAILED((*D3DDeviceInterface)->GetTransform(D3DTRANSFORMSTATE_VIEW, &View)) ||
+		FAILED((*D3DDeviceInterface)->GetTransform(D3DTRANSFORMSTATE_PROJECTION, &Projection)))
+	{
+		LOG_LIMIT(100, __FUNCTION__ << " Error: could not get device transforms!");
+		return false;
+	}
+	MultiplyMatrix(WorldView, World, View);
+	MultiplyMatrix(Transform.Matrix, WorldView, Projection);
+
+	if (IsViewPort2Set)
+	{
+		if (vData2.dvClipWidth == 0.0f || vData2.dvClipHeight == 0.0f)
+		{
+			LOG_LIMIT(100, __FUNCTION__ << " Error: invalid clip volume: " << vData2.dvClipWidth << "x" << vData2.dvClipHeight);
+			return false;
+		}
+
+		// Clip volume maps to the viewport rect, y goes down from dvClipY
+		Transform.ClipMinX = vData2.dvClipX;
+		Transform.ClipMaxX = vData2.dvClipX + vData2.dvClipWidth;
+		Transform.ClipMaxY = vData2.dvClipY;
+		Transform.ClipMinY = vData2.dvClipY - vData2.dvClipHeight;
+		Transform.ScaleX = vData2.dwWidth / vData2.dvClipWidth;
+		Transform.ScaleY = vData2.dwHeight / vData2.dvClipHeight;
+		Transform.OffsetX = vData2.dwX - vData2.dvClipX * Transform.ScaleX;
+		Transform.OffsetY = vData2.dwY + vData2.dvClipY * Transform.ScaleY;
+		Transform.MinZ = vData2.dvMinZ;
+		Transform.MaxZ = vData2.dvMaxZ;
+	}
+	else
+	{
+		D3DVIEWPORT Viewport = {};
+		Viewport.dwSize = sizeof(D3DVIEWPORT);
+		if (FAILED(GetViewport(&Viewport)))
+		{
+			return false;
+		}
+
+		// Homogeneous scale is optional, use the default -1 to 1 clip volume when it is not set
+		const bool HasScale = (Viewport.dvScaleX != 0.0f && Viewport.dvScaleY != 0.0f && Viewport.dvMaxX != 0.0f && Viewport.dvMaxY != 0.0f);
+		Transform.ClipMaxX = HasScale ? Viewport.dvMaxX : 1.0f;
+		Transform.ClipMaxY = HasScale ? Viewport.dvMaxY : 1.0f;
+		Transform.ClipMinX = -Transform.ClipMaxX;
+		Transform.ClipMinY = -Transform.ClipMaxY;
+		Transform.ScaleX = HasScale ? Viewport.dvScaleX : Viewport.dwWidth / 2.0f;
+		Transform.ScaleY = HasScale ? Viewport.dvScaleY : Viewport.dwHeight / 2.0f;
+		Transform.OffsetX = Viewport.dwX + Viewport.dwWidth / 2.0f;
+		Transform.OffsetY = Viewport.dwY + Viewport.dwHeight / 2.0f;
+		Transform.MinZ = Viewport.dvMinZ;
+		Transform.MaxZ = Viewport.dvMaxZ;
+	}
+
+	// A zero depth range would put every vertex on the near plane, use the full range instead
+	if (Transform.MinZ == 0.0f && Transform.MaxZ == 0.0f)
+	{
+		Transform.MaxZ = 1.0f;
+	}
+
+	return true;
+}
+
 void m_IDirect3DViewportX::SetCurrentViewportActive(bool SetViewPortData, bool SetBackgroundData, bool SetLightData)
 {
 	if (!D3DDeviceInterface || !*D3DDeviceInterface)
@@ -72,6 +72,9 @@ private:
 	inline IDirect3DViewport2 *GetProxyInterfaceV2() { return (IDirect3DViewport2 *)ProxyInterface; }
 	inline IDirect3DViewport3 *GetProxyInterfaceV3() { return ProxyInterface; }
 
+	// Helper functions
+	bool GetScreenTransform(D3DSCREENTRANSFORM& Transform);
+
 	// Interface initialization functions
 	void InitInterface(DWORD DirectXVersion);
 	void ReleaseInterface();
@@ -19,8 +19,18 @@
 */
 
 #include <sstream>
+#include <list>
+#include <deque>
+#include <unordered_map>
 #include "ddraw.h"
 #include "d3dx9.h"
+#include "ColorKeyConvert.h"
+#include "DXTCodec.h"
+#include "InPlaceBlt.h"
+#include "MipMapGen.h"
+#include "SurfaceBlit.h"
+#include "SurfaceCopy.h"
+#include "SurfaceDump.h"
 #include "Utils\Utils.h"
 
 constexpr DWORD ExtraDataBufferSize = 200;
@@ -41,7 +51,55 @@ namespace {
 
 // Used for sharing emulated memory
 bool ShareEmulatedMemory = false;
-std::vector<EMUSURFACE*> memorySurfaces;
+namespace {
+	// Shared emulated surfaces are only reused by surfaces with the same size, bit count, format and pitch
+	struct EMUSURFACEKEY
+	{
+		DWORD Width;
+		DWORD Height;
+		DWORD BitCount;
+		D3DFORMAT Format;
+		DWORD Pitch;
+
+		bool operator==(const EMUSURFACEKEY& other) const
+		{
+			return Width == other.Width && Height == other.Height && BitCount == other.BitCount && Format == other.Format && Pitch == other.Pitch;
+		}
+	};
+
+	struct EMUSURFACEKEYHASH
+	{
+		size_t operator()(const EMUSURFACEKEY& Key) const
+		{
+			size_t hash = Key.Width;
+			hash = hash * 31 + Key.Height;
+			hash = hash * 31 + Key.BitCount;
+			hash = hash * 31 + Key.Format;
+			hash = hash * 31 + Key.Pitch;
+			return hash;
+		}
+	};
+
+	// Unused emulated surfaces above this size are deleted, least recently used first
+	constexpr size_t MaxSharedEmulatedMemory = 128 * 1024 * 1024;
+
+	// Unused emulated surfaces, most recently returned at the front
+	std::list<EMUSURFACE*> memorySurfaceList;
+
+	// Size class buckets pointing into the list, most recently returned at the back
+	std::unordered_map<EMUSURFACEKEY, std::deque<std::list<EMUSURFACE*>::iterator>, EMUSURFACEKEYHASH> memorySurfaces;
+	size_t memorySurfaceBytes = 0;
+
+	inline EMUSURFACEKEY GetEmulatedMemoryKey(EMUSURFACE* pEmuSurface)
+	{
+		return { (DWORD)pEmuSurface->bmi->bmiHeader.biWidth, (DWORD)-pEmuSurface->bmi->bmiHeader.biHeight, pEmuSurface->bmi->bmiHeader.biBitCount, pEmuSurface->Format, pEmuSurface->Pitch };
+	}
+
+	inline size_t GetEmulatedMemorySize(EMUSURFACE* pEmuSurface)
+	{
+		return (size_t)pEmuSurface->Size + (size_t)pEmuSurface->Pitch * ExtraDataBufferSize;
+	}
+}
 
 // Used for dummy mipmaps
 std::vector<BYTE> dummySurface;
@@ -456,6 +514,64 @@ HRESULT m_IDirectDrawSurfaceX::AddOverlayDirtyRect(LPRECT lpRect)
 	return ProxyInterface->AddOverlayDirtyRect(lpRect);
 }
 
+// Check for unsupported blt flags and a missing DDBLTFX structure
+HRESULT m_IDirectDrawSurfaceX::CheckBltFlags(DWORD dwFlags, LPDDBLTFX lpDDBltFx)
+{
+	// All DDBLT_ALPHA flag values, Not currently implemented in DirectDraw.
+	if (dwFlags & (DDBLT_ALPHADEST | DDBLT_ALPHADESTCONSTOVERRIDE | DDBLT_ALPHADESTNEG | DDBLT_ALPHADESTSURFACEOVERRIDE | DDBLT_ALPHAEDGEBLEND |
+		DDBLT_ALPHASRC | DDBLT_ALPHASRCCONSTOVERRIDE | DDBLT_ALPHASRCNEG | DDBLT_ALPHASRCSURFACEOVERRIDE))
+	{
+		LOG_LIMIT(100, __FUNCTION__ << " Error: alpha values not implemented!");
+		return DDERR_NOALPHAHW;
+	}
+
+	// All DDBLT_ZBUFFER flag values: This method does not currently support z-aware bitblt operations. None of the flags beginning with "DDBLT_ZBUFFER" are supported in DirectDraw.
+	if (dwFlags & (DDBLT_ZBUFFER | DDBLT_ZBUFFERDESTCONSTOVERRIDE | DDBLT_ZBUFFERDESTOVERRIDE | DDBLT_ZBUFFERSRCCONSTOVERRIDE | DDBLT_ZBUFFERSRCOVERRIDE))
+	{
+		LOG_LIMIT(100, __FUNCTION__ << " Error: zbuffer values not implemented!");
+		return DDERR_NOZBUFFERHW;
+	}
+
+	// DDBLT_DDROPS - dwDDROP is ignored as "no such ROPs are currently defined" in DirectDraw
+	if (dwFlags & DDBLT_DDROPS)
+	{
+		LOG_LIMIT(100, __FUNCTION__ << " Error: DDROP values not implemented!");
+		return DDERR_NODDROPSHW;
+	}
+
+	// Check for required DDBLTFX structure
+	bool RequiresFxStruct = (dwFlags & (DDBLT_DDFX | DDBLT_COLORFILL | DDBLT_DEPTHFILL | DDBLT_KEYDESTOVERRIDE | DDBLT_KEYSRCOVERRIDE | DDBLT_ROP | DDBLT_ROTATIONANGLE));
+	if (RequiresFxStruct && !lpDDBltFx)
+	{
+		LOG_LIMIT(100, __FUNCTION__ << " Error: DDBLTFX structure not found!");
+		return DDERR_INVALIDPARAMS;
+	}
+
+	// Check for DDBLTFX structure size
+	if (RequiresFxStruct && lpDDBltFx->dwSize != sizeof(DDBLTFX))
+	{
+		LOG_LIMIT(100, __FUNCTION__ << " Error: DDBLTFX structure is not initialized to the correct size: " << lpDDBltFx->dwSize);
+		return DDERR_INVALIDPARAMS;
+	}
+
+	// Check for rotation flags
+	// ToDo: add support for other rotation flags (90,180, 270).  Not sure if any game uses these other flags.
+	if ((dwFlags & DDBLT_ROTATIONANGLE) || ((dwFlags & DDBLT_DDFX) && (lpDDBltFx->dwDDFX & (DDBLTFX_ROTATE90 | DDBLTFX_ROTATE180 | DDBLTFX_ROTATE270))))
+	{
+		LOG_LIMIT(100, __FUNCTION__ << " Error: Rotation operations Not Implemented: " << Logging::hex(lpDDBltFx->dwDDFX & (DDBLTFX_ROTATE90 | DDBLTFX_ROTATE180 | DDBLTFX_ROTATE270)));
+		return DDERR_NOROTATIONHW;
+	}
+
+	// Check supported raster operations
+	if ((dwFlags & DDBLT_ROP) && (lpDDBltFx->dwROP != SRCCOPY && lpDDBltFx->dwROP != BLACKNESS && lpDDBltFx->dwROP != WHITENESS))
+	{
+		LOG_LIMIT(100, __FUNCTION__ << " Error: Raster operation Not Implemented " << Logging::hex(lpDDBltFx->dwROP));
+		return DDERR_NORASTEROPHW;
+	}
+
+	return DD_OK;
+}
+
 HRESULT m_IDirectDrawSurfaceX::Blt(LPRECT lpDestRect, LPDIRECTDRAWSURFACE7 lpDDSrcSurface, LPRECT lpSrcRect, DWORD dwFlags, LPDDBLTFX lpDDBltFx, DWORD MipMapLevel, bool PresentBlt)
 {
 	Logging::LogDebug() << __FUNCTION__ << " (" << this << ")" <<
@@ -476,56 +592,11 @@ HRESULT m_IDirectDrawSurfaceX::Blt(LPRECT lpDestRect, LPDIRECTDRAWSURFACE7 lpDDS
 
 	if (Config.Dd7to9)
 	{
-		// All DDBLT_ALPHA flag values, Not currently implemented in DirectDraw.
-		if (dwFlags & (DDBLT_ALPHADEST | DDBLT_ALPHADESTCONSTOVERRIDE | DDBLT_ALPHADESTNEG | DDBLT_ALPHADESTSURFACEOVERRIDE | DDBLT_ALPHAEDGEBLEND |
-			DDBLT_ALPHASRC | DDBLT_ALPHASRCCONSTOVERRIDE | DDBLT_ALPHASRCNEG | DDBLT_ALPHASRCSURFACEOVERRIDE))
-		{
-			LOG_LIMIT(100, __FUNCTION__ << " Error: alpha values not implemented!");
-			return DDERR_NOALPHAHW;
-		}
-
-		// All DDBLT_ZBUFFER flag values: This method does not currently support z-aware bitblt operations. None of the flags beginning with "DDBLT_ZBUFFER" are supported in DirectDraw.
-		if (dwFlags & (DDBLT_ZBUFFER | DDBLT_ZBUFFERDESTCONSTOVERRIDE | DDBLT_ZBUFFERDESTOVERRIDE | DDBLT_ZBUFFERSRCCONSTOVERRIDE | DDBLT_ZBUFFERSRCOVERRIDE))
-		{
-			LOG_LIMIT(100, __FUNCTION__ << " Error: zbuffer values not implemented!");
-			return DDERR_NOZBUFFERHW;
-		}
-
-		// DDBLT_DDROPS - dwDDROP is ignored as "no such ROPs are currently defined" in DirectDraw
-		if (dwFlags & DDBLT_DDROPS)
+		// Check blt flags
+		HRESULT f_hr = CheckBltFlags(dwFlags, lpDDBltFx);
+		if (FAILED(f_hr))
 		{
-			LOG_LIMIT(100, __FUNCTION__ << " Error: DDROP values not implemented!");
-			return DDERR_NODDROPSHW;
-		}
-
-		// Check for required DDBLTFX structure
-		bool RequiresFxStruct = (dwFlags & (DDBLT_DDFX | DDBLT_COLORFILL | DDBLT_DEPTHFILL | DDBLT_KEYDESTOVERRIDE | DDBLT_KEYSRCOVERRIDE | DDBLT_ROP | DDBLT_ROTATIONANGLE));
-		if (RequiresFxStruct && !lpDDBltFx)
-		{
-			LOG_LIMIT(100, __FUNCTION__ << " Error: DDBLTFX structure not found!");
-			return DDERR_INVALIDPARAMS;
-		}
-
-		// Check for DDBLTFX structure size
-		if (RequiresFxStruct && lpDDBltFx->dwSize != sizeof(DDBLTFX))
-		{
-			LOG_LIMIT(100, __FUNCTION__ << " Error: DDBLTFX structure is not initialized to the correct size: " << lpDDBltFx->dwSize);
-			return DDERR_INVALIDPARAMS;
-		}
-
-		// Check for rotation flags
-		// ToDo: add support for other rotation flags (90,180, 270).  Not sure if any game uses these other flags.
-		if ((dwFlags & DDBLT_ROTATIONANGLE) || ((dwFlags & DDBLT_DDFX) && (lpDDBltFx->dwDDFX & (DDBLTFX_ROTATE90 | DDBLTFX_ROTATE180 | DDBLTFX_ROTATE270))))
-		{
-			LOG_LIMIT(100, __FUNCTION__ << " Error: Rotation operations Not Implemented: " << Logging::hex(lpDDBltFx->dwDDFX & (DDBLTFX_ROTATE90 | DDBLTFX_ROTATE180 | DDBLTFX_ROTATE270)));
-			return DDERR_NOROTATIONHW;
-		}
-
-		// Check supported raster operations
-		if ((dwFlags & DDBLT_ROP) && (lpDDBltFx->dwROP != SRCCOPY && lpDDBltFx->dwROP != BLACKNESS && lpDDBltFx->dwROP != WHITENESS))
-		{
-			LOG_LIMIT(100, __FUNCTION__ << " Error: Raster operation Not Implemented " << Logging::hex(lpDDBltFx->dwROP));
-			return DDERR_NORASTEROPHW;
+			return f_hr;
 		}
 
 		// Get source mipmap level
@@ -735,7 +806,7 @@ HRESULT m_IDirectDrawSurfaceX::Blt(LPRECT lpDestRect, LPDIRECTDRAWSURFACE7 lpDDS
 				if (PresentBlt)
 				{
 					// Set dirty flag
-					SetDirtyFlag(MipMapLevel);
+					SetDirtyFlag(MipMapLevel, lpDestRect);
 
 					// Present surface
 					EndWritePresent(lpDestRect, true, PresentBlt, IsSkipScene);
@@ -839,21 +910,133 @@ HRESULT m_IDirectDrawSurfaceX::BltBatch(LPDDBLTBATCH lpDDBltBatch, DWORD dwCount
 		return c_hr;
 	}
 
+	// Check all entries before doing any blits
+	for (DWORD x = 0; x < dwCount; x++)
+	{
+		if (lpDDBltBatch[x].lpDDSSrc && !ProxyAddressLookupTable.CheckSurfaceExists((LPDIRECTDRAWSURFACE7)lpDDBltBatch[x].lpDDSSrc))
+		{
+			LOG_LIMIT(100, __FUNCTION__ << " Error: could not find source surface! " << x << " of " << dwCount << " " << lpDDBltBatch[x].lpDDSSrc);
+			return DDERR_INVALIDPARAMS;
+		}
+		if (Config.Dd7to9)
+		{
+			HRESULT f_hr = CheckBltFlags(lpDDBltBatch[x].dwFlags, lpDDBltBatch[x].lpDDBltFx);
+			if (FAILED(f_hr))
+			{
+				return f_hr;
+			}
+		}
+	}
+
 	HRESULT hr = DD_OK;
 
 	bool IsSkipScene = false;
 
 	SetLockCriticalSection();
 
+	// Find entries that can be copied directly, the destination and each source surface are only locked once for these
+	const bool IsDirect = Config.Dd7to9 && !MipMapLevel && CanBltBatchDirect() && !ShouldReadFromGDI() && !(Config.DdrawRemoveScanlines && IsPrimaryOrBackBuffer());
+	BltBatchList.assign(dwCount, BLTBATCHENTRY());
+	for (DWORD x = 0; IsDirect && x < dwCount; x++)
+	{
+		if (!GetBltBatchEntry(lpDDBltBatch[x], BltBatchList[x]))
+		{
+			BltBatchList[x] = BLTBATCHENTRY();
+		}
+	}
+
 	// Present before write if needed
 	BeginWritePresent(IsSkipScene);
 
 	IsInBltBatch = true;
 
+	struct BATCHLOCK
+	{
+		m_IDirectDrawSurfaceX* pSurface = nullptr;
+		D3DLOCKED_RECT LockRect = {};
+	};
+	std::vector<BATCHLOCK> BatchLocks;
+	RECT SyncRect = {};
+	bool IsSyncPending = false;
+
+	// Lambda functions to lock each surface once and unlock them before the next Blt
+	auto GetBatchLock = [&](m_IDirectDrawSurfaceX* pSurfaceX, D3DLOCKED_RECT& LockRect) -> bool {
+		for (BATCHLOCK& Lock : BatchLocks)
+		{
+			if (Lock.pSurface == pSurfaceX)
+			{
+				LockRect = Lock.LockRect;
+				return true;
+			}
+		}
+		BATCHLOCK Lock;
+		Lock.pSurface = pSurfaceX;
+		pSurfaceX->SetLockCriticalSection();
+		if (FAILED(pSurfaceX->IsUsingEmulation() ? pSurfaceX->LockEmulatedSurface(&Lock.LockRect, nullptr) :
+			pSurfaceX->LockD3d9Surface(&Lock.LockRect, nullptr, ((pSurfaceX == this) ? 0 : D3DLOCK_READONLY) | D3DLOCK_NOSYSLOCK, 0)) || !Lock.LockRect.pBits)
+		{
+			pSurfaceX->ReleaseLockCriticalSection();
+			return false;
+		}
+		pSurfaceX->IsInBlt = true;
+		pSurfaceX->LockedWithID = GetCurrentThreadId();
+		BatchLocks.push_back(Lock);
+		LockRect = Lock.LockRect;
+		return true;
+	};
+	auto ReleaseBatchLocks = [&]() {
+		for (BATCHLOCK& Lock : BatchLocks)
+		{
+			Lock.pSurface->IsUsingEmulation() ? DD_OK : Lock.pSurface->UnLockD3d9Surface(0);
+			Lock.pSurface->IsInBlt = false;
+			if (!Lock.pSurface->IsSurfaceBlitting() && !Lock.pSurface->IsSurfaceLocked())
+			{
+				Lock.pSurface->LockedWithID = 0;
+			}
+			Lock.pSurface->ReleaseLockCriticalSection();
+		}
+		BatchLocks.clear();
+
+		// Keep surface insync
+		if (IsSyncPending)
+		{
+			EndWriteSyncSurfaces(&SyncRect);
+			IsSyncPending = false;
+		}
+	};
+
 	for (DWORD x = 0; x < dwCount; x++)
 	{
 		IsSkipScene |= (lpDDBltBatch[x].lprDest) ? CheckRectforSkipScene(*lpDDBltBatch[x].lprDest) : false;
 
+		// Copy entry directly using the batch locks
+		BLTBATCHENTRY& Entry = BltBatchList[x];
+		if (Entry.Kernel)
+		{
+			D3DLOCKED_RECT DestLock = {}, SrcLock = {};
+			if (GetBatchLock(this, DestLock) && GetBatchLock(Entry.pSourceSurface, SrcLock))
+			{
+				const LONG ByteCount = surface.BitCount / 8;
+				Entry.Kernel(Entry.ColorKey,
+					(const BYTE*)SrcLock.pBits + Entry.SrcRect.top * SrcLock.Pitch + Entry.SrcRect.left * ByteCount,
+					(BYTE*)DestLock.pBits + Entry.DestRect.top * DestLock.Pitch + Entry.DestRect.left * ByteCount,
+					SrcLock.Pitch, DestLock.Pitch, Entry.DestRect.right - Entry.DestRect.left, Entry.DestRect.bottom - Entry.DestRect.top);
+
+				if (IsSyncPending)
+				{
+					UnionRect(&SyncRect, &SyncRect, &Entry.DestRect);
+				}
+				else
+				{
+					SyncRect = Entry.DestRect;
+					IsSyncPending = true;
+				}
+				continue;
+			}
+		}
+
+		// Other entries go through Blt
+		ReleaseBatchLocks();
 		hr = Blt(lpDDBltBatch[x].lprDest, (LPDIRECTDRAWSURFACE7)lpDDBltBatch[x].lpDDSSrc, lpDDBltBatch[x].lprSrc, lpDDBltBatch[x].dwFlags, lpDDBltBatch[x].lpDDBltFx, MipMapLevel, false);
 		if (FAILED(hr))
 		{
@@ -862,6 +1045,8 @@ HRESULT m_IDirectDrawSurfaceX::BltBatch(LPDDBLTBATCH lpDDBltBatch, DWORD dwCount
 		}
 	}
 
+	ReleaseBatchLocks();
+
 	IsInBltBatch = false;
 
 	if (!IsSurfaceBlitting() && !IsSurfaceLocked())
@@ -1241,23 +1426,27 @@ HRESULT m_IDirectDrawSurfaceX::EnumAttachedSurfaces2(LPVOID lpContext, LPDDENUMS
 				}
 			}
 		}
-		for (auto& it : AttachedSurfaceMap)
+		// Walk by key since the callback can add or remove attached surfaces
+		for (auto it = AttachedSurfaceMap.begin(); it != AttachedSurfaceMap.end(); )
 		{
+			DWORD Key = it->first;
+
 			// This method enumerates all the surfaces attached to a given surface.
 			// In a flipping chain of three or more surfaces, only one surface is enumerated because each surface is attached only to the next surface in the flipping chain.
 			// In such a configuration, you can call EnumAttachedSurfaces on each successive surface to walk the entire flipping chain.
 			// The front buffer should not be returned as attached.
-			if (!(it.second.pSurface->surfaceDesc2.ddsCaps.dwCaps & DDSCAPS_FRONTBUFFER))
+			if (!(it->second.pSurface->surfaceDesc2.ddsCaps.dwCaps & DDSCAPS_FRONTBUFFER))
 			{
 				DDSURFACEDESC2 Desc2 = {};
 				Desc2.dwSize = sizeof(DDSURFACEDESC2);
-				it.second.pSurface->GetSurfaceDesc2(&Desc2, 0, DirectXVersion);
-				LPDIRECTDRAWSURFACE7 lpSurface = (LPDIRECTDRAWSURFACE7)it.second.pSurface->GetWrapperInterfaceX(DirectXVersion);
+				it->second.pSurface->GetSurfaceDesc2(&Desc2, 0, DirectXVersion);
+				LPDIRECTDRAWSURFACE7 lpSurface = (LPDIRECTDRAWSURFACE7)it->second.pSurface->GetWrapperInterfaceX(DirectXVersion);
 				if (EnumSurface::ConvertCallback(lpSurface, &Desc2, &CallbackContext) == DDENUMRET_CANCEL)
 				{
 					return DD_OK;
 				}
 			}
+			it = AttachedSurfaceMap.upper_bound(Key);
 		}
 
 		return DD_OK;
@@ -1476,20 +1665,9 @@ HRESULT m_IDirectDrawSurfaceX::Flip(LPDIRECTDRAWSURFACE7 lpDDSurfaceTargetOverri
 		{
 			m_IDirectDrawSurfaceX* lpTargetSurface = this;
 			do {
-				DWORD dwCaps = 0;
-				m_IDirectDrawSurfaceX* lpNewTargetSurface = nullptr;
-
-				// Loop through each surface
-				for (auto& it : lpTargetSurface->AttachedSurfaceMap)
-				{
-					dwCaps = it.second.pSurface->GetSurfaceCaps().dwCaps;
-					if (dwCaps & DDSCAPS_FLIP)
-					{
-						lpNewTargetSurface = it.second.pSurface;
-						break;
-					}
-				}
-				lpTargetSurface = lpNewTargetSurface;
+				// Get next surface in the flip chain
+				lpTargetSurface = lpTargetSurface->GetFlipBackBuffer();
+				DWORD dwCaps = lpTargetSurface ? lpTargetSurface->GetSurfaceCaps().dwCaps : 0;
 
 				// Stop looping when frontbuffer is found
 				if (lpTargetSurface == this || dwCaps & DDSCAPS_FRONTBUFFER)
@@ -2159,6 +2337,12 @@ HRESULT m_IDirectDrawSurfaceX::GetDC(HDC FAR* lphDC, DWORD MipMapLevel)
 			// Set LastDC
 			LastDC = *lphDC;
 
+			// Wake the present thread so it keeps redrawing the primary while the application holds the DC
+			if (IsPrimarySurface() && ddrawParent->IsUsingThreadPresent())
+			{
+				ddrawParent->SetPresentPending();
+			}
+
 		} while (false);
 
 		IsPreparingDC = false;
@@ -2841,6 +3025,12 @@ HRESULT m_IDirectDrawSurfaceX::Lock2(LPRECT lpDestRect, LPDDSURFACEDESC2 lpDDSur
 			}
 			LockedWithID = GetCurrentThreadId();
 
+			// Wake the present thread so it keeps redrawing the primary while the application holds the lock
+			if (IsPrimarySurface() && ddrawParent->IsUsingThreadPresent())
+			{
+				ddrawParent->SetPresentPending();
+			}
+
 			// Store locked rect
 			if (lpDestRect)
 			{
@@ -3190,10 +3380,11 @@ HRESULT m_IDirectDrawSurfaceX::SetColorKey(DWORD dwFlags, LPDDCOLORKEY lpDDColor
 			return DDERR_NOCOLORKEYHW;
 		}
 
-		// Reset shader flag
+		// Reset shader flag, the color key is also baked into the draw texture alpha
 		if (dds == DDSD_CKSRCBLT)
 		{
 			ShaderColorKey.IsSet = false;
+			SetDrawTextureFullyDirty();
 		}
 
 		// Set color key
@@ -3450,7 +3641,7 @@ HRESULT m_IDirectDrawSurfaceX::Unlock(LPRECT lpRect, DWORD MipMapLevel)
 		if (SUCCEEDED(hr) && !LastLock.ReadOnly)
 		{
 			// Set dirty flag
-			SetDirtyFlag(LastLock.MipMapLevel);
+			SetDirtyFlag(LastLock.MipMapLevel, &LastLock.Rect);
 
 			// Keep surface insync
 			EndWriteSyncSurfaces(&LastLock.Rect);
@@ -4282,7 +4473,7 @@ LPDIRECT3DTEXTURE9 m_IDirectDrawSurfaceX::GetD3d9DrawTexture()
 	// Check if texture already exists
 	if (surface.DrawTexture)
 	{
-		if (surface.IsDrawTextureDirty && FAILED(CopyToDrawTexture(nullptr)))
+		if (surface.IsDrawTextureDirty && FAILED(CopyToDrawTexture(&surface.DrawTextureDirtyRect)))
 		{
 			return nullptr;
 		}
@@ -4380,26 +4571,54 @@ HRESULT m_IDirectDrawSurfaceX::GenerateMipMapLevels()
 		return DDERR_GENERIC;
 	}
 
+	// Each level is built from the level above it
+	DWORD SourceLevel = 0;
 	for (UINT x = 0; x < min(MaxMipMapLevel, MipMaps.size()); x++)
 	{
-		if (!MipMaps[x].IsDummy && MipMaps[x].UniquenessValue < UniquenessValue)
+		if (MipMaps[x].IsDummy)
+		{
+			continue;
+		}
+
+		IDirect3DSurface9* pDestSurfaceD9 = Get3DMipMapSurface(x + 1);
+		if (!pDestSurfaceD9)
 		{
-			IDirect3DSurface9* pDestSurfaceD9 = Get3DMipMapSurface(x + 1);
-			if (pDestSurfaceD9)
+			continue;
+		}
+
+		bool IsLevelReady = (MipMaps[x].UniquenessValue >= UniquenessValue);
+		if (!IsLevelReady)
+		{
+			if (!MipMaps[x].IsGenerated)
 			{
 				LOG_LIMIT(100, __FUNCTION__ << " (" << this << ") Warning: attempting to add missing data to MipMap surface level: " << (x + 1));
-				if (SUCCEEDED(D3DXLoadSurfaceFromSurface(pDestSurfaceD9, nullptr, nullptr, pSourceSurfaceD9, nullptr, nullptr, D3DX_FILTER_LINEAR, 0x00000000)))
-				{
-					MipMaps[x].UniquenessValue = UniquenessValue;
-				}
-				else
-				{
-					LOG_LIMIT(100, __FUNCTION__ << " Error: could not copy MipMap surface level!");
-				}
-				Release3DMipMapSurface(pDestSurfaceD9, x + 1);
+			}
+			if (SUCCEEDED(GenerateMipMapSurface(pSourceSurfaceD9, pDestSurfaceD9)) ||
+				SUCCEEDED(D3DXLoadSurfaceFromSurface(pDestSurfaceD9, nullptr, nullptr, pSourceSurfaceD9, nullptr, nullptr, D3DX_FILTER_BOX, 0x00000000)))
+			{
+				MipMaps[x].UniquenessValue = UniquenessValue;
+				MipMaps[x].IsGenerated = true;
+				IsLevelReady = true;
+			}
+			else
+			{
+				LOG_LIMIT(100, __FUNCTION__ << " Error: could not copy MipMap surface level!");
 			}
 		}
+
+		// Keep building from the last good level if this one could not be filled
+		if (IsLevelReady)
+		{
+			Release3DMipMapSurface(pSourceSurfaceD9, SourceLevel);
+			pSourceSurfaceD9 = pDestSurfaceD9;
+			SourceLevel = x + 1;
+		}
+		else
+		{
+			Release3DMipMapSurface(pDestSurfaceD9, x + 1);
+		}
 	}
+	Release3DMipMapSurface(pSourceSurfaceD9, SourceLevel);
 
 	CheckMipMapLevelGen();
 
@@ -4869,6 +5088,7 @@ HRESULT m_IDirectDrawSurfaceX::CreateD9Surface()
 
 		// Restore surface texture data
 		bool RestoreData = false;
+		bool BackupRestored = false;
 		if (IsUsingEmulation() && !EmuSurfaceCreated)
 		{
 			// Copy surface to emulated surface
@@ -4901,29 +5121,46 @@ HRESULT m_IDirectDrawSurfaceX::CreateD9Surface()
 
 					if (LostDeviceBackup[Level].Format == Desc.Format && LostDeviceBackup[Level].Width == Desc.Width && LostDeviceBackup[Level].Height == Desc.Height)
 					{
+						DDBACKUP& Backup = LostDeviceBackup[Level];
 						size_t size = GetSurfaceSize(Desc.Format, Desc.Width, Desc.Height, LockRect.Pitch);
+						bool IsLoaded = false;
 
-						if (size == LostDeviceBackup[Level].Bits.size())
+						if (size == Backup.Size)
 						{
-							memcpy(LockRect.pBits, LostDeviceBackup[Level].Bits.data(), size);
+							IsLoaded = LoadBackupData(Backup, (BYTE*)LockRect.pBits);
 						}
-						else
+						else if (Backup.Pitch && LockRect.Pitch)
 						{
-							BYTE* pSrcSurface = LostDeviceBackup[Level].Bits.data();
-							BYTE* pDestSurface = (BYTE*)LockRect.pBits;
-							DWORD MinPitchSize = min((UINT)LockRect.Pitch, LostDeviceBackup[Level].Pitch);
-
-							for (UINT x = 0; x < surface.Height; x++)
+							// Pitch changed, unpack the backup first and copy it row by row
+							std::vector<byte> Bits(Backup.Size);
+							IsLoaded = LoadBackupData(Backup, Bits.data());
+							if (IsLoaded)
 							{
-								memcpy(pDestSurface, pSrcSurface, MinPitchSize);
-
-								pSrcSurface += LostDeviceBackup[Level].Pitch;
-								pDestSurface += LockRect.Pitch;
+								BYTE* pSrcSurface = Bits.data();
+								BYTE* pDestSurface = (BYTE*)LockRect.pBits;
+								DWORD MinPitchSize = min((UINT)LockRect.Pitch, Backup.Pitch);
+								DWORD Rows = min(Backup.Size / Backup.Pitch, (DWORD)(size / LockRect.Pitch));
+
+								for (UINT x = 0; x < Rows; x++)
+								{
+									memcpy(pDestSurface, pSrcSurface, MinPitchSize);
+
+									pSrcSurface += Backup.Pitch;
+									pDestSurface += LockRect.Pitch;
+								}
 							}
 						}
 
-						RestoreData = true;
-						surface.HasData = true;
+						if (IsLoaded)
+						{
+							RestoreData = true;
+							BackupRestored = true;
+							surface.HasData = true;
+						}
+						else
+						{
+							LOG_LIMIT(100, __FUNCTION__ << " Error: failed to unpack backup surface data! For Level: " << Level);
+						}
 					}
 					else
 					{
@@ -4964,8 +5201,12 @@ HRESULT m_IDirectDrawSurfaceX::CreateD9Surface()
 			}
 		}
 
-		// Data is no longer needed
-		LostDeviceBackup.clear();
+		// Keep backup while the surface is unchanged so the next reset does not need to store it again, surfaces
+		// the device renders to or clears are changed without the data generation changing so they are always stored
+		if (!BackupRestored || IsSurface3D() || IsDepthStencil() || IsPrimaryOrBackBuffer())
+		{
+			LostDeviceBackup.clear();
+		}
 	}
 
 	// Delete emulatd surface if not needed
@@ -5082,10 +5323,7 @@ HRESULT m_IDirectDrawSurfaceX::CreateDCSurface()
 			// Save current emulated surface and prepare for creating a new one.
 			if (ShareEmulatedMemory)
 			{
-				SetCriticalSection();
-				memorySurfaces.push_back(surface.emu);
-				surface.emu = nullptr;
-				ReleaseCriticalSection();
+				ReturnSharedEmulatedMemory(&surface.emu);
 			}
 			else
 			{
@@ -5097,21 +5335,7 @@ HRESULT m_IDirectDrawSurfaceX::CreateDCSurface()
 	// If sharing memory than check the shared memory vector for a surface that matches
 	if (ShareEmulatedMemory)
 	{
-		SetCriticalSection();
-		for (auto it = memorySurfaces.begin(); it != memorySurfaces.end(); it++)
-		{
-			EMUSURFACE* pEmuSurface = *it;
-
-			if (DoesDCMatch(pEmuSurface))
-			{
-				surface.emu = pEmuSurface;
-
-				it = memorySurfaces.erase(it);
-
-				break;
-			}
-		}
-		ReleaseCriticalSection();
+		surface.emu = CheckoutSharedEmulatedMemory(Width, Height, surface.BitCount, surface.Format, Pitch);
 
 		if (surface.emu && surface.emu->pBits)
 		{
@@ -5455,6 +5679,73 @@ void m_IDirectDrawSurfaceX::ReleaseD9AuxiliarySurfaces()
 	surface.RecreateAuxiliarySurfaces = true;
 }
 
+// Store surface data for lost device backup, uniform surfaces only keep one row and everything else is compressed
+void m_IDirectDrawSurfaceX::StoreBackupData(DDBACKUP& Backup, const BYTE* pBits)
+{
+	Backup.IsRepeatedRow = false;
+	Backup.IsCompressed = false;
+
+	// Check if all rows are the same
+	if (Backup.Pitch && Backup.Size > Backup.Pitch && Backup.Size % Backup.Pitch == 0)
+	{
+		bool IsRepeatedRow = true;
+		for (const BYTE* pRow = pBits + Backup.Pitch; pRow < pBits + Backup.Size; pRow += Backup.Pitch)
+		{
+			if (memcmp(pRow, pBits, Backup.Pitch) != 0)
+			{
+				IsRepeatedRow = false;
+				break;
+			}
+		}
+		if (IsRepeatedRow)
+		{
+			Backup.IsRepeatedRow = true;
+			Backup.Bits.assign(pBits, pBits + Backup.Pitch);
+			return;
+		}
+	}
+
+	// Compress surface data, data that does not compress is stored as is
+	Backup.Bits.resize(Backup.Size);
+	size_t CompressedSize = Utils::LZ4Compress(pBits, Backup.Size, Backup.Bits.data(), Backup.Bits.size());
+	if (CompressedSize)
+	{
+		Backup.IsCompressed = true;
+		std::vector<byte>(Backup.Bits.begin(), Backup.Bits.begin() + CompressedSize).swap(Backup.Bits);
+	}
+	else
+	{
+		memcpy(Backup.Bits.data(), pBits, Backup.Size);
+	}
+}
+
+// Unpack lost device backup, pBits needs room for the full surface data
+bool m_IDirectDrawSurfaceX::LoadBackupData(const DDBACKUP& Backup, BYTE* pBits)
+{
+	if (Backup.IsRepeatedRow)
+	{
+		if (Backup.Bits.size() != Backup.Pitch)
+		{
+			return false;
+		}
+		for (DWORD x = 0; x < Backup.Size; x += Backup.Pitch)
+		{
+			memcpy(pBits + x, Backup.Bits.data(), Backup.Pitch);
+		}
+		return true;
+	}
+	if (Backup.IsCompressed)
+	{
+		return Utils::LZ4Decompress(Backup.Bits.data(), Backup.Bits.size(), pBits, Backup.Size);
+	}
+	if (Backup.Bits.size() != Backup.Size)
+	{
+		return false;
+	}
+	memcpy(pBits, Backup.Bits.data(), Backup.Size);
+	return true;
+}
+
 // Release surface and vertext buffer
 void m_IDirectDrawSurfaceX::ReleaseD9Surface(bool BackupData, bool ResetSurface)
 {
@@ -5500,14 +5791,19 @@ void m_IDirectDrawSurfaceX::ReleaseD9Surface(bool BackupData, bool ResetSurface)
 		{
 			IsSurfaceLost = true;
 
-			if (!IsUsingEmulation() && LostDeviceBackup.empty())
+			// Only store surfaces that changed since the last backup
+			if (!IsUsingEmulation() && (LostDeviceBackup.empty() || LostDeviceBackupGeneration != DataGeneration))
 			{
+				LostDeviceBackup.clear();
+
+				bool IsBackupComplete = true;
 				for (UINT Level = 0; Level < ((IsMipMapAutogen() || !MaxMipMapLevel) ? 1 : MaxMipMapLevel); Level++)
 				{
 					D3DLOCKED_RECT LockRect = {};
 					if (FAILED(LockD3d9Surface(&LockRect, nullptr, D3DLOCK_READONLY | D3DLOCK_NOSYSLOCK, Level)))
 					{
 						LOG_LIMIT(100, __FUNCTION__ << " Error: failed to backup surface data!");
+						IsBackupComplete = false;
 						break;
 					}
 
@@ -5515,6 +5811,8 @@ void m_IDirectDrawSurfaceX::ReleaseD9Surface(bool BackupData, bool ResetSurface)
 					if (FAILED(surface.Surface ? surface.Surface->GetDesc(&Desc) : surface.Texture->GetLevelDesc(GetD3d9MipMapLevel(Level), &Desc)))
 					{
 						LOG_LIMIT(100, __FUNCTION__ << " Error: failed to get surface desc!");
+						UnLockD3d9Surface(Level);
+						IsBackupComplete = false;
 						break;
 					}
 
@@ -5530,13 +5828,16 @@ void m_IDirectDrawSurfaceX::ReleaseD9Surface(bool BackupData, bool ResetSurface)
 						LostDeviceBackup[Level].Width = Desc.Width;
 						LostDeviceBackup[Level].Height = Desc.Height;
 						LostDeviceBackup[Level].Pitch = LockRect.Pitch;
-						LostDeviceBackup[Level].Bits.resize(size);
+						LostDeviceBackup[Level].Size = size;
 
-						memcpy(LostDeviceBackup[Level].Bits.data(), LockRect.pBits, size);
+						StoreBackupData(LostDeviceBackup[Level], (BYTE*)LockRect.pBits);
 					}
 
 					UnLockD3d9Surface(Level);
 				}
+
+				// A partial backup never matches the data generation so it is taken again next time
+				LostDeviceBackupGeneration = IsBackupComplete ? DataGeneration : DataGeneration - 1;
 			}
 		}
 	}
@@ -5608,10 +5909,7 @@ inline void m_IDirectDrawSurfaceX::ReleaseDCSurface()
 		}
 		else
 		{
-			SetCriticalSection();
-			memorySurfaces.push_back(surface.emu);
-			surface.emu = nullptr;
-			ReleaseCriticalSection();
+			ReturnSharedEmulatedMemory(&surface.emu);
 		}
 	}
 }
@@ -5657,6 +5955,12 @@ HRESULT m_IDirectDrawSurfaceX::PresentSurface(bool IsSkipScene)
 	if (IsSurfaceBusy())
 	{
 		Logging::LogDebug() << __FUNCTION__ << " Surface is busy!";
+
+		// The present thread draws the surface once it is no longer busy
+		if (ddrawParent->IsUsingThreadPresent())
+		{
+			ddrawParent->SetPresentPending();
+		}
 		return DDERR_SURFACEBUSY;
 	}
 
@@ -6028,8 +6332,12 @@ void m_IDirectDrawSurfaceX::SetRenderTargetShadow()
 }
 
 // Set dirty flag
-void m_IDirectDrawSurfaceX::SetDirtyFlag(DWORD MipMapLevel)
+void m_IDirectDrawSurfaceX::SetDirtyFlag(DWORD MipMapLevel, LPRECT lpDestRect)
 {
+	// Lost device backup no longer matches the surface data
+	DataGeneration++;
+	LostDeviceBackup.clear();
+
 	if (MipMapLevel == 0)
 	{
 		if (IsPrimarySurface() && ddrawParent && !ddrawParent->IsInScene())
@@ -6038,11 +6346,27 @@ void m_IDirectDrawSurfaceX::SetDirtyFlag(DWORD MipMapLevel)
 		}
 		surface.IsDirtyFlag = true;
 		surface.HasData = true;
+
+		// Add changed area to the draw texture dirty rect
+		RECT DirtyRect = {};
+		if (!CheckCoordinates(DirtyRect, lpDestRect, &surfaceDesc2))
+		{
+			CheckCoordinates(DirtyRect, nullptr, &surfaceDesc2);
+		}
+		if (surface.IsDrawTextureDirty)
+		{
+			surface.DrawTextureDirtyRect.left = min(surface.DrawTextureDirtyRect.left, DirtyRect.left);
+			surface.DrawTextureDirtyRect.top = min(surface.DrawTextureDirtyRect.top, DirtyRect.top);
+			surface.DrawTextureDirtyRect.right = max(surface.DrawTextureDirtyRect.right, DirtyRect.right);
+			surface.DrawTextureDirtyRect.bottom = max(surface.DrawTextureDirtyRect.bottom, DirtyRect.bottom);
+		}
+		else
+		{
+			surface.DrawTextureDirtyRect = DirtyRect;
+		}
 		surface.IsDrawTextureDirty = true;
 		IsMipMapReadyToUse = (IsMipMapAutogen() || MipMaps.empty());
 
-		LostDeviceBackup.clear();
-
 		// Update Uniqueness Value
 		ChangeUniquenessValue();
 	}
@@ -6052,6 +6376,14 @@ void m_IDirectDrawSurfaceX::SetDirtyFlag(DWORD MipMapLevel)
 		if (MipMapLevel && MipMapLevel <= MipMaps.size())
 		{
 			MipMaps[MipMapLevel - 1].UniquenessValue = UniquenessValue;
+			MipMaps[MipMapLevel - 1].IsGenerated = false;
+
+			// Generated levels below this one were built from the old data
+			for (UINT x = MipMapLevel; x < MipMaps.size() && MipMaps[x].IsGenerated; x++)
+			{
+				MipMaps[x].UniquenessValue = 0;
+				IsMipMapReadyToUse = false;
+			}
 		}
 		CheckMipMapLevelGen();
 	}
@@ -6263,11 +6595,15 @@ void m_IDirectDrawSurfaceX::AddAttachedSurfaceToMap(m_IDirectDrawSurfaceX* lpSur
 	}
 
 	// Store surface
-	AttachedSurfaceMap[++MapKey].pSurface = lpSurfaceX;
+	ATTACHEDMAP& Entry = AttachedSurfaceMap[++MapKey];
+	Entry.pSurface = lpSurfaceX;
 	if (MarkAttached)
 	{
-		AttachedSurfaceMap[MapKey].isAttachedSurfaceAdded = true;
+		Entry.isAttachedSurfaceAdded = true;
 	}
+
+	// Reset cached flip surface
+	IsFlipBackBufferSet = false;
 }
 
 // Remove attached surface from map
@@ -6279,14 +6615,39 @@ void m_IDirectDrawSurfaceX::RemoveAttachedSurfaceFromMap(m_IDirectDrawSurfaceX*
 	}
 
 	auto it = std::find_if(AttachedSurfaceMap.begin(), AttachedSurfaceMap.end(),
-		[=](auto Map) -> bool { return Map.second.pSurface == lpSurfaceX; });
+		[=](const auto& Map) -> bool { return Map.second.pSurface == lpSurfaceX; });
 
 	if (it != std::end(AttachedSurfaceMap))
 	{
 		AttachedSurfaceMap.erase(it);
+
+		// Reset cached flip surface
+		IsFlipBackBufferSet = false;
 	}
 }
 
+// Get first attached surface with flip caps
+m_IDirectDrawSurfaceX* m_IDirectDrawSurfaceX::GetFlipBackBuffer()
+{
+	if (!IsFlipBackBufferSet)
+	{
+		FlipBackBuffer = nullptr;
+
+		// Loop through each surface
+		for (auto& it : AttachedSurfaceMap)
+		{
+			if (it.second.pSurface && (it.second.pSurface->GetSurfaceCaps().dwCaps & DDSCAPS_FLIP))
+			{
+				FlipBackBuffer = it.second.pSurface;
+				break;
+			}
+		}
+		IsFlipBackBufferSet = true;
+	}
+
+	return FlipBackBuffer;
+}
+
 // Check if attached surface exists
 bool m_IDirectDrawSurfaceX::DoesAttachedSurfaceExist(m_IDirectDrawSurfaceX* lpSurfaceX)
 {
@@ -6296,7 +6657,7 @@ bool m_IDirectDrawSurfaceX::DoesAttachedSurfaceExist(m_IDirectDrawSurfaceX* lpSu
 	}
 
 	return (std::find_if(AttachedSurfaceMap.begin(), AttachedSurfaceMap.end(),
-		[=](auto Map) -> bool { return Map.second.pSurface == lpSurfaceX; }) != std::end(AttachedSurfaceMap));
+		[=](const auto& Map) -> bool { return Map.second.pSurface == lpSurfaceX; }) != std::end(AttachedSurfaceMap));
 }
 
 bool m_IDirectDrawSurfaceX::WasAttachedSurfaceAdded(m_IDirectDrawSurfaceX* lpSurfaceX)
@@ -6307,7 +6668,7 @@ bool m_IDirectDrawSurfaceX::WasAttachedSurfaceAdded(m_IDirectDrawSurfaceX* lpSur
 	}
 
 	return (std::find_if(AttachedSurfaceMap.begin(), AttachedSurfaceMap.end(),
-		[=](auto Map) -> bool { return (Map.second.pSurface == lpSurfaceX) && Map.second.isAttachedSurfaceAdded; }) != std::end(AttachedSurfaceMap));
+		[=](const auto& Map) -> bool { return (Map.second.pSurface == lpSurfaceX) && Map.second.isAttachedSurfaceAdded; }) != std::end(AttachedSurfaceMap));
 }
 
 // Check if backbuffer surface exists
@@ -6318,22 +6679,10 @@ bool m_IDirectDrawSurfaceX::DoesFlipBackBufferExist(m_IDirectDrawSurfaceX* lpSur
 		return false;
 	}
 
-	DWORD dwCaps = 0;
-	m_IDirectDrawSurfaceX *lpTargetSurface = nullptr;
-
-	// Loop through each surface
-	for (auto& it : AttachedSurfaceMap)
-	{
-		if (it.second.pSurface && (it.second.pSurface->GetSurfaceCaps().dwCaps & DDSCAPS_FLIP))
-		{
-			lpTargetSurface = it.second.pSurface;
-
-			break;
-		}
-	}
+	m_IDirectDrawSurfaceX *lpTargetSurface = GetFlipBackBuffer();
 
 	// Check if attached surface was not found
-	if (!lpTargetSurface || (dwCaps & DDSCAPS_FRONTBUFFER))
+	if (!lpTargetSurface || (lpTargetSurface->GetSurfaceCaps().dwCaps & DDSCAPS_FRONTBUFFER))
 	{
 		return false;
 	}
@@ -6501,24 +6850,20 @@ HRESULT m_IDirectDrawSurfaceX::ColorFill(RECT* pRect, D3DCOLOR dwFillColor, DWOR
 // Save DXT data as a DDS file
 HRESULT m_IDirectDrawSurfaceX::SaveDXTDataToDDS(const void *data, size_t dataSize, const char *filename, int dxtVersion) const
 {
-	int blockSize = 0;
-	DWORD fourCC = 0;
+	D3DFORMAT Format = D3DFMT_UNKNOWN;
 
 	switch(dxtVersion)
 	{
 	case 1:
-		blockSize = 8;
-		fourCC = '1TXD';
+		Format = D3DFMT_DXT1;
 		break;
 
 	case 3:
-		blockSize = 16;
-		fourCC = '3TXD';
+		Format = D3DFMT_DXT3;
 		break;
 
 	case 5:
-		blockSize = 16;
-		fourCC = '5TXD';
+		Format = D3DFMT_DXT5;
 		break;
 
 	default:
@@ -6526,40 +6871,42 @@ HRESULT m_IDirectDrawSurfaceX::SaveDXTDataToDDS(const void *data, size_t dataSiz
 		return D3DERR_INVALIDCALL;
 	}
 
-	std::ofstream outFile(filename, std::ios::binary | std::ios::out);
-	if (outFile.is_open())
+	// Check that the data holds the top level of the surface
+	const DWORD BlockSize = (Format == D3DFMT_DXT1) ? 8 : 16;
+	const LONG Pitch = max((DWORD)1, (surfaceDesc2.dwWidth + 3) / 4) * BlockSize;
+	if (!data || dataSize < (size_t)Pitch * max((DWORD)1, (surfaceDesc2.dwHeight + 3) / 4))
 	{
-		DDS_HEADER header = {};
-		header.dwSize = sizeof(DDS_HEADER);
-		header.dwFlags = DDSD_CAPS | DDSD_HEIGHT | DDSD_WIDTH | DDSD_PIXELFORMAT | DDSD_LINEARSIZE;
-		header.dwHeight = surfaceDesc2.dwHeight;
-		header.dwWidth = surfaceDesc2.dwHeight;
-		header.dwPitchOrLinearSize = max(1, (surfaceDesc2.dwWidth + 3) / 4) * blockSize;  // 8 for DXT1, 16 for others
-		header.dwDepth = 0;
-		header.dwMipMapCount = 0;
-		header.ddspf.dwSize = sizeof(DDS_PIXELFORMAT);
-		header.ddspf.dwFlags = DDPF_FOURCC;
-		header.ddspf.dwFourCC = fourCC;
-		header.dwCaps = DDSCAPS_TEXTURE;// | DDSCAPS_COMPLEX | DDSCAPS_MIPMAP;
-		header.dwCaps2 = 0x00000000;
-		header.dwCaps3 = 0x00000000;
-		header.dwCaps4 = 0x00000000;
-		header.dwReserved2 = 0;
-
-		outFile.write("DDS ", 4);
-		outFile.write((char*)&header, sizeof(DDS_HEADER));
-		outFile.write((char*)data, dataSize);
-		outFile.close();
+		Logging::Log() << __FUNCTION__ << " Error: DXT data is too small!";
+		return D3DERR_INVALIDCALL;
+	}
 
-		return D3D_OK;
+	if (!QueueSurfaceDump(filename, D3DXIFF_DDS, Format, data, Pitch, surfaceDesc2.dwWidth, surfaceDesc2.dwHeight, nullptr))
+	{
+		return DDERR_GENERIC;
 	}
 
-	return DDERR_GENERIC;
+	return D3D_OK;
 }
 
 // Save a surface for debugging
 HRESULT m_IDirectDrawSurfaceX::SaveSurfaceToFile(const char *filename, D3DXIMAGE_FILEFORMAT format)
 {
+	// Copy the surface and let the dump thread convert and write it
+	if (IsSurfaceDumpSupported(format, surface.Format) && (!IsPalette() || surface.PaletteEntryArray))
+	{
+		D3DLOCKED_RECT LockRect = {};
+		if (SUCCEEDED(IsUsingEmulation() ? LockEmulatedSurface(&LockRect, nullptr) :
+			LockD3d9Surface(&LockRect, nullptr, D3DLOCK_READONLY | D3DLOCK_NOSYSLOCK, 0)) && LockRect.pBits)
+		{
+			bool IsQueued = QueueSurfaceDump(filename, format, surface.Format, LockRect.pBits, LockRect.Pitch, surfaceDesc2.dwWidth, surfaceDesc2.dwHeight, surface.PaletteEntryArray);
+
+			IsUsingEmulation() ? DD_OK : UnLockD3d9Surface(0);
+
+			// A dump dropped because the queue is full is not written here, that would stall the calling thread
+			return IsQueued ? D3D_OK : DDERR_GENERIC;
+		}
+	}
+
 	LPD3DXBUFFER pDestBuf = nullptr;
 	HRESULT hr = D3DXSaveSurfaceToFileInMemory(&pDestBuf, format, Get3DSurface(), nullptr, nullptr);
 
@@ -6580,54 +6927,96 @@ HRESULT m_IDirectDrawSurfaceX::SaveSurfaceToFile(const char *filename, D3DXIMAGE
 	return hr;
 }
 
-// Simple copy with ColorKey and Mirroring
+// Batch blit kernels, the color key is stored in the low bytes
 template <typename T>
-void SimpleColorKeyCopy(T ColorKey, BYTE* SrcBuffer, BYTE* DestBuffer, INT SrcPitch, INT DestPitch, LONG DestRectWidth, LONG DestRectHeight, bool IsColorKey, bool IsMirrorLeftRight)
+static void BltBatchCopy(DWORD, const BYTE* SrcBuffer, BYTE* DestBuffer, INT SrcPitch, INT DestPitch, LONG Width, LONG Height)
 {
-	T* SrcBufferLoop = reinterpret_cast<T*>(SrcBuffer);
-	T* DestBufferLoop = reinterpret_cast<T*>(DestBuffer);
-
-	for (LONG y = 0; y < DestRectHeight; y++)
-	{
-		for (LONG x = 0; x < DestRectWidth; x++)
-		{
-			T PixelColor = SrcBufferLoop[IsMirrorLeftRight ? DestRectWidth - x - 1 : x];
-			if (!IsColorKey || PixelColor != ColorKey)
-			{
-				DestBufferLoop[x] = PixelColor;
-			}
-		}
-		SrcBufferLoop = reinterpret_cast<T*>((BYTE*)SrcBufferLoop + SrcPitch);
-		DestBufferLoop = reinterpret_cast<T*>((BYTE*)DestBufferLoop + DestPitch);
-	}
+	CopySurfaceRows(DestBuffer, DestPitch, SrcBuffer, SrcPitch, Width * sizeof(T), Height, false);
 }
 
-// Copy memory (complex)
 template <typename T>
-void ComplexCopy(T ColorKey, D3DLOCKED_RECT SrcLockRect, D3DLOCKED_RECT DestLockRect, LONG SrcRectWidth, LONG SrcRectHeight, LONG DestRectWidth, LONG DestRectHeight, bool IsColorKey, bool IsMirrorUpDown, bool IsMirrorLeftRight)
+static void BltBatchColorKeyCopy(DWORD ColorKey, const BYTE* SrcBuffer, BYTE* DestBuffer, INT SrcPitch, INT DestPitch, LONG Width, LONG Height)
 {
-	float WidthRatio = ((float)SrcRectWidth / (float)DestRectWidth);
-	float HeightRatio = ((float)SrcRectHeight / (float)DestRectHeight);
+	BlitSurfaceRect(DestBuffer, DestPitch, Width, Height, SrcBuffer, SrcPitch, Width, Height, sizeof(T), true, ColorKey, false, false);
+}
 
-	T* SrcBufferLoop = reinterpret_cast<T*>(SrcLockRect.pBits);
-	T* DestBufferLoop = reinterpret_cast<T*>(DestLockRect.pBits);
+// Check if the surface can stay locked for a whole blit batch, these surfaces are always copied with the CPU by CopySurface
+bool m_IDirectDrawSurfaceX::CanBltBatchDirect() const
+{
+	return (IsUsingEmulation() || surface.UsingSurfaceMemory ||
+		(surface.Pool != D3DPOOL_DEFAULT && !IsUsingShadowSurface() && !(surface.Usage & D3DUSAGE_RENDERTARGET) && surface.Type != D3DTYPE_DEPTHSTENCIL)) &&
+		(surface.BitCount == 8 || surface.BitCount == 16 || surface.BitCount == 24 || surface.BitCount == 32) &&
+		!ISDXTEX(surface.Format) && !IsSurfaceLocked() && !IsLockedFromOtherThread();
+}
+
+// Get the kernel and rects for a batch entry, returns false if the entry needs to go through Blt
+bool m_IDirectDrawSurfaceX::GetBltBatchEntry(const DDBLTBATCH& Batch, BLTBATCHENTRY& Entry)
+{
+	const DWORD dwFlags = Batch.dwFlags;
 
-	for (LONG y = 0; y < DestRectHeight; y++)
+	// Only plain copies and source color key copies
+	if (!Batch.lpDDSSrc || (dwFlags & ~(DDBLT_WAIT | DDBLT_DONOTWAIT | DDBLT_ASYNC | DDBLT_KEYSRC | DDBLT_KEYSRCOVERRIDE | DDBLT_ROP)) ||
+		((dwFlags & DDBLT_ROP) && Batch.lpDDBltFx->dwROP != SRCCOPY))
 	{
-		for (LONG x = 0; x < DestRectWidth; x++)
-		{
-			DWORD sx = (DWORD)((float)x * WidthRatio);
-			T PixelColor = SrcBufferLoop[IsMirrorLeftRight ? SrcRectWidth - sx - 1 : sx];
+		return false;
+	}
 
-			if (!IsColorKey || PixelColor != ColorKey)
-			{
-				DestBufferLoop[x] = PixelColor;
-			}
+	m_IDirectDrawSurfaceX* pSourceSurface = nullptr;
+	DWORD SrcMipMapLevel = 0;
+	Batch.lpDDSSrc->QueryInterface(IID_GetInterfaceX, (LPVOID*)&pSourceSurface);
+	Batch.lpDDSSrc->QueryInterface(IID_GetMipMapLevel, (LPVOID*)&SrcMipMapLevel);
+	if (!pSourceSurface || pSourceSurface == this || SrcMipMapLevel || pSourceSurface->GetSurfaceFormat() != GetSurfaceFormat() ||
+		!pSourceSurface->CanBltBatchDirect())
+	{
+		return false;
+	}
+
+	// Get color key
+	const bool IsColorKey = (dwFlags & (DDBLT_KEYSRC | DDBLT_KEYSRCOVERRIDE)) != 0;
+	DWORD ColorKey = 0;
+	if (dwFlags & DDBLT_KEYSRCOVERRIDE)
+	{
+		ColorKey = Batch.lpDDBltFx->ddckSrcColorkey.dwColorSpaceLowValue;
+	}
+	else if (dwFlags & DDBLT_KEYSRC)
+	{
+		if (!(pSourceSurface->surfaceDesc2.dwFlags & DDSD_CKSRCBLT))
+		{
+			return false;
 		}
-		DWORD sx = (DWORD)((float)(y + 1) * HeightRatio);
-		SrcBufferLoop = reinterpret_cast<T*>((BYTE*)SrcLockRect.pBits + SrcLockRect.Pitch * (IsMirrorUpDown ? SrcRectHeight - sx - 1 : sx));
-		DestBufferLoop = reinterpret_cast<T*>((BYTE*)DestBufferLoop + DestLockRect.Pitch);
+		ColorKey = pSourceSurface->surfaceDesc2.ddckCKSrcBlt.dwColorSpaceLowValue;
 	}
+
+	// GDI translates palette surfaces through their color tables when copying with BitBlt
+	if (!IsColorKey && IsPalette() && IsEmulationDCReady() && pSourceSurface->IsEmulationDCReady())
+	{
+		return false;
+	}
+
+	// Rects must be inside both surfaces and the same size, stretching and clipping is left to Blt
+	RECT SrcRect = (Batch.lprSrc) ? *Batch.lprSrc : RECT{ 0, 0, (LONG)pSourceSurface->surfaceDesc2.dwWidth, (LONG)pSourceSurface->surfaceDesc2.dwHeight };
+	RECT DestRect = (Batch.lprDest) ? *Batch.lprDest : RECT{ 0, 0, (LONG)surfaceDesc2.dwWidth, (LONG)surfaceDesc2.dwHeight };
+	if (SrcRect.left < 0 || SrcRect.top < 0 || SrcRect.right > (LONG)pSourceSurface->surfaceDesc2.dwWidth || SrcRect.bottom > (LONG)pSourceSurface->surfaceDesc2.dwHeight ||
+		DestRect.left < 0 || DestRect.top < 0 || DestRect.right > (LONG)surfaceDesc2.dwWidth || DestRect.bottom > (LONG)surfaceDesc2.dwHeight ||
+		SrcRect.right <= SrcRect.left || SrcRect.bottom <= SrcRect.top ||
+		SrcRect.right - SrcRect.left != DestRect.right - DestRect.left || SrcRect.bottom - SrcRect.top != DestRect.bottom - DestRect.top)
+	{
+		return false;
+	}
+
+	static void (* const Kernels[4][2])(DWORD, const BYTE*, BYTE*, INT, INT, LONG, LONG) = {
+		{ BltBatchCopy<BYTE>, BltBatchColorKeyCopy<BYTE> },
+		{ BltBatchCopy<WORD>, BltBatchColorKeyCopy<WORD> },
+		{ BltBatchCopy<TRIBYTE>, BltBatchColorKeyCopy<TRIBYTE> },
+		{ BltBatchCopy<DWORD>, BltBatchColorKeyCopy<DWORD> } };
+
+	Entry.pSourceSurface = pSourceSurface;
+	Entry.SrcRect = SrcRect;
+	Entry.DestRect = DestRect;
+	Entry.ColorKey = ColorKey;
+	Entry.Kernel = Kernels[surface.BitCount / 8 - 1][IsColorKey];
+
+	return true;
 }
 
 // Copy surface
@@ -6823,12 +7212,7 @@ HRESULT m_IDirectDrawSurfaceX::CopySurface(m_IDirectDrawSurfaceX* pSourceSurface
 						BYTE* SrcBytes = (BYTE*)SrcLockedRect.pBits;
 						BYTE* DestBytes = (BYTE*)DestLockedRect.pBits;
 						size_t Size = DestRectWidth * surface.BitCount / 8;
-						for (int x = 0; x < DestRectHeight ; x++)
-						{
-							memcpy(DestBytes, SrcBytes, Size);
-							SrcBytes += SrcLockedRect.Pitch;
-							DestBytes += DestLockedRect.Pitch;
-						}
+						CopySurfaceRows(DestBytes, DestLockedRect.Pitch, SrcBytes, SrcLockedRect.Pitch, Size, DestRectHeight, true);
 
 						surface.Shadow->UnlockRect();
 						pSourceSurfaceD9->UnlockRect();
@@ -6874,6 +7258,93 @@ HRESULT m_IDirectDrawSurfaceX::CopySurface(m_IDirectDrawSurfaceX* pSourceSurface
 				LOG_LIMIT(100, __FUNCTION__ << " Warning: mirroring not supported with DirectX textures!");
 			}
 
+			// Decode DXT textures to 32-bit surfaces without going through D3DX, premultiplied alpha formats are left to D3DX
+			if ((SrcFormat == D3DFMT_DXT1 || SrcFormat == D3DFMT_DXT3 || SrcFormat == D3DFMT_DXT5) && (DestFormat == D3DFMT_X8R8G8B8 || DestFormat == D3DFMT_A8R8G8B8) && !IsStretchRect)
+			{
+				// DXT surfaces can only be locked on block boundaries
+				RECT BlockRect = { SrcRect.left & ~3, SrcRect.top & ~3,
+					min((SrcRect.right + 3) & ~3, (LONG)SrcDesc2.dwWidth), min((SrcRect.bottom + 3) & ~3, (LONG)SrcDesc2.dwHeight) };
+				LONG BlockRectWidth = BlockRect.right - BlockRect.left;
+				LONG BlockRectHeight = BlockRect.bottom - BlockRect.top;
+
+				do {
+					D3DLOCKED_RECT DXTLockRect = {};
+					if (FAILED(pSourceSurface->LockD3d9Surface(&DXTLockRect, &BlockRect, D3DLOCK_READONLY | D3DLOCK_NOSYSLOCK, SrcMipMapLevel)) || !DXTLockRect.pBits)
+					{
+						LOG_LIMIT(100, __FUNCTION__ << " Error: could not lock source texture " << BlockRect);
+						break;
+					}
+
+					size_t size = BlockRectWidth * BlockRectHeight * sizeof(DWORD);
+					if (size > ByteArray.size())
+					{
+						ByteArray.resize(size);
+					}
+					bool IsDecoded = DecodeDXT(SrcFormat, DXTLockRect.pBits, DXTLockRect.Pitch, ByteArray.data(), BlockRectWidth * sizeof(DWORD), BlockRectWidth, BlockRectHeight);
+
+					pSourceSurface->UnLockD3d9Surface(SrcMipMapLevel);
+
+					if (!IsDecoded || FAILED(IsUsingEmulation() ? LockEmulatedSurface(&DestLockRect, &DestRect) :
+						LockD3d9Surface(&DestLockRect, &DestRect, D3DLOCK_NOSYSLOCK, MipMapLevel)) || !DestLockRect.pBits)
+					{
+						LOG_LIMIT(100, __FUNCTION__ << " Error: could not decode to destination surface " << DestRect);
+						break;
+					}
+					UnlockDest = true;
+
+					BYTE* SrcBuffer = ByteArray.data() + ((SrcRect.top - BlockRect.top) * BlockRectWidth + (SrcRect.left - BlockRect.left)) * sizeof(DWORD);
+					BYTE* DestBuffer = (BYTE*)DestLockRect.pBits;
+					for (LONG y = 0; y < DestRectHeight; y++)
+					{
+						memcpy(DestBuffer, SrcBuffer, DestRectWidth * sizeof(DWORD));
+						SrcBuffer += BlockRectWidth * sizeof(DWORD);
+						DestBuffer += DestLockRect.Pitch;
+					}
+					hr = DD_OK;
+
+				} while (false);
+
+				if (SUCCEEDED(hr))
+				{
+					break;
+				}
+			}
+
+			// Encode 32-bit surfaces to DXT textures, the destination rect must start on a block and end on a block or the surface edge
+			if ((DestFormat == D3DFMT_DXT1 || DestFormat == D3DFMT_DXT3 || DestFormat == D3DFMT_DXT5) && (SrcFormat == D3DFMT_X8R8G8B8 || SrcFormat == D3DFMT_A8R8G8B8) && !IsStretchRect &&
+				!(DestRect.left & 3) && !(DestRect.top & 3) &&
+				(!(DestRect.right & 3) || DestRect.right == (LONG)DestDesc2.dwWidth) && (!(DestRect.bottom & 3) || DestRect.bottom == (LONG)DestDesc2.dwHeight))
+			{
+				do {
+					D3DLOCKED_RECT SrcLockRect = {};
+					if (FAILED(pSourceSurface->IsUsingEmulation() ? pSourceSurface->LockEmulatedSurface(&SrcLockRect, &SrcRect) :
+						pSourceSurface->LockD3d9Surface(&SrcLockRect, &SrcRect, D3DLOCK_READONLY | D3DLOCK_NOSYSLOCK, SrcMipMapLevel)) || !SrcLockRect.pBits)
+					{
+						LOG_LIMIT(100, __FUNCTION__ << " Error: could not lock source surface " << SrcRect);
+						break;
+					}
+					UnlockSrc = true;
+
+					if (FAILED(LockD3d9Surface(&DestLockRect, &DestRect, D3DLOCK_NOSYSLOCK, MipMapLevel)) || !DestLockRect.pBits)
+					{
+						LOG_LIMIT(100, __FUNCTION__ << " Error: could not lock destination texture " << DestRect);
+						break;
+					}
+					UnlockDest = true;
+
+					if (EncodeDXT(DestFormat, SrcLockRect.pBits, SrcLockRect.Pitch, SrcFormat == D3DFMT_A8R8G8B8, DestLockRect.pBits, DestLockRect.Pitch, DestRectWidth, DestRectHeight))
+					{
+						hr = DD_OK;
+					}
+
+				} while (false);
+
+				if (SUCCEEDED(hr) || UnlockSrc || UnlockDest)
+				{
+					break;
+				}
+			}
+
 			if (IsUsingEmulation())
 			{
 				LOG_LIMIT(100, __FUNCTION__ << " Error: copying DirectX textures to emulated surfaces is not supported!");
@@ -7006,6 +7477,39 @@ HRESULT m_IDirectDrawSurfaceX::CopySurface(m_IDirectDrawSurfaceX* pSourceSurface
 			break;
 		}
 
+		// Copy in place when the source and destination are the same surface, this skips the memory cache
+		if (pSourceSurface == this && MipMapLevel == SrcMipMapLevel && !IsStretchRect && CanBlitInPlace(SrcRect, DestRect, IsMirrorUpDown))
+		{
+			// Lock the area that holds both rects
+			RECT LockRect = { min(SrcRect.left, DestRect.left), min(SrcRect.top, DestRect.top), max(SrcRect.right, DestRect.right), max(SrcRect.bottom, DestRect.bottom) };
+			if (FAILED(IsUsingEmulation() ? LockEmulatedSurface(&DestLockRect, &LockRect) :
+				LockD3d9Surface(&DestLockRect, &LockRect, D3DLOCK_NOSYSLOCK, MipMapLevel)) || !DestLockRect.pBits)
+			{
+				LOG_LIMIT(100, __FUNCTION__ << " Error: could not lock surface " << LockRect);
+				hr = (IsSurfaceLocked()) ? DDERR_SURFACEBUSY : DDERR_GENERIC;
+				break;
+			}
+			UnlockDest = true;
+
+			RECT InPlaceSrcRect = SrcRect, InPlaceDestRect = DestRect;
+			OffsetRect(&InPlaceSrcRect, -LockRect.left, -LockRect.top);
+			OffsetRect(&InPlaceDestRect, -LockRect.left, -LockRect.top);
+
+			// Only mirrored rows that are on the same line need a row buffer
+			if (IsMirrorLeftRight && ByteArray.size() < DestRectWidth * ByteCount)
+			{
+				ByteArray.resize(DestRectWidth * ByteCount);
+			}
+
+			BlitInPlace(DestLockRect.pBits, DestLockRect.Pitch, ByteCount, InPlaceSrcRect, InPlaceDestRect, IsColorKey, ColorKey, IsMirrorLeftRight, IsMirrorUpDown, ByteArray.data());
+
+			// Point lock at the destination rect for removing scanlines
+			DestLockRect.pBits = (BYTE*)DestLockRect.pBits + InPlaceDestRect.top * DestLockRect.Pitch + InPlaceDestRect.left * ByteCount;
+
+			hr = DD_OK;
+			break;
+		}
+
 		// Check if source surface is not locked then lock it
 		D3DLOCKED_RECT SrcLockRect = {};
 		if (FAILED(pSourceSurface->IsUsingEmulation() ? pSourceSurface->LockEmulatedSurface(&SrcLockRect, &SrcRect) :
@@ -7043,12 +7547,7 @@ HRESULT m_IDirectDrawSurfaceX::CopySurface(m_IDirectDrawSurfaceX* pSourceSurface
 			}
 			else
 			{
-				for (LONG y = 0; y < SrcRectHeight; y++)
-				{
-					memcpy(DestBuffer, SrcBuffer, SrcRectWidth * ByteCount);
-					SrcBuffer += SrcLockRect.Pitch;
-					DestBuffer += DestPitch;
-				}
+				CopySurfaceRows(DestBuffer, DestPitch, SrcBuffer, SrcLockRect.Pitch, SrcRectWidth * ByteCount, SrcRectHeight, false);
 			}
 			SrcLockRect.pBits = ByteArray.data();
 			SrcLockRect.Pitch = DestPitch;
@@ -7084,64 +7583,23 @@ HRESULT m_IDirectDrawSurfaceX::CopySurface(m_IDirectDrawSurfaceX* pSourceSurface
 		// Simple memory copy (QuickCopy)
 		if (!IsStretchRect && !IsColorKey && !IsMirrorLeftRight)
 		{
+			// Emulated surfaces are read back when they are presented, real surfaces are only read by the GPU
+			const bool StreamDest = !IsUsingEmulation();
 			if (!IsMirrorUpDown && SrcLockRect.Pitch == DestLockRect.Pitch && (DWORD)DestRectWidth == DestDesc2.dwWidth)
 			{
-				memcpy(DestBuffer, SrcBuffer, DestRectHeight * DestPitch);
+				CopySurfaceRows(DestBuffer, DestPitch, SrcBuffer, SrcLockRect.Pitch, DestPitch, DestRectHeight, StreamDest);
 			}
 			else
 			{
-				for (LONG y = 0; y < DestRectHeight; y++)
-				{
-					memcpy(DestBuffer, SrcBuffer, DestRectWidth * ByteCount);
-					SrcBuffer += SrcLockRect.Pitch;
-					DestBuffer += DestPitch;
-				}
-			}
-			hr = DD_OK;
-			break;
-		}
-
-		// Set color variables
-		DWORD ByteMask = (ByteCount == 1) ? 0x000000FF : (ByteCount == 2) ? 0x0000FFFF : (ByteCount == 3) ? 0x00FFFFFF : 0xFFFFFFFF;
-		DWORD dColorKey = (ColorKey & ByteMask);
-
-		// Simple copy with ColorKey and Mirroring
-		if (!IsStretchRect)
-		{
-			switch (ByteCount)
-			{
-			case 1:
-				SimpleColorKeyCopy<BYTE>((BYTE)(ColorKey & ByteMask), SrcBuffer, DestBuffer, SrcLockRect.Pitch, DestPitch, DestRectWidth, DestRectHeight, IsColorKey, IsMirrorLeftRight);
-				break;
-			case 2:
-				SimpleColorKeyCopy<WORD>((WORD)(ColorKey & ByteMask), SrcBuffer, DestBuffer, SrcLockRect.Pitch, DestPitch, DestRectWidth, DestRectHeight, IsColorKey, IsMirrorLeftRight);
-				break;
-			case 3:
-				SimpleColorKeyCopy<TRIBYTE>(*reinterpret_cast<TRIBYTE*>(&dColorKey), SrcBuffer, DestBuffer, SrcLockRect.Pitch, DestPitch, DestRectWidth, DestRectHeight, IsColorKey, IsMirrorLeftRight);
-				break;
-			case 4:
-				SimpleColorKeyCopy<DWORD>((DWORD)(ColorKey & ByteMask), SrcBuffer, DestBuffer, SrcLockRect.Pitch, DestPitch, DestRectWidth, DestRectHeight, IsColorKey, IsMirrorLeftRight);
-				break;
+				CopySurfaceRows(DestBuffer, DestPitch, SrcBuffer, SrcLockRect.Pitch, DestRectWidth * ByteCount, DestRectHeight, StreamDest);
 			}
 			hr = DD_OK;
 			break;
 		}
 
-		// Copy memory (complex)
-		switch (ByteCount)
-		{
-		case 1:
-			ComplexCopy<BYTE>((BYTE)ColorKey, SrcLockRect, DestLockRect, SrcRectWidth, SrcRectHeight, DestRectWidth, DestRectHeight, IsColorKey, IsMirrorUpDown, IsMirrorLeftRight);
-			break;
-		case 2:
-			ComplexCopy<WORD>((WORD)ColorKey, SrcLockRect, DestLockRect, SrcRectWidth, SrcRectHeight, DestRectWidth, DestRectHeight, IsColorKey, IsMirrorUpDown, IsMirrorLeftRight);
-			break;
-		case 3:
-			ComplexCopy<TRIBYTE>(*reinterpret_cast<TRIBYTE*>(&dColorKey), SrcLockRect, DestLockRect, SrcRectWidth, SrcRectHeight, DestRectWidth, DestRectHeight, IsColorKey, IsMirrorUpDown, IsMirrorLeftRight);
-			break;
-		case 4:
-			ComplexCopy<DWORD>((DWORD)ColorKey, SrcLockRect, DestLockRect, SrcRectWidth, SrcRectHeight, DestRectWidth, DestRectHeight, IsColorKey, IsMirrorUpDown, IsMirrorLeftRight);
-		}
+		// Copy with color key, mirroring and stretching
+		BlitSurfaceRect(DestLockRect.pBits, DestLockRect.Pitch, DestRectWidth, DestRectHeight, SrcLockRect.pBits, SrcLockRect.Pitch, SrcRectWidth, SrcRectHeight,
+			ByteCount, IsColorKey, ColorKey, IsMirrorLeftRight, IsMirrorUpDown);
 		hr = DD_OK;
 		break;
 
@@ -7201,32 +7659,76 @@ HRESULT m_IDirectDrawSurfaceX::CopyToDrawTexture(LPRECT lpDestRect)
 		return DDERR_GENERIC;
 	}
 
-	// Get color key
-	DWORD ColorKey = 0;
-	if (surfaceDesc2.dwFlags & DDSD_CKSRCBLT)
+	// A new palette marks the whole draw texture dirty so update it before getting the rect
+	if (IsPalette())
 	{
-		if (IsPalette())
+		UpdatePaletteData();
+	}
+
+	// Only convert the area that changed
+	RECT Rect = {};
+	if (!CheckCoordinates(Rect, lpDestRect, &surfaceDesc2))
+	{
+		LOG_LIMIT(100, __FUNCTION__ << " Error: invalid rect: " << lpDestRect);
+		DestSurface->Release();
+		return DDERR_INVALIDRECT;
+	}
+
+	// Convert natively when the surface data is stored in its own format
+	D3DSURFACE_DESC Desc = {};
+	D3DFORMAT SrcFormat = SUCCEEDED(SrcSurface->GetDesc(&Desc)) ? Desc.Format : D3DFMT_UNKNOWN;
+	if (IsPalette() && (SrcFormat == D3DFMT_P8 || SrcFormat == D3DFMT_L8))
+	{
+		SrcFormat = D3DFMT_P8;
+	}
+	bool IsNativeFormat = (SrcFormat == surface.Format || SrcFormat == GetFailoverFormat(surface.Format)) &&
+		IsColorKeyConvertFormatSupported(SrcFormat) && (SrcFormat != D3DFMT_P8 || surface.PaletteEntryArray);
+
+	bool IsConverted = false;
+	if (IsNativeFormat)
+	{
+		D3DLOCKED_RECT SrcLockRect = {}, DestLockRect = {};
+		if (SUCCEEDED(SrcSurface->LockRect(&SrcLockRect, &Rect, D3DLOCK_READONLY)))
 		{
-			UpdatePaletteData();
-			if (surface.PaletteEntryArray)
+			if (SUCCEEDED(DestSurface->LockRect(&DestLockRect, &Rect, D3DLOCK_NOSYSLOCK)))
 			{
-				PALETTEENTRY PaletteEntry = surface.PaletteEntryArray[surfaceDesc2.ddckCKSrcBlt.dwColorSpaceLowValue & 0xFF];
-				ColorKey = D3DCOLOR_ARGB(PaletteEntry.peFlags, PaletteEntry.peRed, PaletteEntry.peGreen, PaletteEntry.peBlue);
+				ConvertColorKeyToAlpha(SrcFormat, SrcLockRect.pBits, SrcLockRect.Pitch, surface.PaletteEntryArray, DestLockRect.pBits, DestLockRect.Pitch,
+					Rect.right - Rect.left, Rect.bottom - Rect.top, (surfaceDesc2.dwFlags & DDSD_CKSRCBLT) != 0, surfaceDesc2.ddckCKSrcBlt.dwColorSpaceLowValue);
+				DestSurface->UnlockRect();
+				IsConverted = true;
 			}
-		}
-		else if (surfaceDesc2.ddpfPixelFormat.dwRGBBitCount)
-		{
-			ColorKey = GetARGBColorKey(surfaceDesc2.ddckCKSrcBlt.dwColorSpaceLowValue, surfaceDesc2.ddpfPixelFormat);
+			SrcSurface->UnlockRect();
 		}
 	}
 
-	if (FAILED(D3DXLoadSurfaceFromSurface(DestSurface, nullptr, lpDestRect, SrcSurface, surface.PaletteEntryArray, lpDestRect, D3DX_FILTER_NONE, ColorKey)))
+	if (!IsConverted)
 	{
-		Logging::Log() << __FUNCTION__ " Error: failed to copy data from surface: " << surface.Format << " " << (void*)ColorKey << " " << lpDestRect;
+		// Get color key
+		DWORD ColorKey = 0;
+		if (surfaceDesc2.dwFlags & DDSD_CKSRCBLT)
+		{
+			if (IsPalette())
+			{
+				if (surface.PaletteEntryArray)
+				{
+					PALETTEENTRY PaletteEntry = surface.PaletteEntryArray[surfaceDesc2.ddckCKSrcBlt.dwColorSpaceLowValue & 0xFF];
+					ColorKey = D3DCOLOR_ARGB(PaletteEntry.peFlags, PaletteEntry.peRed, PaletteEntry.peGreen, PaletteEntry.peBlue);
+				}
+			}
+			else if (surfaceDesc2.ddpfPixelFormat.dwRGBBitCount)
+			{
+				ColorKey = GetARGBColorKey(surfaceDesc2.ddckCKSrcBlt.dwColorSpaceLowValue, surfaceDesc2.ddpfPixelFormat);
+			}
+		}
 
-		DestSurface->Release();
+		if (FAILED(D3DXLoadSurfaceFromSurface(DestSurface, nullptr, &Rect, SrcSurface, surface.PaletteEntryArray, &Rect, D3DX_FILTER_NONE, ColorKey)))
+		{
+			Logging::Log() << __FUNCTION__ " Error: failed to copy data from surface: " << surface.Format << " " << (void*)ColorKey << " " << Rect;
 
-		return DDERR_GENERIC;
+			DestSurface->Release();
+
+			return DDERR_GENERIC;
+		}
 	}
 
 	surface.IsDrawTextureDirty = false;
@@ -7236,6 +7738,13 @@ HRESULT m_IDirectDrawSurfaceX::CopyToDrawTexture(LPRECT lpDestRect)
 	return DD_OK;
 }
 
+// Palette and color key changes affect every pixel of the draw texture
+void m_IDirectDrawSurfaceX::SetDrawTextureFullyDirty()
+{
+	CheckCoordinates(surface.DrawTextureDirtyRect, nullptr, &surfaceDesc2);
+	surface.IsDrawTextureDirty = true;
+}
+
 HRESULT m_IDirectDrawSurfaceX::LoadSurfaceFromMemory(LPDIRECT3DSURFACE9 pDestSurface, const RECT& Rect, LPCVOID pSrcMemory, D3DFORMAT SrcFormat, UINT SrcPitch)
 {
 	if (!pDestSurface)
@@ -7303,12 +7812,7 @@ HRESULT m_IDirectDrawSurfaceX::LoadSurfaceFromMemory(LPDIRECT3DSURFACE9 pDestSur
 		const LONG CopyHeight = Rect.bottom - Rect.top;
 
 		// Copy surface data row by row
-		for (LONG row = 0; row < CopyHeight; ++row)
-		{
-			memcpy(DestBuffer, SrcBuffer, CopyPitch);
-			SrcBuffer += SrcPitch;
-			DestBuffer += LockedRect.Pitch;
-		}
+		CopySurfaceRows(DestBuffer, LockedRect.Pitch, SrcBuffer, SrcPitch, CopyPitch, CopyHeight, true);
 
 		// Unlock destination surface
 		pDestSurface->UnlockRect();
@@ -7480,16 +7984,11 @@ HRESULT m_IDirectDrawSurfaceX::CopyToEmulatedSurface(LPRECT lpDestRect)
 	default:
 		if (SrcLockRect.Pitch == EmulatedLockRect.Pitch && (DWORD)(DestRect.right - DestRect.left) == surfaceDesc2.dwWidth)
 		{
-			memcpy(EmulatedBuffer, SurfaceBuffer, SrcLockRect.Pitch * Height);
+			CopySurfaceRows(EmulatedBuffer, EmulatedLockRect.Pitch, SurfaceBuffer, SrcLockRect.Pitch, SrcLockRect.Pitch, Height, false);
 		}
 		else if (surface.emu->bmi->bmiHeader.biBitCount == surface.BitCount)
 		{
-			for (UINT x = 0; x < Height; x++)
-			{
-				memcpy(EmulatedBuffer, SurfaceBuffer, WidthPitch);
-				EmulatedBuffer += EmulatedLockRect.Pitch;
-				SurfaceBuffer += SrcLockRect.Pitch;
-			}
+			CopySurfaceRows(EmulatedBuffer, EmulatedLockRect.Pitch, SurfaceBuffer, SrcLockRect.Pitch, WidthPitch, Height, false);
 		}
 		else
 		{
@@ -7927,6 +8426,7 @@ void m_IDirectDrawSurfaceX::UpdatePaletteData()
 	if (NewPaletteEntry && surface.LastPaletteUSN != NewPaletteUSN)
 	{
 		surface.IsPaletteDirty = true;
+		SetDrawTextureFullyDirty();
 		surface.LastPaletteUSN = NewPaletteUSN;
 		surface.PaletteEntryArray = NewPaletteEntry;
 	}
@@ -7939,6 +8439,66 @@ void m_IDirectDrawSurfaceX::StartSharedEmulatedMemory()
 	ShareEmulatedMemory = true;
 }
 
+// Get an unused emulated surface that matches, the most recently returned surface is used so its memory is more likely to still be cached
+EMUSURFACE* m_IDirectDrawSurfaceX::CheckoutSharedEmulatedMemory(DWORD Width, DWORD Height, DWORD BitCount, D3DFORMAT Format, DWORD Pitch)
+{
+	EMUSURFACE* pEmuSurface = nullptr;
+
+	SetCriticalSection();
+
+	auto it = memorySurfaces.find({ Width, Height, BitCount, Format, Pitch });
+	if (it != memorySurfaces.end() && !it->second.empty())
+	{
+		auto entry = it->second.back();
+		it->second.pop_back();
+
+		pEmuSurface = *entry;
+		memorySurfaceList.erase(entry);
+		memorySurfaceBytes -= GetEmulatedMemorySize(pEmuSurface);
+	}
+
+	ReleaseCriticalSection();
+
+	return pEmuSurface;
+}
+
+// Keep emulated surface for reuse, trims the least recently returned surfaces when too much memory is retained
+void m_IDirectDrawSurfaceX::ReturnSharedEmulatedMemory(EMUSURFACE** ppEmuSurface)
+{
+	if (!ppEmuSurface || !*ppEmuSurface)
+	{
+		return;
+	}
+
+	SetCriticalSection();
+
+	memorySurfaceList.push_front(*ppEmuSurface);
+	memorySurfaces[GetEmulatedMemoryKey(*ppEmuSurface)].push_back(memorySurfaceList.begin());
+	memorySurfaceBytes += GetEmulatedMemorySize(*ppEmuSurface);
+	*ppEmuSurface = nullptr;
+
+	while (memorySurfaceBytes > MaxSharedEmulatedMemory)
+	{
+		// The oldest surface in the list is also the oldest surface in its bucket
+		EMUSURFACE* pEmuSurface = memorySurfaceList.back();
+		auto it = memorySurfaces.find(GetEmulatedMemoryKey(pEmuSurface));
+		if (it != memorySurfaces.end() && !it->second.empty())
+		{
+			it->second.pop_front();
+			if (it->second.empty())
+			{
+				memorySurfaces.erase(it);
+			}
+		}
+		memorySurfaceList.pop_back();
+		memorySurfaceBytes -= GetEmulatedMemorySize(pEmuSurface);
+
+		DeleteEmulatedMemory(&pEmuSurface);
+	}
+
+	ReleaseCriticalSection();
+}
+
 void m_IDirectDrawSurfaceX::DeleteEmulatedMemory(EMUSURFACE **ppEmuSurface)
 {
 	if (!ppEmuSurface || !*ppEmuSurface)
@@ -7987,14 +8547,16 @@ void m_IDirectDrawSurfaceX::CleanupSharedEmulatedMemory()
 	
 	SetCriticalSection();
 
-	LOG_LIMIT(100, __FUNCTION__ << " Deleting " << memorySurfaces.size() << " emulated surface" << ((memorySurfaces.size() != 1) ? "s" : "") << "!");
+	LOG_LIMIT(100, __FUNCTION__ << " Deleting " << memorySurfaceList.size() << " emulated surface" << ((memorySurfaceList.size() != 1) ? "s" : "") << "!");
 
 	// Clean up unused emulated surfaces
-	for (EMUSURFACE* pEmuSurface: memorySurfaces)
+	for (EMUSURFACE* pEmuSurface: memorySurfaceList)
 	{
 		DeleteEmulatedMemory(&pEmuSurface);
 	}
+	memorySurfaceList.clear();
 	memorySurfaces.clear();
+	memorySurfaceBytes = 0;
 
 	ReleaseCriticalSection();
 }
@@ -60,6 +60,7 @@ private:
 		LONG lPitch = 0;
 		DWORD UniquenessValue = 0;
 		bool IsDummy = false;
+		bool IsGenerated = false;		// Data was built from the level above it
 	};
 
 	// For aligning bits after a lock for games that hard code the pitch
@@ -81,6 +82,9 @@ private:
 		DWORD Width = 0;
 		DWORD Height = 0;
 		DWORD Pitch = 0;
+		DWORD Size = 0;										// Size of the surface data before it was stored
+		bool IsRepeatedRow = false;							// All rows are the same, only the first row is stored
+		bool IsCompressed = false;							// Surface data is LZ4 compressed
 		std::vector<byte> Bits;
 	};
 
@@ -113,6 +117,16 @@ private:
 		DDBLTFX DDBltFx = {};
 	};
 
+	// Batch blit entry that is copied directly using one lock of each surface
+	struct BLTBATCHENTRY
+	{
+		m_IDirectDrawSurfaceX* pSourceSurface = nullptr;
+		RECT SrcRect = {};
+		RECT DestRect = {};
+		DWORD ColorKey = 0;
+		void (*Kernel)(DWORD ColorKey, const BYTE* SrcBuffer, BYTE* DestBuffer, INT SrcPitch, INT DestPitch, LONG Width, LONG Height) = nullptr;
+	};
+
 	// Extra Direct3D9 devices used in the primary surface
 	struct D9PRIMARY
 	{
@@ -132,6 +146,7 @@ private:
 		bool UsingShadowSurface = false;
 		bool IsDirtyFlag = false;
 		bool IsDrawTextureDirty = false;
+		RECT DrawTextureDirtyRect = {};					// Area of the draw texture that needs to be converted again
 		bool IsPaletteDirty = false;						// Used to detect if the palette surface needs to be updated
 		DWORD BitCount = 0;									// Bit count for this surface
 		D3DFORMAT Format = D3DFMT_UNKNOWN;					// Format for this surface
@@ -201,7 +216,10 @@ private:
 	std::vector<RECT> LockRectList;						// Rects used to lock the surface
 	DDRAWEMULATELOCK EmuLock;							// For aligning bits after a lock for games that hard code the pitch
 	std::vector<byte> ByteArray;						// Memory used for coping from one surface to the same surface
+	std::vector<BLTBATCHENTRY> BltBatchList;			// Entries of the current blit batch, entries without a kernel use Blt
 	std::vector<DDBACKUP> LostDeviceBackup;				// Memory used for backing up the surfaceTexture
+	DWORD LostDeviceBackupGeneration = 0;				// Data generation of the surface when the backup was taken
+	DWORD DataGeneration = 0;							// Changes each time the surface data is written to
 	COLORKEY ShaderColorKey;							// Used to store color key array for shader
 	SURFACECREATE ShouldEmulate = SC_NOT_CREATED;		// Used to help determine if surface should be emulated
 
@@ -223,8 +241,10 @@ private:
 
 	// Store a list of attached surfaces
 	std::unique_ptr<m_IDirectDrawSurfaceX> BackBufferInterface;
-	std::map<DWORD, ATTACHEDMAP> AttachedSurfaceMap;
+	SmallFlatMap<DWORD, ATTACHEDMAP, 4> AttachedSurfaceMap;
 	DWORD MapKey = 0;
+	m_IDirectDrawSurfaceX* FlipBackBuffer = nullptr;	// Cached first attached flip surface, only valid when IsFlipBackBufferSet
+	bool IsFlipBackBufferSet = false;
 
 	// Wrapper interface functions
 	inline REFIID GetWrapperType(DWORD DirectXVersion)
@@ -269,10 +289,14 @@ private:
 	HRESULT CreateD9AuxiliarySurfaces();
 	HRESULT CreateD9Surface();
 	bool DoesDCMatch(EMUSURFACE* pEmuSurface) const;
+	static EMUSURFACE* CheckoutSharedEmulatedMemory(DWORD Width, DWORD Height, DWORD BitCount, D3DFORMAT Format, DWORD Pitch);
+	static void ReturnSharedEmulatedMemory(EMUSURFACE** ppEmuSurface);
 	void SetEmulationGameDC();
 	void UnsetEmulationGameDC();
 	HRESULT CreateDCSurface();
 	void ReleaseDCSurface();
+	void StoreBackupData(DDBACKUP& Backup, const BYTE* pBits);
+	bool LoadBackupData(const DDBACKUP& Backup, BYTE* pBits);
 	void UpdateAttachedDepthStencil(m_IDirectDrawSurfaceX* lpAttachedSurfaceX);
 	void UpdateSurfaceDesc();
 
@@ -310,7 +334,7 @@ private:
 	inline DDSCAPS2 GetSurfaceCaps() const { return surfaceDesc2.ddsCaps; }
 	inline D3DFORMAT GetSurfaceFormat() const { return surface.Format; }
 
-	void SetDirtyFlag(DWORD MipMapLevel);
+	void SetDirtyFlag(DWORD MipMapLevel, LPRECT lpDestRect = nullptr);
 
 	// Attached surfaces
 	void InitSurfaceDesc(DWORD DirectXVersion);
@@ -325,6 +349,7 @@ private:
 	HRESULT SaveSurfaceToFile(const char* filename, D3DXIMAGE_FILEFORMAT format);
 	HRESULT CopySurface(m_IDirectDrawSurfaceX* pSourceSurface, RECT* pSourceRect, RECT* pDestRect, D3DTEXTUREFILTERTYPE Filter, D3DCOLOR ColorKey, DWORD dwFlags, DWORD SrcMipMapLevel, DWORD MipMapLevel);
 	HRESULT CopyToDrawTexture(LPRECT lpDestRect);
+	void SetDrawTextureFullyDirty();
 	HRESULT LoadSurfaceFromMemory(LPDIRECT3DSURFACE9 pDestSurface, const RECT& Rect, LPCVOID pSrcMemory, D3DFORMAT SrcFormat, UINT SrcPitch);
 	HRESULT CopyFromEmulatedSurface(LPRECT lpDestRect);
 	HRESULT CopyToEmulatedSurface(LPRECT lpDestRect);
@@ -491,6 +516,7 @@ public:
 	inline bool IsUsingEmulation() const { return (surface.emu && surface.emu->DC && surface.emu->GameDC && surface.emu->pBits); }
 	inline bool IsEmulationDCReady() const { return (IsUsingEmulation() && !surface.emu->UsingGameDC); }
 	inline bool IsSurfaceDirty() const { return surface.IsDirtyFlag; }
+	inline bool IsSurfaceHeld() const { return (IsLocked || IsInDC); }
 	inline bool IsMipMapAutogen() const { return surface.Texture && (surface.Usage & D3DUSAGE_AUTOGENMIPMAP); }
 	inline bool IsMipMapGenerated() const { return IsMipMapReadyToUse || IsMipMapAutogen(); }
 	inline void FixTextureFlags(LPDDSURFACEDESC2 lpDDSurfaceDesc2);
@@ -535,9 +561,13 @@ public:
 
 	// Draw 2D DirectDraw surface
 	HRESULT ColorFill(RECT* pRect, D3DCOLOR dwFillColor, DWORD MipMapLevel);
+	static HRESULT CheckBltFlags(DWORD dwFlags, LPDDBLTFX lpDDBltFx);
+	bool CanBltBatchDirect() const;
+	bool GetBltBatchEntry(const DDBLTBATCH& Batch, BLTBATCHENTRY& Entry);
 
 	// Attached surfaces
 	void RemoveAttachedSurfaceFromMap(m_IDirectDrawSurfaceX* lpSurfaceX);
+	m_IDirectDrawSurfaceX* GetFlipBackBuffer();
 
 	// For clipper
 	void RemoveClipper(m_IDirectDrawClipper* ClipperToRemove);
@@ -18,11 +18,14 @@
 
 #include "ddraw.h"
 #include "ddrawExternal.h"
+#include "SurfaceCopy.h"
+#include "SurfaceDump.h"
 #include "Utils\Utils.h"
 #include "GDI\GDI.h"
 #include "GDI\WndProc.h"
 #include "Dllmain\DllMain.h"
 #include "d3d9\d3d9External.h"
+#include "d3d9\GammaRamp.h"
 #include "d3dddi\d3dddiExternal.h"
 #include "Shaders\PaletteShader.h"
 #include "Shaders\ColorKeyShader.h"
@@ -165,6 +168,7 @@ DDPIXELFORMAT DisplayPixelFormat;
 bool IsGammaSet;
 D3DGAMMARAMP RampData;
 D3DGAMMARAMP DefaultRampData;
+GAMMARAMPLUT GammaLUT;
 
 // Last used surface resolution
 DWORD LastSetWidth;
@@ -219,6 +223,7 @@ LPDIRECT3DDEVICE9 d3d9Device;
 D3DPRESENT_PARAMETERS presParams;
 LPDIRECT3DTEXTURE9 GammaLUTTexture;
 LPDIRECT3DTEXTURE9 ScreenCopyTexture;
+LPDIRECT3DSURFACE9 GammaCopySurface;
 LPDIRECT3DPIXELSHADER9 palettePixelShader;
 LPDIRECT3DPIXELSHADER9 colorkeyPixelShader;
 LPDIRECT3DPIXELSHADER9 gammaPixelShader;
@@ -1216,7 +1221,7 @@ HRESULT m_IDirectDrawX::EnumSurfaces2(DWORD dwFlags, LPDDSURFACEDESC2 lpDDSurfac
 			return DDERR_INVALIDPARAMS;
 
 		case (DDENUMSURFACES_DOESEXIST | DDENUMSURFACES_ALL):
-			for (m_IDirectDrawSurfaceX*& pSurfaceX : SurfaceVector)
+			for (m_IDirectDrawSurfaceX* pSurfaceX : SurfaceVector)
 			{
 				LPDIRECTDRAWSURFACE7 pSurface7 = (LPDIRECTDRAWSURFACE7)pSurfaceX->GetWrapperInterfaceX(DirectXVersion);
 
@@ -2270,7 +2275,7 @@ HRESULT m_IDirectDrawX::RestoreAllSurfaces()
 
 			for (m_IDirectDrawX*& pDDraw : DDrawVector)
 			{
-				for (m_IDirectDrawSurfaceX*& pSurface : pDDraw->SurfaceVector)
+				for (m_IDirectDrawSurfaceX* pSurface : pDDraw->SurfaceVector)
 				{
 					pSurface->Restore();
 				}
@@ -2487,6 +2492,7 @@ void m_IDirectDrawX::InitInterface(DWORD DirectXVersion)
 		d3d9Device = nullptr;
 		GammaLUTTexture = nullptr;
 		ScreenCopyTexture = nullptr;
+		GammaCopySurface = nullptr;
 		palettePixelShader = nullptr;
 		colorkeyPixelShader = nullptr;
 		gammaPixelShader = nullptr;
@@ -2666,7 +2672,7 @@ void m_IDirectDrawX::ReleaseInterface()
 	}
 
 	// Release surfaces
-	for (m_IDirectDrawSurfaceX*& pSurface : SurfaceVector)
+	for (m_IDirectDrawSurfaceX* pSurface : SurfaceVector)
 	{
 		pSurface->ReleaseD9Surface(false, false);
 		pSurface->ClearDdraw();
@@ -2674,21 +2680,21 @@ void m_IDirectDrawX::ReleaseInterface()
 	SurfaceVector.clear();
 
 	// Release Clippers
-	for (m_IDirectDrawClipper*& pClipper : ClipperVector)
+	for (m_IDirectDrawClipper* pClipper : ClipperVector)
 	{
 		pClipper->ClearDdraw();
 	}
 	ClipperVector.clear();
 
 	// Release palettes
-	for (m_IDirectDrawPalette*& pPalette : PaletteVector)
+	for (m_IDirectDrawPalette* pPalette : PaletteVector)
 	{
 		pPalette->ClearDdraw();
 	}
 	PaletteVector.clear();
 
 	// Release vertex buffers
-	for (m_IDirect3DVertexBufferX*& pVertexBuffer : VertexBufferVector)
+	for (m_IDirect3DVertexBufferX* pVertexBuffer : VertexBufferVector)
 	{
 		pVertexBuffer->ReleaseD9Buffer(false, false);
 		pVertexBuffer->ClearDdraw();
@@ -2724,6 +2730,12 @@ void m_IDirectDrawX::ReleaseInterface()
 			PresentThread.IsInitialized = false;
 		}
 
+		// Write any queued surface dumps
+		CloseSurfaceDumpThread();
+
+		// Close copy worker threads
+		CloseSurfaceCopyThreads();
+
 		// Release all resources
 		ReleaseAllD9Resources(false, false);
 
@@ -3181,6 +3193,9 @@ HRESULT m_IDirectDrawX::ResetD9Device()
 	if (SUCCEEDED(hr))
 	{
 		WndProc::SwitchingResolution = false;
+
+		// Redraw the primary surface after the reset
+		SetPresentPending();
 	}
 
 	ReleasePTCriticalSection();
@@ -3779,7 +3794,7 @@ void m_IDirectDrawX::Clear3DFlagForAllSurfaces()
 
 	for (m_IDirectDrawX*& pDDraw : DDrawVector)
 	{
-		for (m_IDirectDrawSurfaceX*& pSurface : pDDraw->SurfaceVector)
+		for (m_IDirectDrawSurfaceX* pSurface : pDDraw->SurfaceVector)
 		{
 			pSurface->ClearUsing3DFlag();
 		}
@@ -3794,7 +3809,7 @@ inline void m_IDirectDrawX::ResetAllSurfaceDisplay()
 
 	for (m_IDirectDrawX*& pDDraw : DDrawVector)
 	{
-		for (m_IDirectDrawSurfaceX*& pSurface : pDDraw->SurfaceVector)
+		for (m_IDirectDrawSurfaceX* pSurface : pDDraw->SurfaceVector)
 		{
 			pSurface->ResetSurfaceDisplay();
 		}
@@ -3833,7 +3848,7 @@ inline void m_IDirectDrawX::ReleaseAllD9Resources(bool BackupData, bool ResetInt
 	// Release all surfaces from all ddraw devices
 	for (m_IDirectDrawX*& pDDraw : DDrawVector)
 	{
-		for (m_IDirectDrawSurfaceX*& pSurface : pDDraw->SurfaceVector)
+		for (m_IDirectDrawSurfaceX* pSurface : pDDraw->SurfaceVector)
 		{
 			pSurface->ReleaseD9Surface(BackupData, ResetInterface);
 		}
@@ -3861,7 +3876,7 @@ inline void m_IDirectDrawX::ReleaseAllD9Resources(bool BackupData, bool ResetInt
 	// Release all vertex buffers from all ddraw devices
 	for (m_IDirectDrawX*& pDDraw : DDrawVector)
 	{
-		for (m_IDirect3DVertexBufferX*& pBuffer : pDDraw->VertexBufferVector)
+		for (m_IDirect3DVertexBufferX* pBuffer : pDDraw->VertexBufferVector)
 		{
 			pBuffer->ReleaseD9Buffer(BackupData, ResetInterface);
 		}
@@ -3891,6 +3906,18 @@ inline void m_IDirectDrawX::ReleaseAllD9Resources(bool BackupData, bool ResetInt
 		ScreenCopyTexture = nullptr;
 	}
 
+	// Release gamma system memory copy
+	if (GammaCopySurface)
+	{
+		Logging::LogDebug() << __FUNCTION__ << " Releasing Direct3D9 gamma copy surface";
+		ULONG ref = GammaCopySurface->Release();
+		if (ref)
+		{
+			Logging::Log() << __FUNCTION__ << " Error: there is still a reference to 'GammaCopySurface' " << ref;
+		}
+		GammaCopySurface = nullptr;
+	}
+
 	// Release validate device d3d9 vertex buffer
 	if (validateDeviceVertexBuffer)
 	{
@@ -4000,7 +4027,7 @@ void m_IDirectDrawX::EvictManagedTextures()
 	SetCriticalSection();
 
 	// Check if any surfaces are locked
-	for (m_IDirectDrawSurfaceX*& pSurface : SurfaceVector)
+	for (m_IDirectDrawSurfaceX* pSurface : SurfaceVector)
 	{
 		if (pSurface->IsSurfaceManaged())
 		{
@@ -4023,7 +4050,7 @@ void m_IDirectDrawX::AddSurfaceToVector(m_IDirectDrawSurfaceX* lpSurfaceX)
 			PrimarySurface = lpSurfaceX;
 		}
 
-		SurfaceVector.push_back(lpSurfaceX);
+		SurfaceVector.insert(lpSurfaceX);
 	}
 
 	ReleaseCriticalSection();
@@ -4075,15 +4102,12 @@ void m_IDirectDrawX::RemoveSurfaceFromVector(m_IDirectDrawSurfaceX* lpSurfaceX)
 			pDDraw->SetDepthStencilSurface(nullptr);
 		}
 
-		auto it = std::find(pDDraw->SurfaceVector.begin(), pDDraw->SurfaceVector.end(), lpSurfaceX);
-
-		if (it != std::end(pDDraw->SurfaceVector))
+		if (pDDraw->SurfaceVector.erase(lpSurfaceX))
 		{
 			lpSurfaceX->ClearDdraw();
-			pDDraw->SurfaceVector.erase(it);
 		}
 
-		for (m_IDirectDrawSurfaceX*& pSurface : pDDraw->SurfaceVector)
+		for (m_IDirectDrawSurfaceX* pSurface : pDDraw->SurfaceVector)
 		{
 			pSurface->RemoveAttachedSurfaceFromMap(lpSurfaceX);
 		}
@@ -4102,7 +4126,7 @@ bool m_IDirectDrawX::DoesSurfaceExist(m_IDirectDrawSurfaceX* lpSurfaceX)
 
 	SetCriticalSection();
 
-	bool hr = std::find(SurfaceVector.begin(), SurfaceVector.end(), lpSurfaceX) != std::end(SurfaceVector);
+	bool hr = SurfaceVector.contains(lpSurfaceX);
 
 	ReleaseCriticalSection();
 
@@ -4116,7 +4140,7 @@ void m_IDirectDrawX::AddClipperToVector(m_IDirectDrawClipper* lpClipper)
 
 	if (lpClipper && !DoesClipperExist(lpClipper))
 	{
-		ClipperVector.push_back(lpClipper);
+		ClipperVector.insert(lpClipper);
 	}
 
 	ReleaseCriticalSection();
@@ -4138,16 +4162,13 @@ void m_IDirectDrawX::RemoveClipperFromVector(m_IDirectDrawClipper* lpClipper)
 	// Remove clipper from attached surface
 	for (m_IDirectDrawX*& pDDraw : DDrawVector)
 	{
-		auto it = std::find(pDDraw->ClipperVector.begin(), pDDraw->ClipperVector.end(), lpClipper);
-
 		// Remove clipper from vector
-		if (it != std::end(pDDraw->ClipperVector))
+		if (pDDraw->ClipperVector.erase(lpClipper))
 		{
 			lpClipper->ClearDdraw();
-			pDDraw->ClipperVector.erase(it);
 		}
 
-		for (m_IDirectDrawSurfaceX*& pSurface : pDDraw->SurfaceVector)
+		for (m_IDirectDrawSurfaceX* pSurface : pDDraw->SurfaceVector)
 		{
 			pSurface->RemoveClipper(lpClipper);
 		}
@@ -4172,7 +4193,7 @@ bool m_IDirectDrawX::DoesClipperExist(m_IDirectDrawClipper* lpClipper)
 
 	SetCriticalSection();
 
-	bool hr = std::find(ClipperVector.begin(), ClipperVector.end(), lpClipper) != std::end(ClipperVector);
+	bool hr = ClipperVector.contains(lpClipper);
 
 	ReleaseCriticalSection();
 
@@ -4186,7 +4207,7 @@ void m_IDirectDrawX::AddPaletteToVector(m_IDirectDrawPalette* lpPalette)
 
 	if (lpPalette && !DoesPaletteExist(lpPalette))
 	{
-		PaletteVector.push_back(lpPalette);
+		PaletteVector.insert(lpPalette);
 	}
 
 	ReleaseCriticalSection();
@@ -4205,16 +4226,13 @@ void m_IDirectDrawX::RemovePaletteFromVector(m_IDirectDrawPalette* lpPalette)
 	// Remove palette from attached surface
 	for (m_IDirectDrawX*& pDDraw : DDrawVector)
 	{
-		auto it = std::find(pDDraw->PaletteVector.begin(), pDDraw->PaletteVector.end(), lpPalette);
-
 		// Remove palette from vector
-		if (it != std::end(pDDraw->PaletteVector))
+		if (pDDraw->PaletteVector.erase(lpPalette))
 		{
 			lpPalette->ClearDdraw();
-			pDDraw->PaletteVector.erase(it);
 		}
 
-		for (m_IDirectDrawSurfaceX*& pSurface : pDDraw->SurfaceVector)
+		for (m_IDirectDrawSurfaceX* pSurface : pDDraw->SurfaceVector)
 		{
 			pSurface->RemovePalette(lpPalette);
 		}
@@ -4233,7 +4251,7 @@ bool m_IDirectDrawX::DoesPaletteExist(m_IDirectDrawPalette* lpPalette)
 
 	SetCriticalSection();
 
-	bool hr = std::find(PaletteVector.begin(), PaletteVector.end(), lpPalette) != std::end(PaletteVector);
+	bool hr = PaletteVector.contains(lpPalette);
 
 	ReleaseCriticalSection();
 
@@ -4246,7 +4264,7 @@ void m_IDirectDrawX::AddVertexBufferToVector(m_IDirect3DVertexBufferX* lpVertexB
 
 	if (lpVertexBuffer && !DoesVertexBufferExist(lpVertexBuffer))
 	{
-		VertexBufferVector.push_back(lpVertexBuffer);
+		VertexBufferVector.insert(lpVertexBuffer);
 	}
 
 	ReleaseCriticalSection();
@@ -4264,13 +4282,10 @@ void m_IDirectDrawX::RemoveVertexBufferFromVector(m_IDirect3DVertexBufferX* lpVe
 	// Remove palette from attached surface
 	for (m_IDirectDrawX*& pDDraw : DDrawVector)
 	{
-		auto it = std::find(pDDraw->VertexBufferVector.begin(), pDDraw->VertexBufferVector.end(), lpVertexBuffer);
-
 		// Remove vertex buffer from vector
-		if (it != std::end(pDDraw->VertexBufferVector))
+		if (pDDraw->VertexBufferVector.erase(lpVertexBuffer))
 		{
 			lpVertexBuffer->ClearDdraw();
-			pDDraw->VertexBufferVector.erase(it);
 		}
 	}
 
@@ -4286,7 +4301,7 @@ bool m_IDirectDrawX::DoesVertexBufferExist(m_IDirect3DVertexBufferX* lpVertexBuf
 
 	SetCriticalSection();
 
-	bool hr = std::find(VertexBufferVector.begin(), VertexBufferVector.end(), lpVertexBuffer) != std::end(VertexBufferVector);
+	bool hr = VertexBufferVector.contains(lpVertexBuffer);
 
 	ReleaseCriticalSection();
 
@@ -4435,6 +4450,25 @@ HRESULT m_IDirectDrawX::SetBrightnessLevel(D3DGAMMARAMP& Ramp)
 	return DD_OK;
 }
 
+// Apply gamma ramp to the render target on the CPU, used when the gamma pixel shader is not available
+void m_IDirectDrawX::ApplyCPUGammaRamp()
+{
+	IDirect3DSurface9* pRenderTarget = nullptr;
+	if (FAILED(d3d9Device->GetRenderTarget(0, &pRenderTarget)))
+	{
+		LOG_LIMIT(100, __FUNCTION__ << " Error: failed to get render target!");
+		return;
+	}
+
+	HRESULT hr = ApplyGammaRampToRenderTarget(d3d9Device, pRenderTarget, GammaCopySurface, GammaLUT);
+	if (FAILED(hr))
+	{
+		LOG_LIMIT(100, __FUNCTION__ << " Error: failed to apply gamma ramp: " << (D3DERR)hr);
+	}
+
+	pRenderTarget->Release();
+}
+
 HRESULT m_IDirectDrawX::SetD9Gamma(DWORD dwFlags, LPDDGAMMARAMP lpRampData)
 {
 	// Check for device interface
@@ -4458,8 +4492,13 @@ HRESULT m_IDirectDrawX::SetD9Gamma(DWORD dwFlags, LPDDGAMMARAMP lpRampData)
 
 	if (memcmp(&DefaultRampData, &RampData, sizeof(D3DGAMMARAMP)) != S_OK)
 	{
-		IsGammaSet = true;
-		SetBrightnessLevel(RampData);
+		// Skip gamma if the ramp does not change any colors
+		CreateGammaRampLUT(RampData, GammaLUT);
+		if (!GammaLUT.IsIdentity)
+		{
+			IsGammaSet = true;
+			SetBrightnessLevel(RampData);
+		}
 	}
 
 	return DD_OK;
@@ -4603,6 +4642,7 @@ HRESULT m_IDirectDrawX::DrawPrimarySurface(LPDIRECT3DTEXTURE9 pDisplayTexture)
 	Logging::LogDebug() << __FUNCTION__ << " (" << this << ")";
 
 	bool IsUsingPalette = false;
+	bool IsUsingCPUGamma = false;
 	if (!pDisplayTexture)
 	{
 		if (!PrimarySurface)
@@ -4654,17 +4694,26 @@ HRESULT m_IDirectDrawX::DrawPrimarySurface(LPDIRECT3DTEXTURE9 pDisplayTexture)
 	// For gamma
 	else if (IsGammaSet && GammaControlInterface)
 	{
-		// Create gamma texture
-		if (!GammaLUTTexture)
+		LPDIRECT3DPIXELSHADER9 pGammaPixelShader = GetGammaPixelShader();
+		if (pGammaPixelShader)
 		{
-			SetBrightnessLevel(RampData);
-		}
+			// Create gamma texture
+			if (!GammaLUTTexture)
+			{
+				SetBrightnessLevel(RampData);
+			}
 
-		// Set gamma texture
-		d3d9Device->SetTexture(1, GammaLUTTexture);
+			// Set gamma texture
+			d3d9Device->SetTexture(1, GammaLUTTexture);
 
-		// Set pixel shader
-		d3d9Device->SetPixelShader(GetGammaPixelShader());
+			// Set pixel shader
+			d3d9Device->SetPixelShader(pGammaPixelShader);
+		}
+		else
+		{
+			// Apply gamma on the CPU after drawing
+			IsUsingCPUGamma = true;
+		}
 	}
 
 	// Update vertices
@@ -4691,6 +4740,12 @@ HRESULT m_IDirectDrawX::DrawPrimarySurface(LPDIRECT3DTEXTURE9 pDisplayTexture)
 	// Draw primitive
 	HRESULT hr = d3d9Device->DrawPrimitiveUP(D3DPT_TRIANGLEFAN, 2, DeviceVertices, sizeof(TLVERTEX));
 
+	// Apply gamma to render target
+	if (SUCCEEDED(hr) && IsUsingCPUGamma)
+	{
+		ApplyCPUGammaRamp();
+	}
+
 	// Reset old render target
 	if (pBackBuffer)
 	{
@@ -4812,6 +4867,7 @@ HRESULT m_IDirectDrawX::PresentScene(RECT* pRect)
 
 	if (IsUsingThreadPresent())
 	{
+		SetPresentPending();
 		return DD_OK;
 	}
 
@@ -4848,7 +4904,16 @@ HRESULT m_IDirectDrawX::PresentScene(RECT* pRect)
 	// Copy or draw primary surface before presenting
 	if (IsPrimaryRenderTarget() && !PrimarySurface->GetD3d9Texture())
 	{
-		if (IsGammaSet && GammaControlInterface)
+		if (IsGammaSet && GammaControlInterface && !GetGammaPixelShader())
+		{
+			// Copy primary surface and apply gamma on the CPU
+			hr = CopyPrimarySurface(nullptr);
+			if (SUCCEEDED(hr))
+			{
+				ApplyCPUGammaRamp();
+			}
+		}
+		else if (IsGammaSet && GammaControlInterface)
 		{
 			IDirect3DSurface9* pBackBuffer = nullptr;
 			if (SUCCEEDED(d3d9Device->GetBackBuffer(0, 0, D3DBACKBUFFER_TYPE_MONO, &pBackBuffer)))
@@ -4914,23 +4979,61 @@ bool m_IDirectDrawX::IsUsingThreadPresent()
 	return (PresentThread.IsInitialized && ExclusiveMode && !RenderTargetSurface && !IsPrimaryRenderTarget());
 }
 
+// Wake the present thread, only the first request after a present sets the event
+void m_IDirectDrawX::SetPresentPending()
+{
+	if (InterlockedExchange(&IsPresentPending, TRUE) == FALSE && PresentThread.IsInitialized)
+	{
+		SetEvent(PresentThread.workerEvent);
+	}
+}
+
+// Take the pending present, returns true if one was requested
+bool m_IDirectDrawX::ClearPresentPending()
+{
+	return (InterlockedExchange(&IsPresentPending, FALSE) != FALSE);
+}
+
 // Present Thread: Wait for the event
 DWORD WINAPI PresentThreadFunction(LPVOID)
 {
 	LOG_LIMIT(100, __FUNCTION__ << " Creating thread!");
 
+	// Number of times the thread woke up without anything to present
+	DWORD SpuriousWakeups = 0;
+
+	// Set while the application holds a lock or DC on the primary surface, it can write to it without requesting a present
+	bool IsPrimaryHeld = false;
+
 	PresentThread.EnableThreadFlag = true;
 	while (PresentThread.EnableThreadFlag)
 	{
-		// Check how long since the last successful present
-		LARGE_INTEGER ClickTime = {};
-		QueryPerformanceCounter(&ClickTime);
-		double DeltaPresentMS = ((ClickTime.QuadPart - PresentThread.LastPresentTime.QuadPart) * 1000.0) / Counter.Frequency.QuadPart;
+		// Sleep until a present is requested, redraw each frame while the primary surface is held
+		WaitForSingleObject(PresentThread.workerEvent, IsPrimaryHeld ? max((DWORD)Counter.PerFrameMS, (DWORD)1) : INFINITE);
 
-		DWORD timeout = (DWORD)(Counter.PerFrameMS - DeltaPresentMS < 0.0 ? 0.0 : Counter.PerFrameMS - DeltaPresentMS);
+		// Limit presents to the frame time
+		while (PresentThread.EnableThreadFlag)
+		{
+			// Check how long since the last successful present
+			LARGE_INTEGER ClickTime = {};
+			QueryPerformanceCounter(&ClickTime);
+			double RemainingMS = Counter.PerFrameMS - ((ClickTime.QuadPart - PresentThread.LastPresentTime.QuadPart) * 1000.0) / Counter.Frequency.QuadPart;
 
-		WaitForSingleObject(PresentThread.workerEvent, timeout);
-		ResetEvent(PresentThread.workerEvent);
+			if (RemainingMS <= 0.0)
+			{
+				break;
+			}
+
+			// Sleep most of the remaining time and busy wait the rest to hit the deadline
+			if (RemainingMS > 2.0)
+			{
+				Sleep((DWORD)RemainingMS - 1);
+			}
+			else
+			{
+				Utils::BusyWaitYield((DWORD)RemainingMS);
+			}
+		}
 
 		if (!PresentThread.EnableThreadFlag)
 		{
@@ -4939,20 +5042,27 @@ DWORD WINAPI PresentThreadFunction(LPVOID)
 
 		SetPTCriticalSection();
 
+		bool IsPresented = false;
+		IsPrimaryHeld = false;
 		if (d3d9Device)
 		{
+			bool IsPending = false;
 			m_IDirectDrawX* pDDraw = nullptr;
 			m_IDirectDrawSurfaceX* pPrimarySurface = nullptr;
 			for (m_IDirectDrawX* instance : DDrawVector)
 			{
-				pPrimarySurface = instance->GetPrimarySurface();
-				if (pPrimarySurface)
+				IsPending = instance->ClearPresentPending() || IsPending;
+				if (!pPrimarySurface)
 				{
-					pDDraw = instance;
-					break;
+					pPrimarySurface = instance->GetPrimarySurface();
+					if (pPrimarySurface)
+					{
+						pDDraw = instance;
+					}
 				}
 			}
-			if (pDDraw && pDDraw->IsUsingThreadPresent() && pPrimarySurface && pPrimarySurface->GetD3d9Texture())
+			IsPrimaryHeld = (pPrimarySurface && pPrimarySurface->IsSurfaceHeld());
+			if ((IsPending || IsPrimaryHeld) && pDDraw && pDDraw->IsUsingThreadPresent() && pPrimarySurface && pPrimarySurface->GetD3d9Texture())
 			{
 				pPrimarySurface->SetLockCriticalSection();
 				pPrimarySurface->SetSurfaceCriticalSection();
@@ -4974,13 +5084,20 @@ DWORD WINAPI PresentThreadFunction(LPVOID)
 
 				pPrimarySurface->ReleaseSurfaceCriticalSection();
 				pPrimarySurface->ReleaseLockCriticalSection();
+
+				IsPresented = true;
 			}
 		}
 
 		ReleasePTCriticalSection();
+
+		if (!IsPresented)
+		{
+			SpuriousWakeups++;
+		}
 	}
 
-	LOG_LIMIT(100, __FUNCTION__ << " Closing thread!");
+	LOG_LIMIT(100, __FUNCTION__ << " Closing thread! Spurious wakeups: " << SpuriousWakeups);
 
 	return S_OK;
 }
@@ -13,6 +13,9 @@ private:
 
 	bool Using3D = false;
 
+	// Set when the primary surface needs to be presented by the present thread
+	volatile LONG IsPresentPending = FALSE;
+
 	// Fix exclusive mode issue
 	HHOOK g_hook = nullptr;
 	HWND chWnd = nullptr;
@@ -30,17 +33,17 @@ private:
 	m_IDirectDrawSurfaceX *DepthStencilSurface = nullptr;
 
 	// Store a list of surfaces
-	std::vector<m_IDirectDrawSurfaceX*> SurfaceVector;
+	PointerSet<m_IDirectDrawSurfaceX> SurfaceVector;
 	std::vector<m_IDirectDrawSurfaceX*> ReleasedSurfaceVector;
 
 	// Store a list of clippers
-	std::vector<m_IDirectDrawClipper*> ClipperVector;
+	PointerSet<m_IDirectDrawClipper> ClipperVector;
 
 	// Store a list of palettes
-	std::vector<m_IDirectDrawPalette*> PaletteVector;
+	PointerSet<m_IDirectDrawPalette> PaletteVector;
 
 	// Store a list of vertex buffers
-	std::vector<m_IDirect3DVertexBufferX*> VertexBufferVector;
+	PointerSet<m_IDirect3DVertexBufferX> VertexBufferVector;
 
 	// Store color control interface
 	m_IDirectDrawColorControl *ColorControlInterface = nullptr;
@@ -88,6 +91,7 @@ private:
 	// Gamma functions
 	LPDIRECT3DPIXELSHADER9 GetGammaPixelShader();
 	HRESULT SetBrightnessLevel(D3DGAMMARAMP& RampData);
+	void ApplyCPUGammaRamp();
 
 	// Interface initialization functions
 	void InitInterface(DWORD DirectXVersion);
@@ -254,6 +258,8 @@ public:
 	HRESULT CopyPrimarySurface(LPDIRECT3DSURFACE9 pDestBuffer);
 	HRESULT DrawPrimarySurface(LPDIRECT3DTEXTURE9 pDisplayTexture);
 	bool IsUsingThreadPresent();
+	void SetPresentPending();
+	bool ClearPresentPending();
 	HRESULT PresentScene(RECT* pRect);
 	HRESULT Present(RECT* pSourceRect, RECT* pDestRect);
 };
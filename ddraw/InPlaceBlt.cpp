@@ -0,0 +1,137 @@
+/**
+* Copyright (C) 2024 Elisha Riedlinger
+*
+* This software is  provided 'as-is', without any express  or implied  warranty. In no event will the
+* authors be held liable for any damages arising from the use of this software.
+* Permission  is granted  to anyone  to use  this software  for  any  purpose,  including  commercial
+* applications, and to alter it and redistribute it freely, subject to the following restrictions:
+*
+*   1. The origin of this software must not be misrepresented; you must not claim that you  wrote the
+*      original  software. If you use this  software  in a product, an  acknowledgment in the product
+*      documentation would be appreciated but is not required.
+*   2. Altered source versions must  be plainly  marked as such, and  must not be  misrepresented  as
+*      being the original software.
+*   3. This notice may not be removed or altered from any source distribution.
+*
+*
+* Blits where the source and destination rects are on the same surface. The row order and the column
+* order are picked from the direction of the overlap so each source pixel is read before it is
+* overwritten, the same way memmove works. Mirrored rows on the same line are read into a row buffer
+* first. Mirroring up and down with overlapping rects has no safe order and is not done in place.
+*/
+
+#include <string.h>
+#include "InPlaceBlt.h"
+#include "SurfaceBlit.h"
+#include "IDirectDrawTypes.h"
+
+// Check if the blit can be done in place, stretched blits are never done in place
+bool CanBlitInPlace(const RECT& SrcRect, const RECT& DestRect, bool IsMirrorUpDown)
+{
+	if (SrcRect.right - SrcRect.left != DestRect.right - DestRect.left || SrcRect.bottom - SrcRect.top != DestRect.bottom - DestRect.top)
+	{
+		return false;
+	}
+
+	// Rects that do not overlap can be copied in any order
+	const bool IsOverlapping = SrcRect.left < DestRect.right && DestRect.left < SrcRect.right && SrcRect.top < DestRect.bottom && DestRect.top < SrcRect.bottom;
+
+	return !IsMirrorUpDown || !IsOverlapping;
+}
+
+// Copy part of a row to another part of the same row
+template <typename T>
+static void BlitRowInPlace(const BYTE* pSrc, BYTE* pDest, LONG Width, T ColorKey, bool IsColorKey, bool IsBackward)
+{
+	const T* SrcRow = reinterpret_cast<const T*>(pSrc);
+	T* DestRow = reinterpret_cast<T*>(pDest);
+
+	if (!IsColorKey)
+	{
+		memmove(DestRow, SrcRow, Width * sizeof(T));
+		return;
+	}
+
+	for (LONG i = 0; i < Width; i++)
+	{
+		const LONG x = IsBackward ? Width - i - 1 : i;
+		T PixelColor = SrcRow[x];
+		if (PixelColor != ColorKey)
+		{
+			DestRow[x] = PixelColor;
+		}
+	}
+}
+
+template <typename T>
+static void BlitInPlaceT(BYTE* pBits, LONG Pitch, const RECT& SrcRect, const RECT& DestRect, DWORD dColorKey, bool IsColorKey, bool IsMirrorLeftRight, bool IsMirrorUpDown, BYTE* pRowBuffer)
+{
+	const LONG Width = DestRect.right - DestRect.left;
+	const LONG Height = DestRect.bottom - DestRect.top;
+	const size_t RowSize = Width * sizeof(T);
+
+	// Rects that do not overlap are a normal blit
+	RECT Overlap;
+	if (!IntersectRect(&Overlap, &SrcRect, &DestRect))
+	{
+		BlitSurfaceRect(pBits + DestRect.top * Pitch + DestRect.left * sizeof(T), Pitch, Width, Height, pBits + SrcRect.top * Pitch + SrcRect.left * sizeof(T), Pitch, Width, Height,
+			sizeof(T), IsColorKey, dColorKey, IsMirrorLeftRight, IsMirrorUpDown);
+		return;
+	}
+
+	T ColorKey;
+	memcpy(&ColorKey, &dColorKey, sizeof(T));
+
+	// Go bottom up when the destination is below the source so source rows are read before they are written
+	const bool IsBottomUp = !IsMirrorUpDown && DestRect.top > SrcRect.top;
+
+	// Go right to left when the destination is right of the source on the same rows
+	const bool IsBackward = DestRect.left > SrcRect.left;
+
+	for (LONG i = 0; i < Height; i++)
+	{
+		const LONG y = IsBottomUp ? Height - i - 1 : i;
+		const LONG SrcY = SrcRect.top + (IsMirrorUpDown ? Height - y - 1 : y);
+		const LONG DestY = DestRect.top + y;
+
+		const BYTE* pSrc = pBits + SrcY * Pitch + SrcRect.left * sizeof(T);
+		BYTE* pDest = pBits + DestY * Pitch + DestRect.left * sizeof(T);
+
+		// Different rows never share memory
+		if (SrcY != DestY)
+		{
+			BlitSurfaceRect(pDest, Pitch, Width, 1, pSrc, Pitch, Width, 1, sizeof(T), IsColorKey, dColorKey, IsMirrorLeftRight, false);
+		}
+		// Mirrored pixels on the same row depend on each other in both directions
+		else if (IsMirrorLeftRight)
+		{
+			memcpy(pRowBuffer, pSrc, RowSize);
+			BlitSurfaceRect(pDest, Pitch, Width, 1, pRowBuffer, Pitch, Width, 1, sizeof(T), IsColorKey, dColorKey, true, false);
+		}
+		else
+		{
+			BlitRowInPlace<T>(pSrc, pDest, Width, ColorKey, IsColorKey, IsBackward);
+		}
+	}
+}
+
+// Blit between two rects of the same locked area, pBits is the top left of the area that holds both rects and the row
+// buffer needs to hold one row of the rect, it is only used when mirroring left and right
+void BlitInPlace(void* pBits, LONG Pitch, DWORD ByteCount, const RECT& SrcRect, const RECT& DestRect, bool IsColorKey, DWORD ColorKey, bool IsMirrorLeftRight, bool IsMirrorUpDown, void* pRowBuffer)
+{
+	switch (ByteCount)
+	{
+	case 1:
+		BlitInPlaceT<BYTE>((BYTE*)pBits, Pitch, SrcRect, DestRect, ColorKey, IsColorKey, IsMirrorLeftRight, IsMirrorUpDown, (BYTE*)pRowBuffer);
+		break;
+	case 2:
+		BlitInPlaceT<WORD>((BYTE*)pBits, Pitch, SrcRect, DestRect, ColorKey, IsColorKey, IsMirrorLeftRight, IsMirrorUpDown, (BYTE*)pRowBuffer);
+		break;
+	case 3:
+		BlitInPlaceT<TRIBYTE>((BYTE*)pBits, Pitch, SrcRect, DestRect, ColorKey, IsColorKey, IsMirrorLeftRight, IsMirrorUpDown, (BYTE*)pRowBuffer);
+		break;
+	case 4:
+		BlitInPlaceT<DWORD>((BYTE*)pBits, Pitch, SrcRect, DestRect, ColorKey, IsColorKey, IsMirrorLeftRight, IsMirrorUpDown, (BYTE*)pRowBuffer);
+		break;
+	}
+}
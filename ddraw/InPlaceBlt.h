@@ -0,0 +1,6 @@
+#pragma once
+
+#include <d3d9.h>
+
+bool CanBlitInPlace(const RECT& SrcRect, const RECT& DestRect, bool IsMirrorUpDown);
+void BlitInPlace(void* pBits, LONG Pitch, DWORD ByteCount, const RECT& SrcRect, const RECT& DestRect, bool IsColorKey, DWORD ColorKey, bool IsMirrorLeftRight, bool IsMirrorUpDown, void* pRowBuffer);
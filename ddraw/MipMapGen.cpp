@@ -0,0 +1,254 @@
+/**
+* Copyright (C) 2024 Elisha Riedlinger
+*
+* This software is  provided 'as-is', without any express  or implied  warranty. In no event will the
+* authors be held liable for any damages arising from the use of this software.
+* Permission  is granted  to anyone  to use  this software  for  any  purpose,  including  commercial
+* applications, and to alter it and redistribute it freely, subject to the following restrictions:
+*
+*   1. The origin of this software must not be misrepresented; you must not claim that you  wrote the
+*      original  software. If you use this  software  in a product, an  acknowledgment in the product
+*      documentation would be appreciated but is not required.
+*   2. Altered source versions must  be plainly  marked as such, and  must not be  misrepresented  as
+*      being the original software.
+*   3. This notice may not be removed or altered from any source distribution.
+*
+* Each destination texel is the rounded average of a 2x2 block of the level above it. The last row or
+* column of odd sized levels is dropped, levels that are one texel wide or tall reuse the edge texel.
+*/
+
+#include <emmintrin.h>
+#include "MipMapGen.h"
+#include "Utils\Utils.h"
+
+// Channel layout of a 16-bit format
+struct MIPMAPFORMAT16
+{
+	DWORD ChannelCount;
+	DWORD Shift[4];
+	DWORD Mask[4];
+};
+
+static const MIPMAPFORMAT16 Format565 = { 3, { 11, 5, 0 }, { 0x1F, 0x3F, 0x1F } };
+static const MIPMAPFORMAT16 Format1555 = { 4, { 15, 10, 5, 0 }, { 0x01, 0x1F, 0x1F, 0x1F } };
+static const MIPMAPFORMAT16 Format4444 = { 4, { 12, 8, 4, 0 }, { 0x0F, 0x0F, 0x0F, 0x0F } };
+
+static inline const MIPMAPFORMAT16* GetFormat16(D3DFORMAT Format)
+{
+	switch ((DWORD)Format)
+	{
+	case D3DFMT_R5G6B5:
+		return &Format565;
+	case D3DFMT_X1R5G5B5:
+	case D3DFMT_A1R5G5B5:
+		return &Format1555;
+	case D3DFMT_X4R4G4B4:
+	case D3DFMT_A4R4G4B4:
+		return &Format4444;
+	default:
+		return nullptr;
+	}
+}
+
+static inline bool IsFormat32(D3DFORMAT Format)
+{
+	switch ((DWORD)Format)
+	{
+	case D3DFMT_X8R8G8B8:
+	case D3DFMT_A8R8G8B8:
+	case D3DFMT_X8B8G8R8:
+	case D3DFMT_A8B8G8R8:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// Averages four 32-bit texels, each byte is a separate channel
+static inline DWORD Average32(DWORD a, DWORD b, DWORD c, DWORD d)
+{
+	DWORD Result = 0;
+	for (DWORD Shift = 0; Shift < 32; Shift += 8)
+	{
+		DWORD Sum = ((a >> Shift) & 0xFF) + ((b >> Shift) & 0xFF) + ((c >> Shift) & 0xFF) + ((d >> Shift) & 0xFF);
+		Result |= ((Sum + 2) >> 2) << Shift;
+	}
+	return Result;
+}
+
+static inline WORD Average16(const MIPMAPFORMAT16& Layout, WORD a, WORD b, WORD c, WORD d)
+{
+	DWORD Result = 0;
+	for (DWORD x = 0; x < Layout.ChannelCount; x++)
+	{
+		const DWORD Shift = Layout.Shift[x];
+		const DWORD Mask = Layout.Mask[x];
+		DWORD Sum = ((a >> Shift) & Mask) + ((b >> Shift) & Mask) + ((c >> Shift) & Mask) + ((d >> Shift) & Mask);
+		Result |= ((Sum + 2) >> 2) << Shift;
+	}
+	return (WORD)Result;
+}
+
+// Filters texels from Start to Width, source columns past the edge of the row are clamped
+static inline void FilterRowScalar32(const DWORD* pRow0, const DWORD* pRow1, DWORD SrcWidth, DWORD* pDest, DWORD Start, DWORD Width)
+{
+	for (DWORD x = Start; x < Width; x++)
+	{
+		DWORD x0 = min(x * 2, SrcWidth - 1);
+		DWORD x1 = min(x * 2 + 1, SrcWidth - 1);
+		pDest[x] = Average32(pRow0[x0], pRow0[x1], pRow1[x0], pRow1[x1]);
+	}
+}
+
+static inline void FilterRowScalar16(const MIPMAPFORMAT16& Layout, const WORD* pRow0, const WORD* pRow1, DWORD SrcWidth, WORD* pDest, DWORD Start, DWORD Width)
+{
+	for (DWORD x = Start; x < Width; x++)
+	{
+		DWORD x0 = min(x * 2, SrcWidth - 1);
+		DWORD x1 = min(x * 2 + 1, SrcWidth - 1);
+		pDest[x] = Average16(Layout, pRow0[x0], pRow0[x1], pRow1[x0], pRow1[x1]);
+	}
+}
+
+// Filters four destination texels per step from eight source texels on each row, returns the number of texels done
+static inline DWORD FilterRowSSE32(const DWORD* pRow0, const DWORD* pRow1, DWORD* pDest, DWORD Width)
+{
+	const __m128i Zero = _mm_setzero_si128();
+	const __m128i Round = _mm_set1_epi16(2);
+
+	DWORD x = 0;
+	for (; x + 4 <= Width; x += 4)
+	{
+		__m128i a0 = _mm_loadu_si128((const __m128i*)(pRow0 + x * 2));
+		__m128i a1 = _mm_loadu_si128((const __m128i*)(pRow0 + x * 2 + 4));
+		__m128i b0 = _mm_loadu_si128((const __m128i*)(pRow1 + x * 2));
+		__m128i b1 = _mm_loadu_si128((const __m128i*)(pRow1 + x * 2 + 4));
+
+		// Vertical sums, two source texels per register with 16 bits per channel
+		__m128i s01 = _mm_add_epi16(_mm_unpacklo_epi8(a0, Zero), _mm_unpacklo_epi8(b0, Zero));
+		__m128i s23 = _mm_add_epi16(_mm_unpackhi_epi8(a0, Zero), _mm_unpackhi_epi8(b0, Zero));
+		__m128i s45 = _mm_add_epi16(_mm_unpacklo_epi8(a1, Zero), _mm_unpacklo_epi8(b1, Zero));
+		__m128i s67 = _mm_add_epi16(_mm_unpackhi_epi8(a1, Zero), _mm_unpackhi_epi8(b1, Zero));
+
+		// Horizontal sums of each texel pair
+		__m128i d01 = _mm_add_epi16(_mm_unpacklo_epi64(s01, s23), _mm_unpackhi_epi64(s01, s23));
+		__m128i d23 = _mm_add_epi16(_mm_unpacklo_epi64(s45, s67), _mm_unpackhi_epi64(s45, s67));
+
+		d01 = _mm_srli_epi16(_mm_add_epi16(d01, Round), 2);
+		d23 = _mm_srli_epi16(_mm_add_epi16(d23, Round), 2);
+
+		_mm_storeu_si128((__m128i*)(pDest + x), _mm_packus_epi16(d01, d23));
+	}
+	return x;
+}
+
+// Filters eight destination texels per step from sixteen source texels on each row, returns the number of texels done
+static inline DWORD FilterRowSSE16(const MIPMAPFORMAT16& Layout, const WORD* pRow0, const WORD* pRow1, WORD* pDest, DWORD Width)
+{
+	const __m128i One = _mm_set1_epi16(1);
+	const __m128i Round = _mm_set1_epi32(2);
+
+	DWORD x = 0;
+	for (; x + 8 <= Width; x += 8)
+	{
+		__m128i a0 = _mm_loadu_si128((const __m128i*)(pRow0 + x * 2));
+		__m128i a1 = _mm_loadu_si128((const __m128i*)(pRow0 + x * 2 + 8));
+		__m128i b0 = _mm_loadu_si128((const __m128i*)(pRow1 + x * 2));
+		__m128i b1 = _mm_loadu_si128((const __m128i*)(pRow1 + x * 2 + 8));
+
+		__m128i Result = _mm_setzero_si128();
+		for (DWORD c = 0; c < Layout.ChannelCount; c++)
+		{
+			const __m128i Shift = _mm_cvtsi32_si128(Layout.Shift[c]);
+			const __m128i Mask = _mm_set1_epi16((short)Layout.Mask[c]);
+
+			// Vertical sums of the channel
+			__m128i s0 = _mm_add_epi16(_mm_and_si128(_mm_srl_epi16(a0, Shift), Mask), _mm_and_si128(_mm_srl_epi16(b0, Shift), Mask));
+			__m128i s1 = _mm_add_epi16(_mm_and_si128(_mm_srl_epi16(a1, Shift), Mask), _mm_and_si128(_mm_srl_epi16(b1, Shift), Mask));
+
+			// Horizontal sums of each texel pair, channels are small enough that signed packing is exact
+			__m128i d0 = _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(s0, One), Round), 2);
+			__m128i d1 = _mm_srli_epi32(_mm_add_epi32(_mm_madd_epi16(s1, One), Round), 2);
+
+			Result = _mm_or_si128(Result, _mm_sll_epi16(_mm_packs_epi32(d0, d1), Shift));
+		}
+
+		_mm_storeu_si128((__m128i*)(pDest + x), Result);
+	}
+	return x;
+}
+
+bool IsMipMapGenFormatSupported(D3DFORMAT Format)
+{
+	return IsFormat32(Format) || GetFormat16(Format) != nullptr;
+}
+
+// Box filters the source level into the destination level, the destination is normally half the size of the source
+void GenerateMipMapLevel(D3DFORMAT Format, const void* pSrcBits, LONG SrcPitch, DWORD SrcWidth, DWORD SrcHeight, void* pDestBits, LONG DestPitch, DWORD DestWidth, DWORD DestHeight)
+{
+	if (!pSrcBits || !pDestBits || !SrcWidth || !SrcHeight || !IsMipMapGenFormatSupported(Format))
+	{
+		return;
+	}
+
+	const MIPMAPFORMAT16* Layout = GetFormat16(Format);
+	const bool UseSSE2 = Utils::IsSSE2Supported();
+
+	// Destination texels whose 2x2 block lies fully inside the source row
+	const DWORD FullWidth = min(DestWidth, SrcWidth / 2);
+
+	for (DWORD y = 0; y < DestHeight; y++)
+	{
+		const BYTE* pRow0 = (const BYTE*)pSrcBits + min(y * 2, SrcHeight - 1) * SrcPitch;
+		const BYTE* pRow1 = (const BYTE*)pSrcBits + min(y * 2 + 1, SrcHeight - 1) * SrcPitch;
+		BYTE* pDest = (BYTE*)pDestBits + y * DestPitch;
+
+		if (Layout)
+		{
+			DWORD Done = UseSSE2 ? FilterRowSSE16(*Layout, (const WORD*)pRow0, (const WORD*)pRow1, (WORD*)pDest, FullWidth) : 0;
+			FilterRowScalar16(*Layout, (const WORD*)pRow0, (const WORD*)pRow1, SrcWidth, (WORD*)pDest, Done, DestWidth);
+		}
+		else
+		{
+			DWORD Done = UseSSE2 ? FilterRowSSE32((const DWORD*)pRow0, (const DWORD*)pRow1, (DWORD*)pDest, FullWidth) : 0;
+			FilterRowScalar32((const DWORD*)pRow0, (const DWORD*)pRow1, SrcWidth, (DWORD*)pDest, Done, DestWidth);
+		}
+	}
+}
+
+// Builds the destination level from the source level, fails if the surfaces cannot be locked or the format is not supported
+HRESULT GenerateMipMapSurface(LPDIRECT3DSURFACE9 pSourceSurface, LPDIRECT3DSURFACE9 pDestSurface)
+{
+	if (!pSourceSurface || !pDestSurface || pSourceSurface == pDestSurface)
+	{
+		return D3DERR_INVALIDCALL;
+	}
+
+	D3DSURFACE_DESC SrcDesc = {}, DestDesc = {};
+	if (FAILED(pSourceSurface->GetDesc(&SrcDesc)) || FAILED(pDestSurface->GetDesc(&DestDesc)) ||
+		SrcDesc.Format != DestDesc.Format || !IsMipMapGenFormatSupported(SrcDesc.Format))
+	{
+		return D3DERR_INVALIDCALL;
+	}
+
+	D3DLOCKED_RECT SrcLockRect = {};
+	HRESULT hr = pSourceSurface->LockRect(&SrcLockRect, nullptr, D3DLOCK_READONLY);
+	if (FAILED(hr))
+	{
+		return hr;
+	}
+
+	D3DLOCKED_RECT DestLockRect = {};
+	hr = pDestSurface->LockRect(&DestLockRect, nullptr, 0);
+	if (SUCCEEDED(hr))
+	{
+		GenerateMipMapLevel(SrcDesc.Format, SrcLockRect.pBits, SrcLockRect.Pitch, SrcDesc.Width, SrcDesc.Height,
+			DestLockRect.pBits, DestLockRect.Pitch, DestDesc.Width, DestDesc.Height);
+
+		pDestSurface->UnlockRect();
+	}
+
+	pSourceSurface->UnlockRect();
+
+	return hr;
+}
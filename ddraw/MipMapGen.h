@@ -0,0 +1,7 @@
+#pragma once
+
+#include <d3d9.h>
+
+bool IsMipMapGenFormatSupported(D3DFORMAT Format);
+void GenerateMipMapLevel(D3DFORMAT Format, const void* pSrcBits, LONG SrcPitch, DWORD SrcWidth, DWORD SrcHeight, void* pDestBits, LONG DestPitch, DWORD DestWidth, DWORD DestHeight);
+HRESULT GenerateMipMapSurface(LPDIRECT3DSURFACE9 pSourceSurface, LPDIRECT3DSURFACE9 pDestSurface);
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <vector>
+
+// Set of pointers that keeps insertion order. Lookups use an open addressing table of indexes into the
+// ordered list. Removed entries are cleared in the list and only compacted when adding, so removing
+// while iterating is safe.
+template <typename T>
+class PointerSet
+{
+private:
+	std::vector<T*> Items;				// Pointers in insertion order, removed entries are nullptr
+	std::vector<size_t> Slots;			// Index into Items plus one, zero is an empty slot
+	size_t Count = 0;
+
+	inline size_t GetHome(const T* Item) const
+	{
+		// Fibonacci hashing, the low bits of a pointer are mostly alignment
+		return (size_t)(((unsigned long long)(size_t)Item * 0x9E3779B97F4A7C15ULL) >> 32) & (Slots.size() - 1);
+	}
+
+	inline size_t FindSlot(const T* Item) const
+	{
+		if (!Item || Slots.empty())
+		{
+			return (size_t)-1;
+		}
+		for (size_t x = GetHome(Item); Slots[x]; x = (x + 1) & (Slots.size() - 1))
+		{
+			if (Items[Slots[x] - 1] == Item)
+			{
+				return x;
+			}
+		}
+		return (size_t)-1;
+	}
+
+	inline void InsertSlot(size_t Index)
+	{
+		size_t x = GetHome(Items[Index]);
+		while (Slots[x])
+		{
+			x = (x + 1) & (Slots.size() - 1);
+		}
+		Slots[x] = Index + 1;
+	}
+
+	// Drops removed entries and rebuilds the table so it is at most half full
+	void Rebuild(size_t NewCount)
+	{
+		size_t Index = 0;
+		for (T* Item : Items)
+		{
+			if (Item)
+			{
+				Items[Index++] = Item;
+			}
+		}
+		Items.resize(Index);
+
+		size_t Size = 16;
+		while (Size < NewCount * 2)
+		{
+			Size *= 2;
+		}
+		Slots.assign(Size, 0);
+		for (size_t x = 0; x < Items.size(); x++)
+		{
+			InsertSlot(x);
+		}
+	}
+
+public:
+	class iterator
+	{
+	private:
+		T* const* Pos;
+		T* const* End;
+
+		inline void SkipRemoved()
+		{
+			while (Pos != End && !*Pos)
+			{
+				Pos++;
+			}
+		}
+
+	public:
+		iterator(T* const* pPos, T* const* pEnd) : Pos(pPos), End(pEnd) { SkipRemoved(); }
+		inline T* const& operator*() const { return *Pos; }
+		inline iterator& operator++() { Pos++; SkipRemoved(); return *this; }
+		inline bool operator==(const iterator& other) const { return Pos == other.Pos; }
+		inline bool operator!=(const iterator& other) const { return Pos != other.Pos; }
+	};
+
+	inline iterator begin() const { return iterator(Items.data(), Items.data() + Items.size()); }
+	inline iterator end() const { return iterator(Items.data() + Items.size(), Items.data() + Items.size()); }
+	inline size_t size() const { return Count; }
+	inline bool empty() const { return Count == 0; }
+
+	inline bool contains(const T* Item) const
+	{
+		return FindSlot(Item) != (size_t)-1;
+	}
+
+	// Adds the pointer at the end, returns false if it is null or already in the set
+	bool insert(T* Item)
+	{
+		if (!Item || contains(Item))
+		{
+			return false;
+		}
+		if ((Count + 1) * 2 > Slots.size() || Items.size() >= Slots.size())
+		{
+			Rebuild(Count + 1);
+		}
+		Items.push_back(Item);
+		InsertSlot(Items.size() - 1);
+		Count++;
+		return true;
+	}
+
+	// Removes the pointer, returns false if it is not in the set
+	bool erase(const T* Item)
+	{
+		size_t x = FindSlot(Item);
+		if (x == (size_t)-1)
+		{
+			return false;
+		}
+		Items[Slots[x] - 1] = nullptr;
+		Count--;
+
+		// Shift back following entries of the probe run so lookups never need tombstones
+		const size_t Mask = Slots.size() - 1;
+		size_t Hole = x;
+		for (size_t y = (x + 1) & Mask; Slots[y]; y = (y + 1) & Mask)
+		{
+			size_t Home = GetHome(Items[Slots[y] - 1]);
+			if (((y - Home) & Mask) >= ((y - Hole) & Mask))
+			{
+				Slots[Hole] = Slots[y];
+				Hole = y;
+			}
+		}
+		Slots[Hole] = 0;
+		return true;
+	}
+
+	void clear()
+	{
+		Items.clear();
+		Slots.clear();
+		Count = 0;
+	}
+};
@@ -0,0 +1,127 @@
+#pragma once
+
+#include <vector>
+#include <utility>
+
+// Sorted map stored in a flat array. The first N entries are kept inside the object, larger maps move
+// to the heap. Iterators are pointers to the entries and are invalidated when the map is changed.
+template <typename K, typename V, size_t N>
+class SmallFlatMap
+{
+public:
+	typedef std::pair<K, V> value_type;
+	typedef value_type* iterator;
+	typedef const value_type* const_iterator;
+
+private:
+	value_type Inline[N] = {};
+	std::vector<value_type> Heap;
+	size_t Count = 0;
+	bool IsHeap = false;
+
+	inline value_type* Data() { return IsHeap ? Heap.data() : Inline; }
+	inline const value_type* Data() const { return IsHeap ? Heap.data() : Inline; }
+
+	inline iterator LowerBound(const K& Key)
+	{
+		iterator it = begin();
+		size_t Size = Count;
+		while (Size)
+		{
+			size_t Half = Size / 2;
+			if (it[Half].first < Key)
+			{
+				it += Half + 1;
+				Size -= Half + 1;
+			}
+			else
+			{
+				Size = Half;
+			}
+		}
+		return it;
+	}
+
+public:
+	inline iterator begin() { return Data(); }
+	inline iterator end() { return Data() + Count; }
+	inline const_iterator begin() const { return Data(); }
+	inline const_iterator end() const { return Data() + Count; }
+	inline size_t size() const { return Count; }
+	inline bool empty() const { return Count == 0; }
+
+	iterator find(const K& Key)
+	{
+		iterator it = LowerBound(Key);
+		return (it != end() && !(Key < it->first)) ? it : end();
+	}
+
+	// Returns the first entry with a key greater than the key
+	iterator upper_bound(const K& Key)
+	{
+		iterator it = LowerBound(Key);
+		return (it != end() && !(Key < it->first)) ? it + 1 : it;
+	}
+
+	// Returns the value for the key, adds a default value if the key is not in the map
+	V& operator[](const K& Key)
+	{
+		iterator it = LowerBound(Key);
+		if (it != end() && !(Key < it->first))
+		{
+			return it->second;
+		}
+
+		size_t Index = it - begin();
+		if (!IsHeap && Count == N)
+		{
+			Heap.reserve(N * 2);
+			Heap.assign(Inline, Inline + N);
+			IsHeap = true;
+		}
+		if (IsHeap)
+		{
+			Heap.insert(Heap.begin() + Index, value_type(Key, V()));
+		}
+		else
+		{
+			for (size_t x = Count; x > Index; x--)
+			{
+				Inline[x] = Inline[x - 1];
+			}
+			Inline[Index] = value_type(Key, V());
+		}
+		Count++;
+		return Data()[Index].second;
+	}
+
+	iterator erase(iterator it)
+	{
+		size_t Index = it - begin();
+		if (IsHeap)
+		{
+			Heap.erase(Heap.begin() + Index);
+		}
+		else
+		{
+			for (size_t x = Index; x + 1 < Count; x++)
+			{
+				Inline[x] = Inline[x + 1];
+			}
+			Inline[Count - 1] = value_type();
+		}
+		Count--;
+		return begin() + Index;
+	}
+
+	void clear()
+	{
+		for (size_t x = 0; x < N; x++)
+		{
+			Inline[x] = value_type();
+		}
+		Heap.clear();
+		Count = 0;
+		IsHeap = false;
+	}
+};
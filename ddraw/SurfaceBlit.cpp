@@ -0,0 +1,373 @@
+/**
+* Copyright (C) 2024 Elisha Riedlinger
+*
+* This software is  provided 'as-is', without any express  or implied  warranty. In no event will the
+* authors be held liable for any damages arising from the use of this software.
+* Permission  is granted  to anyone  to use  this software  for  any  purpose,  including  commercial
+* applications, and to alter it and redistribute it freely, subject to the following restrictions:
+*
+*   1. The origin of this software must not be misrepresented; you must not claim that you  wrote the
+*      original  software. If you use this  software  in a product, an  acknowledgment in the product
+*      documentation would be appreciated but is not required.
+*   2. Altered source versions must  be plainly  marked as such, and  must not be  misrepresented  as
+*      being the original software.
+*   3. This notice may not be removed or altered from any source distribution.
+*
+*
+* Pixel blits for surfaces that are copied with the CPU. Each pixel size, color key and mirror setting
+* has its own row function made from the same templates, picked from a table as in the DDrawCompat
+* blitter. Row functions use AVX2 or SSE2 when the CPU has them and the scalar loop does the rest of
+* the row. Stretched blits look up the source column of each pixel in a table built once per blit.
+*/
+
+#include <string.h>
+#include <vector>
+#include <emmintrin.h>
+#include <immintrin.h>
+#include "SurfaceBlit.h"
+#include "SurfaceCopy.h"
+#include "IDirectDrawTypes.h"
+#include "Utils\Utils.h"
+
+// Row functions return the number of pixels done, the color key is stored in the low bytes
+typedef DWORD(*BLITROWFUNC)(BYTE* pDest, const BYTE* pSrc, DWORD Width, DWORD ColorKey);
+
+template <typename T> static inline __m128i SetKeySSE2(DWORD ColorKey);
+template <> inline __m128i SetKeySSE2<BYTE>(DWORD ColorKey) { return _mm_set1_epi8((char)ColorKey); }
+template <> inline __m128i SetKeySSE2<WORD>(DWORD ColorKey) { return _mm_set1_epi16((short)ColorKey); }
+template <> inline __m128i SetKeySSE2<DWORD>(DWORD ColorKey) { return _mm_set1_epi32((int)ColorKey); }
+
+template <typename T> static inline __m128i CmpEqSSE2(__m128i a, __m128i b);
+template <> inline __m128i CmpEqSSE2<BYTE>(__m128i a, __m128i b) { return _mm_cmpeq_epi8(a, b); }
+template <> inline __m128i CmpEqSSE2<WORD>(__m128i a, __m128i b) { return _mm_cmpeq_epi16(a, b); }
+template <> inline __m128i CmpEqSSE2<DWORD>(__m128i a, __m128i b) { return _mm_cmpeq_epi32(a, b); }
+
+// Reverse the order of the pixels in the vector
+template <typename T> static inline __m128i ReverseSSE2(__m128i v);
+template <> inline __m128i ReverseSSE2<DWORD>(__m128i v)
+{
+	return _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+}
+template <> inline __m128i ReverseSSE2<WORD>(__m128i v)
+{
+	v = _mm_shuffle_epi32(v, _MM_SHUFFLE(0, 1, 2, 3));
+	v = _mm_shufflelo_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+	return _mm_shufflehi_epi16(v, _MM_SHUFFLE(2, 3, 0, 1));
+}
+template <> inline __m128i ReverseSSE2<BYTE>(__m128i v)
+{
+	v = ReverseSSE2<WORD>(v);
+	return _mm_or_si128(_mm_slli_epi16(v, 8), _mm_srli_epi16(v, 8));
+}
+
+template <typename T> static inline __m256i SetKeyAVX2(DWORD ColorKey);
+template <> inline __m256i SetKeyAVX2<BYTE>(DWORD ColorKey) { return _mm256_set1_epi8((char)ColorKey); }
+template <> inline __m256i SetKeyAVX2<WORD>(DWORD ColorKey) { return _mm256_set1_epi16((short)ColorKey); }
+template <> inline __m256i SetKeyAVX2<DWORD>(DWORD ColorKey) { return _mm256_set1_epi32((int)ColorKey); }
+
+template <typename T> static inline __m256i CmpEqAVX2(__m256i a, __m256i b);
+template <> inline __m256i CmpEqAVX2<BYTE>(__m256i a, __m256i b) { return _mm256_cmpeq_epi8(a, b); }
+template <> inline __m256i CmpEqAVX2<WORD>(__m256i a, __m256i b) { return _mm256_cmpeq_epi16(a, b); }
+template <> inline __m256i CmpEqAVX2<DWORD>(__m256i a, __m256i b) { return _mm256_cmpeq_epi32(a, b); }
+
+// Reverse the order of the pixels in the vector, byte shuffles only work inside each 128-bit half so the halves are swapped after
+template <typename T> static inline __m256i ReverseAVX2(__m256i v);
+template <> inline __m256i ReverseAVX2<DWORD>(__m256i v)
+{
+	return _mm256_permutevar8x32_epi32(v, _mm256_setr_epi32(7, 6, 5, 4, 3, 2, 1, 0));
+}
+template <> inline __m256i ReverseAVX2<WORD>(__m256i v)
+{
+	v = _mm256_shuffle_epi8(v, _mm256_setr_epi8(14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1,
+		14, 15, 12, 13, 10, 11, 8, 9, 6, 7, 4, 5, 2, 3, 0, 1));
+	return _mm256_permute4x64_epi64(v, _MM_SHUFFLE(1, 0, 3, 2));
+}
+template <> inline __m256i ReverseAVX2<BYTE>(__m256i v)
+{
+	v = _mm256_shuffle_epi8(v, _mm256_setr_epi8(15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0,
+		15, 14, 13, 12, 11, 10, 9, 8, 7, 6, 5, 4, 3, 2, 1, 0));
+	return _mm256_permute4x64_epi64(v, _MM_SHUFFLE(1, 0, 3, 2));
+}
+
+template <typename T, bool IsColorKey, bool IsMirror>
+static DWORD BlitRowSSE2(BYTE* pDest, const BYTE* pSrc, DWORD Width, DWORD ColorKey)
+{
+	constexpr DWORD Step = 16 / sizeof(T);
+	const __m128i Key = SetKeySSE2<T>(ColorKey);
+
+	DWORD x = 0;
+	for (; x + Step <= Width; x += Step)
+	{
+		__m128i Src;
+		if constexpr (IsMirror)
+		{
+			Src = ReverseSSE2<T>(_mm_loadu_si128((const __m128i*)(pSrc + (Width - x - Step) * sizeof(T))));
+		}
+		else
+		{
+			Src = _mm_loadu_si128((const __m128i*)(pSrc + x * sizeof(T)));
+		}
+		if constexpr (IsColorKey)
+		{
+			__m128i Mask = CmpEqSSE2<T>(Src, Key);
+			int Bits = _mm_movemask_epi8(Mask);
+
+			// Skip the store when every pixel is transparent
+			if (Bits == 0xFFFF)
+			{
+				continue;
+			}
+			if (Bits)
+			{
+				__m128i Dest = _mm_loadu_si128((const __m128i*)(pDest + x * sizeof(T)));
+				Src = _mm_or_si128(_mm_andnot_si128(Mask, Src), _mm_and_si128(Mask, Dest));
+			}
+		}
+		_mm_storeu_si128((__m128i*)(pDest + x * sizeof(T)), Src);
+	}
+	return x;
+}
+
+template <typename T, bool IsColorKey, bool IsMirror>
+static DWORD BlitRowAVX2(BYTE* pDest, const BYTE* pSrc, DWORD Width, DWORD ColorKey)
+{
+	constexpr DWORD Step = 32 / sizeof(T);
+	const __m256i Key = SetKeyAVX2<T>(ColorKey);
+
+	DWORD x = 0;
+	for (; x + Step <= Width; x += Step)
+	{
+		__m256i Src;
+		if constexpr (IsMirror)
+		{
+			Src = ReverseAVX2<T>(_mm256_loadu_si256((const __m256i*)(pSrc + (Width - x - Step) * sizeof(T))));
+		}
+		else
+		{
+			Src = _mm256_loadu_si256((const __m256i*)(pSrc + x * sizeof(T)));
+		}
+		if constexpr (IsColorKey)
+		{
+			__m256i Mask = CmpEqAVX2<T>(Src, Key);
+			int Bits = _mm256_movemask_epi8(Mask);
+
+			// Skip the store when every pixel is transparent
+			if (Bits == -1)
+			{
+				continue;
+			}
+			if (Bits)
+			{
+				Src = _mm256_blendv_epi8(Src, _mm256_loadu_si256((const __m256i*)(pDest + x * sizeof(T))), Mask);
+			}
+		}
+		_mm256_storeu_si256((__m256i*)(pDest + x * sizeof(T)), Src);
+	}
+	_mm256_zeroupper();
+	return x;
+}
+
+// Color key copy of 24-bit pixels, eight pixels per step with four pixels in each half of the vector. Each half
+// is loaded from 16 bytes so two more pixels need to be left in the row, the pixels are widened to 32 bits to
+// compare them with the color key. The first half stores four bytes of old destination data that the second
+// half then overwrites.
+static DWORD BlitRow24ColorKeyAVX2(BYTE* pDest, const BYTE* pSrc, DWORD Width, DWORD ColorKey)
+{
+	const __m256i Widen = _mm256_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1,
+		0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const __m256i Narrow = _mm256_setr_epi8(0, 0, 0, 4, 4, 4, 8, 8, 8, 12, 12, 12, -1, -1, -1, -1,
+		0, 0, 0, 4, 4, 4, 8, 8, 8, 12, 12, 12, -1, -1, -1, -1);
+	const __m256i Tail = _mm256_setr_epi32(0, 0, 0, -1, 0, 0, 0, -1);
+	const __m256i Key = _mm256_set1_epi32((int)(ColorKey & 0x00FFFFFF));
+
+	DWORD x = 0;
+	for (; x + 10 <= Width; x += 8)
+	{
+		const BYTE* pSrcPixel = pSrc + x * 3;
+		BYTE* pDestPixel = pDest + x * 3;
+
+		__m256i Src = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)pSrcPixel)),
+			_mm_loadu_si128((const __m128i*)(pSrcPixel + 12)), 1);
+		__m256i Mask = _mm256_cmpeq_epi32(_mm256_shuffle_epi8(Src, Widen), Key);
+
+		// Skip the store when every pixel is transparent
+		if (_mm256_movemask_epi8(Mask) == -1)
+		{
+			continue;
+		}
+
+		__m256i Dest = _mm256_inserti128_si256(_mm256_castsi128_si256(_mm_loadu_si128((const __m128i*)pDestPixel)),
+			_mm_loadu_si128((const __m128i*)(pDestPixel + 12)), 1);
+		__m256i Keep = _mm256_or_si256(_mm256_shuffle_epi8(Mask, Narrow), Tail);
+		__m256i Out = _mm256_blendv_epi8(Src, Dest, Keep);
+
+		_mm_storeu_si128((__m128i*)pDestPixel, _mm256_castsi256_si128(Out));
+		_mm_storeu_si128((__m128i*)(pDestPixel + 12), _mm256_extracti128_si256(Out, 1));
+	}
+	_mm256_zeroupper();
+	return x;
+}
+
+template <typename T, bool IsColorKey, bool IsMirror>
+static void BlitRowScalar(BYTE* pDest, const BYTE* pSrc, DWORD x, DWORD Width, T ColorKey)
+{
+	T* DestRow = reinterpret_cast<T*>(pDest);
+	const T* SrcRow = reinterpret_cast<const T*>(pSrc);
+
+	if constexpr (!IsColorKey && !IsMirror)
+	{
+		memcpy(DestRow + x, SrcRow + x, (Width - x) * sizeof(T));
+		return;
+	}
+
+	for (; x < Width; x++)
+	{
+		T PixelColor = SrcRow[IsMirror ? Width - x - 1 : x];
+		if constexpr (IsColorKey)
+		{
+			if (PixelColor != ColorKey)
+			{
+				DestRow[x] = PixelColor;
+			}
+		}
+		else
+		{
+			DestRow[x] = PixelColor;
+		}
+	}
+}
+
+// Stretched row, mirroring is already in the source column table
+template <typename T, bool IsColorKey>
+static void BlitRowStretch(BYTE* pDest, const BYTE* pSrc, const DWORD* pSrcX, DWORD Width, T ColorKey)
+{
+	T* DestRow = reinterpret_cast<T*>(pDest);
+	const T* SrcRow = reinterpret_cast<const T*>(pSrc);
+
+	for (DWORD x = 0; x < Width; x++)
+	{
+		T PixelColor = SrcRow[pSrcX[x]];
+		if constexpr (IsColorKey)
+		{
+			if (PixelColor != ColorKey)
+			{
+				DestRow[x] = PixelColor;
+			}
+		}
+		else
+		{
+			DestRow[x] = PixelColor;
+		}
+	}
+}
+
+template <typename T, bool IsColorKey, bool IsMirror>
+static void BlitRectT(BYTE* pDest, LONG DestPitch, DWORD DestWidth, DWORD DestHeight, const BYTE* pSrc, LONG SrcPitch, DWORD SrcWidth, DWORD SrcHeight,
+	DWORD dColorKey, bool IsMirrorUpDown, BLITROWFUNC RowFunc)
+{
+	T ColorKey;
+	memcpy(&ColorKey, &dColorKey, sizeof(T));
+
+	// Source column of each destination pixel, this is floor(x * SrcWidth / DestWidth) without a division per pixel
+	std::vector<DWORD> SrcX;
+	if (SrcWidth != DestWidth)
+	{
+		SrcX.resize(DestWidth);
+		for (DWORD x = 0, sx = 0, Remainder = 0; x < DestWidth; x++)
+		{
+			SrcX[x] = IsMirror ? SrcWidth - sx - 1 : sx;
+			sx += SrcWidth / DestWidth;
+			Remainder += SrcWidth % DestWidth;
+			if (Remainder >= DestWidth)
+			{
+				Remainder -= DestWidth;
+				sx++;
+			}
+		}
+	}
+
+	const BYTE* pLastSrcRow = nullptr;
+	for (DWORD y = 0, sy = 0, Remainder = 0; y < DestHeight; y++)
+	{
+		const BYTE* pSrcRow = pSrc + (LONG)(IsMirrorUpDown ? SrcHeight - sy - 1 : sy) * SrcPitch;
+
+		// Rows stretched from the same source row are the same unless the color key keeps some of the old pixels
+		if (!IsColorKey && pSrcRow == pLastSrcRow)
+		{
+			memcpy(pDest, pDest - DestPitch, DestWidth * sizeof(T));
+		}
+		else if (SrcX.empty())
+		{
+			DWORD x = RowFunc ? RowFunc(pDest, pSrcRow, DestWidth, dColorKey) : 0;
+			BlitRowScalar<T, IsColorKey, IsMirror>(pDest, pSrcRow, x, DestWidth, ColorKey);
+		}
+		else
+		{
+			BlitRowStretch<T, IsColorKey>(pDest, pSrcRow, SrcX.data(), DestWidth, ColorKey);
+		}
+		pLastSrcRow = pSrcRow;
+		pDest += DestPitch;
+
+		sy += SrcHeight / DestHeight;
+		Remainder += SrcHeight % DestHeight;
+		if (Remainder >= DestHeight)
+		{
+			Remainder -= DestHeight;
+			sy++;
+		}
+	}
+}
+
+typedef void(*BLITRECTFUNC)(BYTE*, LONG, DWORD, DWORD, const BYTE*, LONG, DWORD, DWORD, DWORD, bool, BLITROWFUNC);
+
+// Tables are indexed by [ByteCount - 1][IsColorKey][IsMirrorLeftRight]
+static const BLITRECTFUNC BlitRectFuncs[4][2][2] = {
+	{ { BlitRectT<BYTE, false, false>, BlitRectT<BYTE, false, true> }, { BlitRectT<BYTE, true, false>, BlitRectT<BYTE, true, true> } },
+	{ { BlitRectT<WORD, false, false>, BlitRectT<WORD, false, true> }, { BlitRectT<WORD, true, false>, BlitRectT<WORD, true, true> } },
+	{ { BlitRectT<TRIBYTE, false, false>, BlitRectT<TRIBYTE, false, true> }, { BlitRectT<TRIBYTE, true, false>, BlitRectT<TRIBYTE, true, true> } },
+	{ { BlitRectT<DWORD, false, false>, BlitRectT<DWORD, false, true> }, { BlitRectT<DWORD, true, false>, BlitRectT<DWORD, true, true> } } };
+
+// Plain rows are left to memcpy
+static const BLITROWFUNC BlitRowFuncsSSE2[4][2][2] = {
+	{ { nullptr, BlitRowSSE2<BYTE, false, true> }, { BlitRowSSE2<BYTE, true, false>, BlitRowSSE2<BYTE, true, true> } },
+	{ { nullptr, BlitRowSSE2<WORD, false, true> }, { BlitRowSSE2<WORD, true, false>, BlitRowSSE2<WORD, true, true> } },
+	{ { nullptr, nullptr }, { nullptr, nullptr } },
+	{ { nullptr, BlitRowSSE2<DWORD, false, true> }, { BlitRowSSE2<DWORD, true, false>, BlitRowSSE2<DWORD, true, true> } } };
+
+static const BLITROWFUNC BlitRowFuncsAVX2[4][2][2] = {
+	{ { nullptr, BlitRowAVX2<BYTE, false, true> }, { BlitRowAVX2<BYTE, true, false>, BlitRowAVX2<BYTE, true, true> } },
+	{ { nullptr, BlitRowAVX2<WORD, false, true> }, { BlitRowAVX2<WORD, true, false>, BlitRowAVX2<WORD, true, true> } },
+	{ { nullptr, nullptr }, { BlitRow24ColorKeyAVX2, nullptr } },
+	{ { nullptr, BlitRowAVX2<DWORD, false, true> }, { BlitRowAVX2<DWORD, true, false>, BlitRowAVX2<DWORD, true, true> } } };
+
+// Blit with color key, mirroring and stretching, the color key is in the low bytes. Stretched blits use the
+// nearest source pixel to the left and above.
+void BlitSurfaceRect(void* pDestBits, LONG DestPitch, DWORD DestWidth, DWORD DestHeight, const void* pSrcBits, LONG SrcPitch, DWORD SrcWidth, DWORD SrcHeight,
+	DWORD ByteCount, bool IsColorKey, DWORD ColorKey, bool IsMirrorLeftRight, bool IsMirrorUpDown)
+{
+	if (!pDestBits || !pSrcBits || !DestWidth || !DestHeight || !SrcWidth || !SrcHeight || ByteCount < 1 || ByteCount > 4)
+	{
+		return;
+	}
+
+	// Plain copies go through the banded row copy
+	if (!IsColorKey && !IsMirrorLeftRight && SrcWidth == DestWidth && SrcHeight == DestHeight)
+	{
+		BYTE* pDest = (BYTE*)pDestBits;
+		if (IsMirrorUpDown)
+		{
+			pDest += (LONG)(DestHeight - 1) * DestPitch;
+			DestPitch = -DestPitch;
+		}
+		CopySurfaceRows(pDest, DestPitch, pSrcBits, SrcPitch, DestWidth * ByteCount, DestHeight, false);
+		return;
+	}
+
+	const BLITROWFUNC RowFunc =
+		Utils::IsAVX2Supported() ? BlitRowFuncsAVX2[ByteCount - 1][IsColorKey][IsMirrorLeftRight] :
+		Utils::IsSSE2Supported() ? BlitRowFuncsSSE2[ByteCount - 1][IsColorKey][IsMirrorLeftRight] :
+		nullptr;
+
+	BlitRectFuncs[ByteCount - 1][IsColorKey][IsMirrorLeftRight]((BYTE*)pDestBits, DestPitch, DestWidth, DestHeight, (const BYTE*)pSrcBits, SrcPitch, SrcWidth, SrcHeight,
+		ColorKey, IsMirrorUpDown, RowFunc);
+}
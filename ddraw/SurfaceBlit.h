@@ -0,0 +1,6 @@
+#pragma once
+
+#include <d3d9.h>
+
+void BlitSurfaceRect(void* pDestBits, LONG DestPitch, DWORD DestWidth, DWORD DestHeight, const void* pSrcBits, LONG SrcPitch, DWORD SrcWidth, DWORD SrcHeight,
+	DWORD ByteCount, bool IsColorKey, DWORD ColorKey, bool IsMirrorLeftRight, bool IsMirrorUpDown);
@@ -0,0 +1,322 @@
+/**
+* Copyright (C) 2024 Elisha Riedlinger
+*
+* This software is  provided 'as-is', without any express  or implied  warranty. In no event will the
+* authors be held liable for any damages arising from the use of this software.
+* Permission  is granted  to anyone  to use  this software  for  any  purpose,  including  commercial
+* applications, and to alter it and redistribute it freely, subject to the following restrictions:
+*
+*   1. The origin of this software must not be misrepresented; you must not claim that you  wrote the
+*      original  software. If you use this  software  in a product, an  acknowledgment in the product
+*      documentation would be appreciated but is not required.
+*   2. Altered source versions must  be plainly  marked as such, and  must not be  misrepresented  as
+*      being the original software.
+*   3. This notice may not be removed or altered from any source distribution.
+*
+*
+* Large row copies are split into bands of rows that fit in the cache. The bands are shared out to a
+* small pool of worker threads that stays alive between copies, the calling thread copies bands too.
+* Other banded surface work such as DXT conversion runs on the same pool.
+* Large copies to surfaces that are not read back by the CPU use non-temporal stores so they do not
+* push the source data out of the cache.
+*/
+
+#include <emmintrin.h>
+#include "SurfaceCopy.h"
+#include "Utils\Utils.h"
+
+// Copies smaller than this are done on the calling thread
+constexpr size_t SurfaceCopyMinThreadedBytes = 1024 * 1024;
+
+// Copies smaller than this use normal stores, they fit in the last level cache of most systems
+constexpr size_t SurfaceCopyMinStreamBytes = 8 * 1024 * 1024;
+
+// Size of the row bands handed out to the threads
+constexpr size_t SurfaceCopyBandBytes = 256 * 1024;
+
+// Largest number of worker threads, the calling thread is not counted
+constexpr DWORD SurfaceCopyMaxThreads = 4;
+
+struct SURFACECOPYJOB
+{
+	BYTE* pDestBits = nullptr;
+	const BYTE* pSrcBits = nullptr;
+	LONG DestPitch = 0;
+	LONG SrcPitch = 0;
+	size_t RowSize = 0;
+	DWORD RowCount = 0;
+	DWORD BandRows = 0;
+	bool Stream = false;
+};
+
+struct SURFACEBANDJOB
+{
+	SURFACEBANDFUNC BandFunc = nullptr;
+	void* pContext = nullptr;
+	DWORD BandCount = 0;
+	volatile LONG NextBand = 0;
+};
+
+struct SURFACECOPYTHREADS
+{
+	volatile LONG InitLock = 0;
+	volatile bool IsInitialized = false;
+	CRITICAL_SECTION cpcs = {};
+	DWORD ThreadCount = 0;
+	HANDLE workerEvent[SurfaceCopyMaxThreads] = {};
+	HANDLE doneEvent[SurfaceCopyMaxThreads] = {};
+	HANDLE workerThread[SurfaceCopyMaxThreads] = {};
+	bool EnableThreadFlag = false;
+	SURFACEBANDJOB Job;
+};
+
+SURFACECOPYTHREADS CopyThreads;
+
+DWORD WINAPI SurfaceCopyThreadFunction(LPVOID lpParameter);
+
+// Bands can be run from threads other than the ddraw thread, such as the surface dump thread, so starting and closing the pool is serialized
+static void SetSurfaceCopyInitLock()
+{
+	while (InterlockedCompareExchange(&CopyThreads.InitLock, 1, 0) != 0)
+	{
+		Sleep(0);
+	}
+}
+
+static void ReleaseSurfaceCopyInitLock()
+{
+	InterlockedExchange(&CopyThreads.InitLock, 0);
+}
+
+// Copies with 16 byte non-temporal stores, the unaligned start and end use normal stores
+static void StreamCopy(BYTE* pDest, const BYTE* pSrc, size_t Size)
+{
+	size_t Head = (16 - ((size_t)pDest & 15)) & 15;
+	if (Size < Head + 64)
+	{
+		memcpy(pDest, pSrc, Size);
+		return;
+	}
+	memcpy(pDest, pSrc, Head);
+	pDest += Head;
+	pSrc += Head;
+	Size -= Head;
+
+	for (; Size >= 64; Size -= 64, pDest += 64, pSrc += 64)
+	{
+		__m128i a = _mm_loadu_si128((const __m128i*)pSrc);
+		__m128i b = _mm_loadu_si128((const __m128i*)(pSrc + 16));
+		__m128i c = _mm_loadu_si128((const __m128i*)(pSrc + 32));
+		__m128i d = _mm_loadu_si128((const __m128i*)(pSrc + 48));
+		_mm_stream_si128((__m128i*)pDest, a);
+		_mm_stream_si128((__m128i*)(pDest + 16), b);
+		_mm_stream_si128((__m128i*)(pDest + 32), c);
+		_mm_stream_si128((__m128i*)(pDest + 48), d);
+	}
+	memcpy(pDest, pSrc, Size);
+}
+
+static void CopyRowRange(const SURFACECOPYJOB& Job, DWORD FirstRow, DWORD RowCount)
+{
+	BYTE* pDest = Job.pDestBits + (LONG_PTR)Job.DestPitch * FirstRow;
+	const BYTE* pSrc = Job.pSrcBits + (LONG_PTR)Job.SrcPitch * FirstRow;
+
+	// Rows without gaps are copied as one block
+	if (Job.DestPitch == Job.SrcPitch && (size_t)Job.DestPitch == Job.RowSize)
+	{
+		Job.Stream ? StreamCopy(pDest, pSrc, Job.RowSize * RowCount) : (void)memcpy(pDest, pSrc, Job.RowSize * RowCount);
+		return;
+	}
+
+	for (DWORD y = 0; y < RowCount; y++)
+	{
+		Job.Stream ? StreamCopy(pDest, pSrc, Job.RowSize) : (void)memcpy(pDest, pSrc, Job.RowSize);
+		pDest += Job.DestPitch;
+		pSrc += Job.SrcPitch;
+	}
+}
+
+static void CopySurfaceBand(void* pContext, DWORD Band)
+{
+	const SURFACECOPYJOB& Job = *(const SURFACECOPYJOB*)pContext;
+	const DWORD FirstRow = Band * Job.BandRows;
+	CopyRowRange(Job, FirstRow, min(Job.BandRows, Job.RowCount - FirstRow));
+	if (Job.Stream)
+	{
+		_mm_sfence();
+	}
+}
+
+// Runs bands until none are left, used by the worker threads and the calling thread
+static void RunSurfaceBandJob(SURFACEBANDJOB& Job)
+{
+	LONG Band;
+	while ((Band = InterlockedIncrement(&Job.NextBand) - 1) < (LONG)Job.BandCount)
+	{
+		Job.BandFunc(Job.pContext, Band);
+	}
+}
+
+static void InitSurfaceCopyThreads()
+{
+	SYSTEM_INFO SystemInfo = {};
+	GetSystemInfo(&SystemInfo);
+
+	InitializeCriticalSection(&CopyThreads.cpcs);
+	CopyThreads.EnableThreadFlag = true;
+	CopyThreads.ThreadCount = 0;
+	for (DWORD x = 0; x + 1 < SystemInfo.dwNumberOfProcessors && x < SurfaceCopyMaxThreads; x++)
+	{
+		// Events are stored before the thread starts since the thread reads them
+		CopyThreads.workerEvent[x] = CreateEvent(NULL, FALSE, FALSE, NULL);
+		CopyThreads.doneEvent[x] = CreateEvent(NULL, FALSE, FALSE, NULL);
+		CopyThreads.workerThread[x] = (CopyThreads.workerEvent[x] && CopyThreads.doneEvent[x]) ?
+			CreateThread(NULL, 0, SurfaceCopyThreadFunction, (LPVOID)(ULONG_PTR)x, 0, NULL) : NULL;
+		if (!CopyThreads.workerThread[x])
+		{
+			if (CopyThreads.workerEvent[x]) CloseHandle(CopyThreads.workerEvent[x]);
+			if (CopyThreads.doneEvent[x]) CloseHandle(CopyThreads.doneEvent[x]);
+			CopyThreads.workerEvent[x] = NULL;
+			CopyThreads.doneEvent[x] = NULL;
+			break;
+		}
+		CopyThreads.ThreadCount++;
+	}
+	CopyThreads.IsInitialized = true;
+}
+
+// Runs the bands on the worker pool and the calling thread, bands run on the calling thread alone if the pool is busy
+void RunSurfaceBands(SURFACEBANDFUNC BandFunc, void* pContext, DWORD BandCount)
+{
+	if (!BandFunc || !BandCount)
+	{
+		return;
+	}
+
+	if (BandCount > 1)
+	{
+		if (!CopyThreads.IsInitialized)
+		{
+			SetSurfaceCopyInitLock();
+			if (!CopyThreads.IsInitialized)
+			{
+				InitSurfaceCopyThreads();
+			}
+			ReleaseSurfaceCopyInitLock();
+		}
+
+		// Use the pool unless another thread is already using it
+		if (CopyThreads.ThreadCount && TryEnterCriticalSection(&CopyThreads.cpcs))
+		{
+			SURFACEBANDJOB& PoolJob = CopyThreads.Job;
+			PoolJob.BandFunc = BandFunc;
+			PoolJob.pContext = pContext;
+			PoolJob.BandCount = BandCount;
+			PoolJob.NextBand = 0;
+
+			const DWORD WorkerCount = min(CopyThreads.ThreadCount, BandCount - 1);
+			for (DWORD x = 0; x < WorkerCount; x++)
+			{
+				SetEvent(CopyThreads.workerEvent[x]);
+			}
+			RunSurfaceBandJob(PoolJob);
+			if (WorkerCount)
+			{
+				WaitForMultipleObjects(WorkerCount, CopyThreads.doneEvent, TRUE, INFINITE);
+			}
+
+			LeaveCriticalSection(&CopyThreads.cpcs);
+			return;
+		}
+	}
+
+	for (DWORD Band = 0; Band < BandCount; Band++)
+	{
+		BandFunc(pContext, Band);
+	}
+}
+
+// Copies rows between surfaces, pitches can be negative
+void CopySurfaceRows(void* pDestBits, LONG DestPitch, const void* pSrcBits, LONG SrcPitch, size_t RowSize, DWORD RowCount, bool StreamDest)
+{
+	if (!pDestBits || !pSrcBits || !RowSize || !RowCount)
+	{
+		return;
+	}
+
+	const size_t TotalSize = RowSize * RowCount;
+
+	SURFACECOPYJOB Job;
+	Job.pDestBits = (BYTE*)pDestBits;
+	Job.pSrcBits = (const BYTE*)pSrcBits;
+	Job.DestPitch = DestPitch;
+	Job.SrcPitch = SrcPitch;
+	Job.RowSize = RowSize;
+	Job.RowCount = RowCount;
+	Job.Stream = StreamDest && TotalSize >= SurfaceCopyMinStreamBytes && Utils::IsSSE2Supported();
+
+	if (TotalSize >= SurfaceCopyMinThreadedBytes)
+	{
+		Job.BandRows = (DWORD)max((size_t)1, SurfaceCopyBandBytes / RowSize);
+		RunSurfaceBands(CopySurfaceBand, &Job, (RowCount + Job.BandRows - 1) / Job.BandRows);
+		return;
+	}
+
+	Job.BandRows = RowCount;
+	CopySurfaceBand(&Job, 0);
+}
+
+// Closes the copy worker threads, they are started again by the next large copy
+void CloseSurfaceCopyThreads()
+{
+	SetSurfaceCopyInitLock();
+	if (CopyThreads.IsInitialized)
+	{
+		EnterCriticalSection(&CopyThreads.cpcs);
+		CopyThreads.EnableThreadFlag = false;						// Tell threads to exit
+		for (DWORD x = 0; x < CopyThreads.ThreadCount; x++)
+		{
+			SetEvent(CopyThreads.workerEvent[x]);					// Trigger thread
+		}
+		LeaveCriticalSection(&CopyThreads.cpcs);
+		if (CopyThreads.ThreadCount)
+		{
+			WaitForMultipleObjects(CopyThreads.ThreadCount, CopyThreads.workerThread, TRUE, INFINITE);	// Wait for threads to finish
+		}
+		for (DWORD x = 0; x < CopyThreads.ThreadCount; x++)
+		{
+			CloseHandle(CopyThreads.workerThread[x]);				// Close thread handle
+			CloseHandle(CopyThreads.workerEvent[x]);				// Close event handles
+			CloseHandle(CopyThreads.doneEvent[x]);
+			CopyThreads.workerThread[x] = NULL;
+			CopyThreads.workerEvent[x] = NULL;
+			CopyThreads.doneEvent[x] = NULL;
+		}
+		DeleteCriticalSection(&CopyThreads.cpcs);
+		CopyThreads.ThreadCount = 0;
+		CopyThreads.IsInitialized = false;
+	}
+	ReleaseSurfaceCopyInitLock();
+}
+
+// Copy Thread: Copy bands of the current job each time it is triggered
+DWORD WINAPI SurfaceCopyThreadFunction(LPVOID lpParameter)
+{
+	const DWORD Index = (DWORD)(ULONG_PTR)lpParameter;
+
+	while (true)
+	{
+		WaitForSingleObject(CopyThreads.workerEvent[Index], INFINITE);
+
+		if (!CopyThreads.EnableThreadFlag)
+		{
+			break;
+		}
+
+		RunSurfaceBandJob(CopyThreads.Job);
+
+		SetEvent(CopyThreads.doneEvent[Index]);
+	}
+
+	return 0;
+}
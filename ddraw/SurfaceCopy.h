@@ -0,0 +1,9 @@
+#pragma once
+
+#include <d3d9.h>
+
+typedef void(*SURFACEBANDFUNC)(void* pContext, DWORD Band);
+
+void RunSurfaceBands(SURFACEBANDFUNC BandFunc, void* pContext, DWORD BandCount);
+void CopySurfaceRows(void* pDestBits, LONG DestPitch, const void* pSrcBits, LONG SrcPitch, size_t RowSize, DWORD RowCount, bool StreamDest);
+void CloseSurfaceCopyThreads();
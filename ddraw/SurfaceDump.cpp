@@ -0,0 +1,539 @@
+/**
+* Copyright (C) 2024 Elisha Riedlinger
+*
+* This software is  provided 'as-is', without any express  or implied  warranty. In no event will the
+* authors be held liable for any damages arising from the use of this software.
+* Permission  is granted  to anyone  to use  this software  for  any  purpose,  including  commercial
+* applications, and to alter it and redistribute it freely, subject to the following restrictions:
+*
+*   1. The origin of this software must not be misrepresented; you must not claim that you  wrote the
+*      original  software. If you use this  software  in a product, an  acknowledgment in the product
+*      documentation would be appreciated but is not required.
+*   2. Altered source versions must  be plainly  marked as such, and  must not be  misrepresented  as
+*      being the original software.
+*   3. This notice may not be removed or altered from any source distribution.
+*
+* Surface dumps are copied into pooled buffers on the calling thread, then converted and written to
+* disk by a worker thread. Queued data is limited, a dump of a file that is still queued replaces the
+* queued data and other dumps are dropped while the queue is full.
+*/
+
+#include <fstream>
+#include <string>
+#include <deque>
+#include <algorithm>
+#include "ddraw.h"
+#include "SurfaceDump.h"
+#include "ColorKeyConvert.h"
+#include "DXTCodec.h"
+
+// Most surface data that can be waiting to be written
+constexpr size_t SurfaceDumpMaxQueuedBytes = 64 * 1024 * 1024;
+
+// Most free buffers kept for reuse
+constexpr size_t SurfaceDumpMaxPoolBuffers = 8;
+
+// Most memory held by the free buffers
+constexpr size_t SurfaceDumpMaxPoolBytes = 32 * 1024 * 1024;
+
+struct SURFACEDUMP
+{
+	std::string FileName;
+	D3DXIMAGE_FILEFORMAT FileFormat = D3DXIFF_BMP;
+	D3DFORMAT Format = D3DFMT_UNKNOWN;
+	DWORD Width = 0;
+	DWORD Height = 0;
+	LONG Pitch = 0;
+	std::vector<BYTE> Data;
+	bool HasPalette = false;
+	PALETTEENTRY Palette[MaxPaletteSize] = {};
+};
+
+struct SURFACEDUMPTHREAD
+{
+	bool IsInitialized = false;
+	CRITICAL_SECTION dscs = {};
+	HANDLE workerEvent = {};
+	HANDLE workerThread = {};
+	bool EnableThreadFlag = false;
+	std::deque<SURFACEDUMP> Queue;
+	std::vector<std::vector<BYTE>> Pool;
+	size_t PoolBytes = 0;
+	size_t QueuedBytes = 0;
+	DWORD DroppedCount = 0;
+	DWORD ReplacedCount = 0;
+};
+
+SURFACEDUMPTHREAD DumpThread;
+
+DWORD WINAPI SurfaceDumpThreadFunction(LPVOID);
+
+// Size of one row of the surface data, DXT rows are rows of blocks
+static inline DWORD GetDumpRowSize(D3DFORMAT Format, DWORD Width)
+{
+	switch ((DWORD)Format)
+	{
+	case D3DFMT_DXT1:
+		return ((Width + 3) / 4) * 8;
+	case D3DFMT_DXT2:
+	case D3DFMT_DXT3:
+	case D3DFMT_DXT4:
+	case D3DFMT_DXT5:
+		return ((Width + 3) / 4) * 16;
+	case D3DFMT_P8:
+		return Width;
+	case D3DFMT_X8R8G8B8:
+	case D3DFMT_A8R8G8B8:
+		return Width * 4;
+	default:
+		return Width * 2;
+	}
+}
+
+static inline DWORD GetDumpRowCount(D3DFORMAT Format, DWORD Height)
+{
+	return IsDXTCodecFormat(Format) ? (Height + 3) / 4 : Height;
+}
+
+// Returns a pooled buffer with at least the requested size, called with the critical section held
+static std::vector<BYTE> GetPoolBuffer(size_t Size)
+{
+	auto Best = DumpThread.Pool.end();
+	for (auto it = DumpThread.Pool.begin(); it != DumpThread.Pool.end(); it++)
+	{
+		if (it->capacity() >= Size && (Best == DumpThread.Pool.end() || it->capacity() < Best->capacity()))
+		{
+			Best = it;
+		}
+	}
+
+	std::vector<BYTE> Buffer;
+	if (Best != DumpThread.Pool.end())
+	{
+		DumpThread.PoolBytes -= Best->capacity();
+		Buffer.swap(*Best);
+		DumpThread.Pool.erase(Best);
+	}
+	Buffer.resize(Size);
+	return Buffer;
+}
+
+// Called with the critical section held
+static void ReturnPoolBuffer(std::vector<BYTE>& Buffer)
+{
+	if (DumpThread.Pool.size() < SurfaceDumpMaxPoolBuffers && DumpThread.PoolBytes + Buffer.capacity() <= SurfaceDumpMaxPoolBytes)
+	{
+		DumpThread.PoolBytes += Buffer.capacity();
+		DumpThread.Pool.emplace_back();
+		DumpThread.Pool.back().swap(Buffer);
+	}
+	else
+	{
+		std::vector<BYTE>().swap(Buffer);
+	}
+}
+
+static void AppendBytes(std::vector<BYTE>& Output, const void* pData, size_t Size)
+{
+	Output.insert(Output.end(), (const BYTE*)pData, (const BYTE*)pData + Size);
+}
+
+static void AppendBigEndian(std::vector<BYTE>& Output, DWORD Value)
+{
+	BYTE Bytes[4] = { (BYTE)(Value >> 24), (BYTE)(Value >> 16), (BYTE)(Value >> 8), (BYTE)Value };
+	AppendBytes(Output, Bytes, sizeof(Bytes));
+}
+
+static DWORD GetCRC32(const BYTE* pData, size_t Size)
+{
+	static DWORD Table[256] = {};
+	if (!Table[1])
+	{
+		for (DWORD x = 0; x < 256; x++)
+		{
+			DWORD Value = x;
+			for (int k = 0; k < 8; k++)
+			{
+				Value = (Value & 1) ? 0xEDB88320 ^ (Value >> 1) : Value >> 1;
+			}
+			Table[x] = Value;
+		}
+	}
+
+	DWORD CRC = 0xFFFFFFFF;
+	for (size_t x = 0; x < Size; x++)
+	{
+		CRC = Table[(CRC ^ pData[x]) & 0xFF] ^ (CRC >> 8);
+	}
+	return CRC ^ 0xFFFFFFFF;
+}
+
+static DWORD UpdateAdler32(DWORD Adler, const BYTE* pData, size_t Size)
+{
+	DWORD Sum1 = Adler & 0xFFFF, Sum2 = Adler >> 16;
+	while (Size)
+	{
+		// Largest run that cannot overflow before taking the modulo
+		size_t Run = min(Size, (size_t)5552);
+		Size -= Run;
+		while (Run--)
+		{
+			Sum1 += *pData++;
+			Sum2 += Sum1;
+		}
+		Sum1 %= 65521;
+		Sum2 %= 65521;
+	}
+	return (Sum2 << 16) | Sum1;
+}
+
+// Adds data as stored deflate blocks, a new block header is added every 65535 bytes
+static void AppendStoredBlocks(std::vector<BYTE>& Output, const BYTE* pData, size_t Size, size_t& BlockLeft, size_t& RawLeft)
+{
+	while (Size)
+	{
+		if (!BlockLeft)
+		{
+			BlockLeft = min(RawLeft, (size_t)0xFFFF);
+			RawLeft -= BlockLeft;
+			BYTE BlockHeader[5] = { (BYTE)(RawLeft ? 0 : 1), (BYTE)BlockLeft, (BYTE)(BlockLeft >> 8), (BYTE)~BlockLeft, (BYTE)(~BlockLeft >> 8) };
+			AppendBytes(Output, BlockHeader, sizeof(BlockHeader));
+		}
+		size_t Count = min(Size, BlockLeft);
+		AppendBytes(Output, pData, Count);
+		pData += Count;
+		Size -= Count;
+		BlockLeft -= Count;
+	}
+}
+
+// Starts a PNG chunk, the length is filled in when the chunk is finished
+static size_t StartPNGChunk(std::vector<BYTE>& Output, const char* Type)
+{
+	size_t ChunkStart = Output.size();
+	AppendBigEndian(Output, 0);
+	AppendBytes(Output, Type, 4);
+	return ChunkStart;
+}
+
+static void FinishPNGChunk(std::vector<BYTE>& Output, size_t ChunkStart)
+{
+	DWORD Size = (DWORD)(Output.size() - ChunkStart - 8);
+	Output[ChunkStart + 0] = (BYTE)(Size >> 24);
+	Output[ChunkStart + 1] = (BYTE)(Size >> 16);
+	Output[ChunkStart + 2] = (BYTE)(Size >> 8);
+	Output[ChunkStart + 3] = (BYTE)Size;
+	AppendBigEndian(Output, GetCRC32(Output.data() + ChunkStart + 4, Size + 4));
+}
+
+// Writes an uncompressed BMP from A8R8G8B8 data
+static void EncodeBMP(std::vector<BYTE>& Output, const BYTE* pBits, LONG Pitch, DWORD Width, DWORD Height)
+{
+	const DWORD ImageSize = Width * Height * 4;
+
+	BITMAPFILEHEADER FileHeader = {};
+	FileHeader.bfType = 0x4D42;	// "BM"
+	FileHeader.bfOffBits = sizeof(BITMAPFILEHEADER) + sizeof(BITMAPINFOHEADER);
+	FileHeader.bfSize = FileHeader.bfOffBits + ImageSize;
+
+	BITMAPINFOHEADER InfoHeader = {};
+	InfoHeader.biSize = sizeof(BITMAPINFOHEADER);
+	InfoHeader.biWidth = Width;
+	InfoHeader.biHeight = -(LONG)Height;	// Top-down
+	InfoHeader.biPlanes = 1;
+	InfoHeader.biBitCount = 32;
+	InfoHeader.biCompression = BI_RGB;
+	InfoHeader.biSizeImage = ImageSize;
+
+	Output.reserve(FileHeader.bfSize);
+	AppendBytes(Output, &FileHeader, sizeof(FileHeader));
+	AppendBytes(Output, &InfoHeader, sizeof(InfoHeader));
+	for (DWORD y = 0; y < Height; y++)
+	{
+		AppendBytes(Output, pBits + y * Pitch, Width * 4);
+	}
+}
+
+// Writes a PNG from A8R8G8B8 data using stored deflate blocks
+static void EncodePNG(std::vector<BYTE>& Output, const BYTE* pBits, LONG Pitch, DWORD Width, DWORD Height)
+{
+	const size_t RawSize = (size_t)Height * (1 + Width * 4);
+	Output.reserve(64 + RawSize + (RawSize / 0xFFFF + 1) * 5);
+
+	const BYTE Signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+	AppendBytes(Output, Signature, sizeof(Signature));
+
+	size_t ChunkStart = StartPNGChunk(Output, "IHDR");
+	AppendBigEndian(Output, Width);
+	AppendBigEndian(Output, Height);
+	const BYTE Header[5] = { 8, 6, 0, 0, 0 };	// 8-bit RGBA, deflate, no filter, no interlace
+	AppendBytes(Output, Header, sizeof(Header));
+	FinishPNGChunk(Output, ChunkStart);
+
+	ChunkStart = StartPNGChunk(Output, "IDAT");
+	const BYTE ZlibHeader[2] = { 0x78, 0x01 };
+	AppendBytes(Output, ZlibHeader, sizeof(ZlibHeader));
+
+	// Each row starts with filter type 0, texels are stored in R, G, B, A order
+	std::vector<BYTE> Row(1 + Width * 4);
+	DWORD Adler = 1;
+	size_t BlockLeft = 0, RawLeft = RawSize;
+	for (DWORD y = 0; y < Height; y++)
+	{
+		const BYTE* pRow = pBits + y * Pitch;
+		for (DWORD x = 0; x < Width; x++)
+		{
+			Row[1 + x * 4 + 0] = pRow[x * 4 + 2];
+			Row[1 + x * 4 + 1] = pRow[x * 4 + 1];
+			Row[1 + x * 4 + 2] = pRow[x * 4 + 0];
+			Row[1 + x * 4 + 3] = pRow[x * 4 + 3];
+		}
+		AppendStoredBlocks(Output, Row.data(), Row.size(), BlockLeft, RawLeft);
+		Adler = UpdateAdler32(Adler, Row.data(), Row.size());
+	}
+	AppendBigEndian(Output, Adler);
+	FinishPNGChunk(Output, ChunkStart);
+
+	ChunkStart = StartPNGChunk(Output, "IEND");
+	FinishPNGChunk(Output, ChunkStart);
+}
+
+// Writes a DDS file, DXT data is stored as is and other formats as A8R8G8B8
+static void EncodeDDS(std::vector<BYTE>& Output, const SURFACEDUMP& Dump, const BYTE* pBits, LONG Pitch)
+{
+	const bool IsDXT = IsDXTCodecFormat(Dump.Format);
+	const DWORD RowSize = IsDXT ? GetDumpRowSize(Dump.Format, Dump.Width) : Dump.Width * 4;
+	const DWORD RowCount = GetDumpRowCount(Dump.Format, Dump.Height);
+
+	DDS_HEADER Header = {};
+	Header.dwSize = sizeof(DDS_HEADER);
+	Header.dwFlags = DDS_HEADER_FLAGS_TEXTURE | (IsDXT ? DDSD_LINEARSIZE : DDS_HEADER_FLAGS_PITCH);
+	Header.dwHeight = Dump.Height;
+	Header.dwWidth = Dump.Width;
+	Header.dwPitchOrLinearSize = IsDXT ? RowSize * RowCount : RowSize;
+	Header.ddspf.dwSize = sizeof(DDS_PIXELFORMAT);
+	if (IsDXT)
+	{
+		Header.ddspf.dwFlags = DDPF_FOURCC;
+		Header.ddspf.dwFourCC = Dump.Format;
+	}
+	else
+	{
+		Header.ddspf.dwFlags = DDPF_RGB | DDPF_ALPHAPIXELS;
+		Header.ddspf.dwRGBBitCount = 32;
+		Header.ddspf.dwRBitMask = 0x00FF0000;
+		Header.ddspf.dwGBitMask = 0x0000FF00;
+		Header.ddspf.dwBBitMask = 0x000000FF;
+		Header.ddspf.dwABitMask = 0xFF000000;
+	}
+	Header.dwCaps = DDSCAPS_TEXTURE;
+
+	Output.reserve(DDS_HEADER_SIZE + RowSize * RowCount);
+	AppendBytes(Output, &DDS_MAGIC, sizeof(DDS_MAGIC));
+	AppendBytes(Output, &Header, sizeof(Header));
+	for (DWORD y = 0; y < RowCount; y++)
+	{
+		AppendBytes(Output, pBits + y * Pitch, RowSize);
+	}
+}
+
+// Converts and writes one dump, runs on the dump thread
+static void WriteSurfaceDump(const SURFACEDUMP& Dump, std::vector<BYTE>& ConvertBuffer, std::vector<BYTE>& Output)
+{
+	const BYTE* pBits = Dump.Data.data();
+	LONG Pitch = Dump.Pitch;
+
+	// Everything except DXT data stored in a DDS file is converted to A8R8G8B8 first
+	if (!(Dump.FileFormat == D3DXIFF_DDS && IsDXTCodecFormat(Dump.Format)))
+	{
+		ConvertBuffer.resize((size_t)Dump.Width * Dump.Height * 4);
+		if (IsDXTCodecFormat(Dump.Format))
+		{
+			DecodeDXT(Dump.Format, pBits, Pitch, ConvertBuffer.data(), Dump.Width * 4, Dump.Width, Dump.Height);
+		}
+		else
+		{
+			ConvertColorKeyToAlpha(Dump.Format, pBits, Pitch, Dump.HasPalette ? Dump.Palette : nullptr, ConvertBuffer.data(), Dump.Width * 4, Dump.Width, Dump.Height, false, 0);
+		}
+		pBits = ConvertBuffer.data();
+		Pitch = Dump.Width * 4;
+	}
+
+	Output.clear();
+	switch (Dump.FileFormat)
+	{
+	case D3DXIFF_BMP:
+		EncodeBMP(Output, pBits, Pitch, Dump.Width, Dump.Height);
+		break;
+	case D3DXIFF_PNG:
+		EncodePNG(Output, pBits, Pitch, Dump.Width, Dump.Height);
+		break;
+	default:
+		EncodeDDS(Output, Dump, pBits, Pitch);
+		break;
+	}
+
+	std::ofstream outFile(Dump.FileName, std::ios::binary | std::ios::out);
+	if (outFile.is_open())
+	{
+		outFile.write((const char*)Output.data(), Output.size());
+		outFile.close();
+	}
+	else
+	{
+		LOG_LIMIT(100, __FUNCTION__ << " Error: could not open file: " << Dump.FileName.c_str());
+	}
+}
+
+bool IsSurfaceDumpSupported(D3DXIMAGE_FILEFORMAT FileFormat, D3DFORMAT Format)
+{
+	return (FileFormat == D3DXIFF_BMP || FileFormat == D3DXIFF_PNG || FileFormat == D3DXIFF_DDS) &&
+		(IsDXTCodecFormat(Format) || IsColorKeyConvertFormatSupported(Format));
+}
+
+// Copies the surface data and queues it for the dump thread, palette surfaces need the palette, called with the ddraw critical section held
+bool QueueSurfaceDump(const char* FileName, D3DXIMAGE_FILEFORMAT FileFormat, D3DFORMAT Format, const void* pBits, LONG Pitch, DWORD Width, DWORD Height, const PALETTEENTRY* pPalette)
+{
+	if (!FileName || !pBits || !Width || !Height || !IsSurfaceDumpSupported(FileFormat, Format) || (Format == D3DFMT_P8 && !pPalette))
+	{
+		return false;
+	}
+
+	if (!DumpThread.IsInitialized)
+	{
+		InitializeCriticalSection(&DumpThread.dscs);
+		DumpThread.workerEvent = CreateEvent(NULL, FALSE, FALSE, NULL);
+		DumpThread.EnableThreadFlag = true;
+		DumpThread.workerThread = CreateThread(NULL, 0, SurfaceDumpThreadFunction, NULL, 0, NULL);
+		DumpThread.IsInitialized = true;
+	}
+
+	const DWORD RowSize = GetDumpRowSize(Format, Width);
+	const DWORD RowCount = GetDumpRowCount(Format, Height);
+	const size_t Size = (size_t)RowSize * RowCount;
+
+	// Reserve memory for the copy, drop the dump if too much data is waiting to be written
+	std::vector<BYTE> Buffer;
+	EnterCriticalSection(&DumpThread.dscs);
+	auto Queued = std::find_if(DumpThread.Queue.begin(), DumpThread.Queue.end(), [&](const SURFACEDUMP& Entry) { return Entry.FileName == FileName; });
+	size_t ReplacedBytes = (Queued != DumpThread.Queue.end()) ? Queued->Data.size() : 0;
+	bool IsFull = !DumpThread.Queue.empty() && DumpThread.QueuedBytes - ReplacedBytes + Size > SurfaceDumpMaxQueuedBytes;
+	if (IsFull)
+	{
+		DumpThread.DroppedCount++;
+	}
+	else
+	{
+		DumpThread.QueuedBytes += Size;
+		Buffer = GetPoolBuffer(Size);
+	}
+	LeaveCriticalSection(&DumpThread.dscs);
+
+	if (IsFull)
+	{
+		LOG_LIMIT(100, __FUNCTION__ << " Warning: dump queue is full, dropping: " << FileName);
+		return false;
+	}
+
+	// Copy outside of the critical section so the dump thread is not blocked
+	SURFACEDUMP Dump;
+	Dump.FileName = FileName;
+	Dump.FileFormat = FileFormat;
+	Dump.Format = Format;
+	Dump.Width = Width;
+	Dump.Height = Height;
+	Dump.Pitch = RowSize;
+	Dump.Data.swap(Buffer);
+	for (DWORD y = 0; y < RowCount; y++)
+	{
+		memcpy(Dump.Data.data() + y * RowSize, (const BYTE*)pBits + y * Pitch, RowSize);
+	}
+	if (Format == D3DFMT_P8)
+	{
+		Dump.HasPalette = true;
+		memcpy(Dump.Palette, pPalette, sizeof(Dump.Palette));
+	}
+
+	EnterCriticalSection(&DumpThread.dscs);
+
+	// A dump of a file that is still waiting to be written replaces it
+	auto it = std::find_if(DumpThread.Queue.begin(), DumpThread.Queue.end(), [&](const SURFACEDUMP& Entry) { return Entry.FileName == Dump.FileName; });
+	if (it != DumpThread.Queue.end())
+	{
+		DumpThread.QueuedBytes -= it->Data.size();
+		ReturnPoolBuffer(it->Data);
+		*it = std::move(Dump);
+		DumpThread.ReplacedCount++;
+	}
+	else
+	{
+		DumpThread.Queue.push_back(std::move(Dump));
+	}
+
+	LeaveCriticalSection(&DumpThread.dscs);
+
+	SetEvent(DumpThread.workerEvent);
+
+	return true;
+}
+
+// Writes all queued dumps then closes the dump thread
+void CloseSurfaceDumpThread()
+{
+	if (DumpThread.IsInitialized)
+	{
+		EnterCriticalSection(&DumpThread.dscs);
+		DumpThread.EnableThreadFlag = false;					// Tell thread to exit once the queue is empty
+		LeaveCriticalSection(&DumpThread.dscs);
+		SetEvent(DumpThread.workerEvent);						// Trigger thread
+		WaitForSingleObject(DumpThread.workerThread, INFINITE);	// Wait for thread to finish
+		CloseHandle(DumpThread.workerThread);					// Close thread handle
+		CloseHandle(DumpThread.workerEvent);					// Close event handle
+		DeleteCriticalSection(&DumpThread.dscs);
+		DumpThread.Pool.clear();
+		DumpThread.PoolBytes = 0;
+		DumpThread.DroppedCount = 0;
+		DumpThread.ReplacedCount = 0;
+		DumpThread.IsInitialized = false;
+	}
+}
+
+// Dump Thread: Write queued surfaces in order
+DWORD WINAPI SurfaceDumpThreadFunction(LPVOID)
+{
+	LOG_LIMIT(100, __FUNCTION__ << " Creating thread!");
+
+	// Buffers only used by this thread
+	std::vector<BYTE> ConvertBuffer;
+	std::vector<BYTE> Output;
+
+	while (true)
+	{
+		WaitForSingleObject(DumpThread.workerEvent, INFINITE);
+
+		EnterCriticalSection(&DumpThread.dscs);
+		while (!DumpThread.Queue.empty())
+		{
+			SURFACEDUMP Dump = std::move(DumpThread.Queue.front());
+			DumpThread.Queue.pop_front();
+			LeaveCriticalSection(&DumpThread.dscs);
+
+			WriteSurfaceDump(Dump, ConvertBuffer, Output);
+
+			EnterCriticalSection(&DumpThread.dscs);
+			DumpThread.QueuedBytes -= Dump.Data.size();
+			ReturnPoolBuffer(Dump.Data);
+		}
+		bool EnableThreadFlag = DumpThread.EnableThreadFlag;
+		LeaveCriticalSection(&DumpThread.dscs);
+
+		if (!EnableThreadFlag)
+		{
+			break;
+		}
+	}
+
+	LOG_LIMIT(100, __FUNCTION__ << " Closing thread! Dropped: " << DumpThread.DroppedCount << " Replaced: " << DumpThread.ReplacedCount);
+
+	return 0;
+}
@@ -0,0 +1,8 @@
+#pragma once
+
+#include <d3d9.h>
+#include "d3dx9.h"
+
+bool IsSurfaceDumpSupported(D3DXIMAGE_FILEFORMAT FileFormat, D3DFORMAT Format);
+bool QueueSurfaceDump(const char* FileName, D3DXIMAGE_FILEFORMAT FileFormat, D3DFORMAT Format, const void* pBits, LONG Pitch, DWORD Width, DWORD Height, const PALETTEENTRY* pPalette);
+void CloseSurfaceDumpThread();
@@ -32,7 +32,7 @@
 AddressLookupTableDdraw<void> ProxyAddressLookupTable = AddressLookupTableDdraw<void>();
 
 // Store a list of clipper
-std::vector<m_IDirectDrawClipper*> BaseClipperVector;
+PointerSet<m_IDirectDrawClipper> BaseClipperVector;
 
 CRITICAL_SECTION ddcs;
 bool IsInitialized = false;
@@ -895,7 +895,7 @@ void AddBaseClipperToVetor(m_IDirectDrawClipper* lpClipper)
 		return;
 	}
 
-	BaseClipperVector.push_back(lpClipper);
+	BaseClipperVector.insert(lpClipper);
 }
 
 void RemoveBaseClipperFromVector(m_IDirectDrawClipper* lpClipper)
@@ -905,7 +905,7 @@ void RemoveBaseClipperFromVector(m_IDirectDrawClipper* lpClipper)
 		return;
 	}
 
-	BaseClipperVector.erase(std::remove(BaseClipperVector.begin(), BaseClipperVector.end(), lpClipper), BaseClipperVector.end());
+	BaseClipperVector.erase(lpClipper);
 }
 
 bool DoesBaseClipperExist(m_IDirectDrawClipper* lpClipper)
@@ -915,7 +915,7 @@ bool DoesBaseClipperExist(m_IDirectDrawClipper* lpClipper)
 		return false;
 	}
 
-	return (std::find(BaseClipperVector.begin(), BaseClipperVector.end(), lpClipper) != std::end(BaseClipperVector));
+	return BaseClipperVector.contains(lpClipper);
 }
 
 HRESULT DdrawWrapper::SetCriticalSection()
@@ -53,6 +53,8 @@ class m_IDirectDrawColorControl;
 class m_IDirectDrawGammaControl;
 
 #include "AddressLookupTable.h"
+#include "PointerSet.h"
+#include "SmallFlatMap.h"
 #include "IClassFactory\IClassFactory.h"
 #include "Settings\Settings.h"
 #include "Logging\Logging.h"